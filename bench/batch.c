@@ -0,0 +1,100 @@
+#include <ras/storage.h>
+#include <ras/request.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifndef ITERATIONS
+#define ITERATIONS (1 << 20)
+#endif
+
+#ifndef BATCH_SIZE
+#define BATCH_SIZE 64
+#endif
+
+static unsigned char memory[BATCH_SIZE][8] = { { 0 } };
+static struct ras_request_options_s batch[BATCH_SIZE] = { { 0 } };
+
+static double
+now() {
+  struct timespec ts = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+read(struct ras_request_s *request) {
+  request->callback(request, 0, request->data, request->size);
+}
+
+static void
+submit_batch(
+  struct ras_storage_s *storage,
+  struct ras_request_s **requests,
+  unsigned long int nrequests
+) {
+  for (int i = 0; i < nrequests; ++i) {
+    requests[i]->callback(requests[i], 0, requests[i]->data, requests[i]->size);
+  }
+}
+
+static double
+per_call(struct ras_storage_s *storage) {
+  double start = now();
+
+  for (unsigned int i = 0; i < ITERATIONS; ++i) {
+    unsigned int j = i % BATCH_SIZE;
+    ras_storage_read_into(storage, j * 8, 8, memory[j], 0);
+  }
+
+  return (now() - start) / ITERATIONS;
+}
+
+static double
+batched(struct ras_storage_s *storage) {
+  double start = now();
+
+  for (unsigned int i = 0; i < ITERATIONS / BATCH_SIZE; ++i) {
+    ras_storage_submit(storage, batch, BATCH_SIZE);
+  }
+
+  return (now() - start) / ITERATIONS;
+}
+
+int
+main(void) {
+  struct ras_storage_s *storage = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = read,
+      .pool_size = BATCH_SIZE,
+      .max_inflight = BATCH_SIZE,
+    });
+
+  struct ras_storage_s *hooked = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = read,
+      .submit_batch = submit_batch,
+      .pool_size = BATCH_SIZE,
+      .max_inflight = BATCH_SIZE,
+    });
+
+  for (int i = 0; i < BATCH_SIZE; ++i) {
+    batch[i] = (struct ras_request_options_s) {
+      .type = RAS_REQUEST_READ,
+      .offset = i * 8,
+      .size = 8,
+      .data = memory[i],
+    };
+  }
+
+  ras_storage_open(storage, 0);
+  ras_storage_open(hooked, 0);
+
+  printf("%24s %12s\n", "mode", "ns/op");
+  printf("%24s %12.2f\n", "per-call", per_call(storage));
+  printf("%24s %12.2f\n", "batched", batched(storage));
+  printf("%24s %12.2f\n", "batched (submit_batch)", batched(hooked));
+
+  ras_storage_destroy(storage, 0);
+  ras_storage_destroy(hooked, 0);
+  return 0;
+}
@@ -0,0 +1,120 @@
+#include <ras/mmap.h>
+#include <ras/storage.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#ifndef ITERATIONS
+#define ITERATIONS (1 << 16)
+#endif
+
+#ifndef FILE_SIZE
+#define FILE_SIZE (1 << 20)
+#endif
+
+#ifndef READ_SIZE
+#define READ_SIZE 64
+#endif
+
+static unsigned char into[READ_SIZE] = { 0 };
+static int fd = -1;
+
+static double
+now() {
+  struct timespec ts = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// maps, syncs and unmaps the page of every read like `example/mmap.c` did
+static void
+read_page(struct ras_request_s *request) {
+  const unsigned long int page_size = getpagesize();
+  const unsigned long int page = request->offset / page_size;
+  const unsigned long int rel = request->offset - page * page_size;
+  unsigned char *map = mmap(
+    0,
+    page_size,
+    PROT_READ,
+    MAP_SHARED,
+    fd,
+    page * page_size);
+
+  msync(map, page_size, MS_SYNC);
+  memcpy(request->data, map + rel, request->size);
+  munmap(map, page_size);
+  request->callback(request, 0, request->data, request->size);
+}
+
+static double
+per_read(struct ras_storage_s *storage) {
+  const unsigned long int slots = FILE_SIZE / READ_SIZE;
+  double start = now();
+
+  for (unsigned int i = 0; i < ITERATIONS; ++i) {
+    const unsigned long int slot = (i * 7919UL) % slots;
+    ras_storage_read_into(storage, slot * READ_SIZE, READ_SIZE, into, 0);
+  }
+
+  return (now() - start) / ITERATIONS;
+}
+
+static void
+onborrow(
+  struct ras_storage_s *storage,
+  int err,
+  const void *buffer,
+  unsigned long int size,
+  struct ras_request_s *loan
+) {
+  ras_storage_loan_release(loan);
+}
+
+static double
+per_borrow(struct ras_storage_s *storage) {
+  const unsigned long int slots = FILE_SIZE / READ_SIZE;
+  double start = now();
+
+  for (unsigned int i = 0; i < ITERATIONS; ++i) {
+    const unsigned long int slot = (i * 7919UL) % slots;
+    ras_storage_read_borrow(storage, slot * READ_SIZE, READ_SIZE, onborrow);
+  }
+
+  return (now() - start) / ITERATIONS;
+}
+
+int
+main(void) {
+  char path[] = "/tmp/ras-bench-mmap-XXXXXX";
+  fd = mkstemp(path);
+
+  if (fd < 0 || ftruncate(fd, FILE_SIZE) < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+
+  struct ras_storage_s *paged = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = read_page,
+    });
+
+  struct ras_storage_s *mapped = ras_mmap_storage_new(path, O_RDWR);
+
+  ras_storage_open(paged, 0);
+  ras_storage_open(mapped, 0);
+
+  printf("%24s %12s\n", "mode", "ns/op");
+  printf("%24s %12.2f\n", "mmap/msync per read", per_read(paged));
+  printf("%24s %12.2f\n", "persistent mapping", per_read(mapped));
+  printf("%24s %12.2f\n", "borrowed", per_borrow(mapped));
+
+  ras_storage_destroy(paged, 0);
+  ras_storage_destroy(mapped, 0);
+  close(fd);
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include <ras/storage.h>
+#include <ras/request.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifndef ITERATIONS
+#define ITERATIONS (1 << 20)
+#endif
+
+static struct ras_storage_s storage = { 0 };
+static struct ras_request_s requests[RAS_STORAGE_MAX_REQUEST_QUEUE] = { 0 };
+
+static double
+now() {
+  struct timespec ts = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// fills the queue up to `depth` and drains it, returning the
+// average cost of a single push and shift pair in nanoseconds
+static double
+run(unsigned int depth) {
+  unsigned int rounds = ITERATIONS / depth;
+  double start = now();
+
+  for (unsigned int i = 0; i < rounds; ++i) {
+    for (unsigned int j = 0; j < depth; ++j) {
+      ras_storage_queue_push(&storage, &requests[j]);
+    }
+
+    for (unsigned int j = 0; j < depth; ++j) {
+      ras_storage_queue_shift(&storage);
+    }
+  }
+
+  return (now() - start) / (double) (rounds * depth);
+}
+
+int
+main(void) {
+  ras_storage_init(&storage, (struct ras_storage_options_s) { 0 });
+
+  for (int i = 0; i < RAS_STORAGE_MAX_REQUEST_QUEUE; ++i) {
+    requests[i].storage = &storage;
+  }
+
+  printf("%8s %12s\n", "depth", "ns/op");
+  for (unsigned int depth = 1; depth <= RAS_STORAGE_MAX_REQUEST_QUEUE; depth *= 2) {
+    printf("%8u %12.2f\n", depth, run(depth));
+  }
+
+  ras_storage_free(&storage);
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include <ras/storage.h>
+#include <ras/request.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef ITERATIONS
+#define ITERATIONS (1 << 18)
+#endif
+
+#ifndef MAX_PRODUCERS
+#define MAX_PRODUCERS 64
+#endif
+
+static unsigned char memory[4096] = { 0 };
+static unsigned int completed = 0;
+
+struct producer_s {
+  pthread_t id;
+  struct ras_storage_s *storage;
+  unsigned int index;
+  unsigned int count;
+  unsigned char buffer[8];
+};
+
+static double
+now() {
+  struct timespec ts = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+fill(struct ras_request_s *request) {
+  memcpy(request->data, memory + request->offset, request->size);
+  request->callback(request, 0, request->data, request->size);
+}
+
+static void
+onread(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  __atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED);
+}
+
+static void *
+produce(void *arg) {
+  struct producer_s *producer = arg;
+  unsigned long int offset = (producer->index * 8) % sizeof(memory);
+
+  for (unsigned int i = 0; i < producer->count; ++i) {
+    while (-EAGAIN == ras_storage_read_into(
+      producer->storage, offset, 8, producer->buffer, onread)
+    ) {
+      sched_yield();
+    }
+  }
+
+  return 0;
+}
+
+// submits `ITERATIONS` reads from `producers` threads sharing one storage
+// and returns the throughput in requests per second
+static double
+run(unsigned int producers) {
+  struct producer_s threads[MAX_PRODUCERS];
+  struct ras_storage_s *storage = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = fill,
+      .max_inflight = 16,
+      .max_queued = 4096,
+      .thread_safe = 1,
+    });
+
+  unsigned int total = (ITERATIONS / producers) * producers;
+  double start = now();
+
+  completed = 0;
+  ras_storage_open(storage, 0);
+
+  for (unsigned int i = 0; i < producers; ++i) {
+    memset(&threads[i], 0, sizeof(threads[i]));
+    threads[i].storage = storage;
+    threads[i].index = i;
+    threads[i].count = ITERATIONS / producers;
+    pthread_create(&threads[i].id, 0, produce, &threads[i]);
+  }
+
+  for (unsigned int i = 0; i < producers; ++i) {
+    pthread_join(threads[i].id, 0);
+  }
+
+  while (__atomic_load_n(&completed, __ATOMIC_ACQUIRE) < total) {
+    sched_yield();
+  }
+
+  double elapsed = now() - start;
+  ras_storage_destroy(storage, 0);
+  return total / (elapsed / 1e9);
+}
+
+int
+main(void) {
+  printf("%10s %14s\n", "producers", "requests/s");
+  for (unsigned int producers = 1; producers <= MAX_PRODUCERS; producers *= 2) {
+    printf("%10u %14.0f\n", producers, run(producers));
+  }
+
+  return 0;
+}
@@ -0,0 +1,153 @@
+#ifndef RAS_CACHE_H
+#define RAS_CACHE_H
+
+#include "platform.h"
+#include "storage.h"
+
+// Forward declarations
+struct ras_cache_s;
+struct ras_cache_storage_s;
+
+/**
+ * The default block size used when `block_size` is `0`.
+ */
+#ifndef RAS_CACHE_BLOCK_SIZE
+#define RAS_CACHE_BLOCK_SIZE 4096
+#endif
+
+/**
+ * The largest write a flush of a write-back cache storage makes to the
+ * inner storage. Longer runs of dirty blocks are written in pieces.
+ */
+#ifndef RAS_CACHE_MAX_FLUSH
+#define RAS_CACHE_MAX_FLUSH (1024 * 1024)
+#endif
+
+/**
+ * Block replacement policies of a cache storage.
+ *
+ *   * `RAS_CACHE_LRU`: Evicts the block read least recently
+ *   * `RAS_CACHE_CLOCK`: Evicts the first block without its reference bit
+ *     set found by a hand sweeping the blocks, clearing the bits it passes
+ *   * `RAS_CACHE_ARC`: Adaptive replacement cache, which balances blocks
+ *     read once against blocks read again by remembering the blocks it
+ *     recently evicted from either
+ */
+enum ras_cache_policy {
+  RAS_CACHE_LRU = 0,
+  RAS_CACHE_CLOCK = 1,
+  RAS_CACHE_ARC = 2,
+};
+
+/**
+ * Fields for `struct ras_cache_write_back_options_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ *
+ * layout= [ max_dirty=0, interval=1 ]
+ */
+#define RAS_CACHE_WRITE_BACK_OPTIONS_FIELDS \
+  unsigned long int max_dirty;              \
+  unsigned long int interval;
+
+/**
+ * Represents the configurable state of the write-back mode of a cache
+ * storage. Dirty blocks are flushed once `max_dirty` bytes are dirty, half
+ * the capacity of the cache if it is `0`, and by the first request made
+ * `interval` microseconds or more after a block became dirty, if it is not
+ * `0`.
+ */
+struct ras_cache_write_back_options_s {
+  RAS_CACHE_WRITE_BACK_OPTIONS_FIELDS
+};
+
+/**
+ * Fields for `struct ras_cache_storage_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_CACHE_STORAGE_FIELDS       \
+  RAS_STORAGE_FIELDS                   \
+  struct ras_storage_s *inner;         \
+  struct ras_cache_s *cache;           \
+  enum ras_cache_policy policy;        \
+  unsigned int write_back;             \
+  unsigned long int block_size;        \
+  unsigned long int capacity;          \
+  unsigned long int cached;            \
+  unsigned long int generation;        \
+  unsigned long int hits;              \
+  unsigned long int misses;            \
+  unsigned long int evictions;         \
+  unsigned long int max_dirty;         \
+  unsigned long int flush_interval;    \
+  unsigned long int dirty;             \
+  unsigned long int flushes;           \
+  unsigned long int flushed_bytes;     \
+  unsigned long int flush_latency;     \
+  unsigned long int flush_latency_max;
+
+/**
+ * Represents a storage that serves reads of an `inner` storage from a
+ * cache of `capacity` blocks of `block_size` bytes. `cached` is the number
+ * of blocks held, `hits` counts reads served entirely from the cache,
+ * `misses` reads that were not and `evictions` the blocks evicted to make
+ * room for others. In write-back mode `dirty` is the number of bytes
+ * written to the cache and not yet to the inner storage, `flushes` counts
+ * the flushes that wrote dirty blocks, `flushed_bytes` the bytes they
+ * wrote and `flush_latency` and `flush_latency_max` are the time the last
+ * and the slowest of them took in nanoseconds.
+ */
+struct ras_cache_storage_s {
+  RAS_CACHE_STORAGE_FIELDS
+};
+
+/**
+ * Allocates and initializes a storage that caches the blocks read from
+ * `inner` with the replacement `policy`, in `capacity` bytes of memory
+ * divided into blocks of `block_size` bytes. Blocks are found with an open
+ * addressing hash table. A read served by the cache completes without a
+ * request to `inner`, other reads read the blocks they touch that are not
+ * cached from `inner` and cache the whole blocks read. Writes update the
+ * cached blocks they overlap and are written through to `inner`, deletes
+ * drop them once they complete. Blocks at the end of `inner` are not cached
+ * while they are short so reads up to the end always see its current size.
+ * The cache storage takes over `inner`, which is opened, closed and
+ * destroyed with it. Returns `NULL` on error and `errno` is set to an error
+ * code found in `errno.h`.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *inner' is `NULL`
+ *   * `EINVAL`: The `capacity` is smaller than a block or the `policy` is
+ *     not a `enum ras_cache_policy`
+ *   * `ENOMEM`: Memory could not be allocated
+ */
+RAS_EXPORT struct ras_storage_s *
+ras_cache_storage_new(
+  struct ras_storage_s *inner,
+  unsigned long int capacity,
+  unsigned long int block_size,
+  enum ras_cache_policy policy);
+
+/**
+ * Switches a cache storage to write-back mode. Writes that only touch
+ * blocks that are cached or that they cover whole are written to the cache
+ * and complete right away, leaving the blocks dirty, and deletes zero the
+ * cached blocks they overlap before they are written through. Other writes
+ * are written through. Dirty blocks are never evicted and are written to
+ * `inner` in runs of consecutive blocks sorted by offset, at most
+ * `RAS_CACHE_MAX_FLUSH` bytes each, once `max_dirty` bytes are dirty, once
+ * `interval` expires, on `ras_storage_flush()` and `ras_storage_sync()` and
+ * before the cache storage is closed or destroyed. A close, destroy, flush
+ * or sync fails if a write of dirty blocks does, which stay dirty. Returns
+ * `0` on success, otherwise an error code found in `errno.h` with its sign
+ * flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ *   * `EINVAL`: The `storage` is not a cache storage
+ */
+RAS_EXPORT int
+ras_cache_storage_write_back(
+  struct ras_storage_s *storage,
+  struct ras_cache_write_back_options_s options);
+
+#endif
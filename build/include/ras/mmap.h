@@ -0,0 +1,61 @@
+#ifndef RAS_MMAP_H
+#define RAS_MMAP_H
+
+#include "platform.h"
+#include "storage.h"
+
+// Forward declarations
+struct ras_mmap_storage_s;
+
+/**
+ * Fields for `struct ras_mmap_storage_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_MMAP_STORAGE_FIELDS \
+  RAS_STORAGE_FIELDS            \
+  char *path;                   \
+  int flags;                    \
+  int fd;                       \
+  unsigned char *map;           \
+  unsigned long int mapped;     \
+  unsigned long int length;
+
+/**
+ * Represents a storage for a file that is mapped into memory once when it
+ * is opened. `mapped` is the size of the mapping and `length` is the size
+ * of the file, which is never larger than `mapped`.
+ */
+struct ras_mmap_storage_s {
+  RAS_MMAP_STORAGE_FIELDS
+};
+
+/**
+ * Allocates and initializes a storage for the file at `path`, opened with
+ * `open(2)` `flags` and mapped with `mmap(2)` by `ras_storage_open()` or
+ * implicitly by the first request. Reads and writes copy to and from the
+ * mapping and `ras_storage_read_borrow()` lends pointers into it. Writes
+ * past the end of the file extend it and grow the mapping with `mremap(2)`,
+ * at least doubling its size. While reads are borrowed the mapping is only
+ * grown in place and such writes fail with `ENOMEM` if it can't be.
+ * Changes are written to the file by the kernel in the background, or
+ * synchronously by `ras_mmap_storage_flush()`, by flush requests and by
+ * sync requests, which also sync the size of the file with `fdatasync(2)`.
+ * Returns `NULL` on error and `errno` is set to an error code found in
+ * `errno.h`.
+ */
+RAS_EXPORT struct ras_storage_s *
+ras_mmap_storage_new(const char *path, int flags);
+
+/**
+ * Writes the changes made to the mapping of an mmap backed storage to its
+ * file with `msync(2)` and waits for them to complete. Returns `0` on
+ * success, otherwise an error code found in `errno.h` with its sign
+ * flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ */
+RAS_EXPORT int
+ras_mmap_storage_flush(struct ras_storage_s *storage);
+
+#endif
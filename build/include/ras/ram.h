@@ -0,0 +1,112 @@
+#ifndef RAS_RAM_H
+#define RAS_RAM_H
+
+#include "platform.h"
+#include "storage.h"
+
+// Forward declarations
+struct ras_ram_node_s;
+struct ras_ram_storage_s;
+struct ras_ram_storage_options_s;
+
+/**
+ * The default page size used when `page_size` is not given in
+ * `struct ras_ram_storage_options_s`. This value must be a power of 2.
+ */
+#ifndef RAS_RAM_PAGE_SIZE
+#define RAS_RAM_PAGE_SIZE 4096
+#endif
+
+/**
+ * The largest page size of a RAM storage. Reads of pages that were never
+ * written are served from a shared zero page of this size.
+ */
+#ifndef RAS_RAM_MAX_PAGE_SIZE
+#define RAS_RAM_MAX_PAGE_SIZE (1024 * 1024)
+#endif
+
+/**
+ * The number of page index bits resolved by each level of the page table.
+ * Each node of the page table has `1 << RAS_RAM_RADIX_BITS` slots.
+ */
+#ifndef RAS_RAM_RADIX_BITS
+#define RAS_RAM_RADIX_BITS 9
+#endif
+
+/**
+ * Fields for `struct ras_ram_storage_options_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ *
+ * layout= [ page_size=0 ]
+ */
+#define RAS_RAM_STORAGE_OPTIONS_FIELDS \
+  unsigned int page_size;
+
+/**
+ * Represents the initial configurable state for a RAM storage. `page_size`
+ * must be a power of 2 no larger than `RAS_RAM_MAX_PAGE_SIZE`.
+ */
+struct ras_ram_storage_options_s {
+  RAS_RAM_STORAGE_OPTIONS_FIELDS
+};
+
+/**
+ * Fields for `struct ras_ram_storage_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_RAM_STORAGE_FIELDS   \
+  RAS_STORAGE_FIELDS             \
+  struct ras_ram_node_s *root;   \
+  unsigned int height;           \
+  unsigned int page_size;        \
+  unsigned int page_shift;       \
+  unsigned long int length;      \
+  unsigned long int npages;
+
+/**
+ * Represents a storage held in memory pages that are allocated on the
+ * first write to them and found through a multi-level radix page table.
+ * The table only has as many levels as the largest written offset needs,
+ * and only the nodes on the path to a written page are allocated, so
+ * sparse storages may span every `unsigned long int` offset. `length` is
+ * the end of the furthest write and `npages` the number of pages held,
+ * including pages shared with snapshots.
+ */
+struct ras_ram_storage_s {
+  RAS_RAM_STORAGE_FIELDS
+};
+
+/**
+ * Allocates and initializes a RAM storage. Reads of pages that were never
+ * written, or were deleted, are served from a shared zero page without
+ * allocating, reads stop at the end of the furthest write and deleting a
+ * whole page frees it. Borrowed reads lend pointers into the pages (or the
+ * zero page) and end at the end of a page. Returns `NULL` on error and
+ * `errno` is set to an error code found in `errno.h`.
+ *
+ * Possible Error Codes
+ *   * `EINVAL`: The `page_size` is not a power of 2 or is too large
+ *   * `ENOMEM`: Memory could not be allocated
+ */
+RAS_EXPORT struct ras_storage_s *
+ras_ram_storage_new(struct ras_ram_storage_options_s options);
+
+/**
+ * Creates a copy-on-write snapshot of a RAM storage in constant time. The
+ * snapshot is a new RAM storage that shares the page table and pages of
+ * `storage` through reference counts. The first write or delete to a
+ * shared page by either storage copies that page and the nodes on the path
+ * to it, so the memory used by the two grows only with the pages they
+ * change. Either may be destroyed first. The snapshot holds the data of
+ * the requests that completed before it was taken and must not be taken
+ * while a request of `storage` runs on another thread. Returns `NULL` on
+ * error and `errno` is set to an error code found in `errno.h`.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ *   * `ENOMEM`: Memory could not be allocated
+ */
+RAS_EXPORT struct ras_storage_s *
+ras_ram_storage_snapshot(struct ras_storage_s *storage);
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef RAS_H
+#define RAS_H
+
+#include "allocator.h"
+#include "cache.h"
+#include "emitter.h"
+#include "executor.h"
+#include "file.h"
+#include "mmap.h"
+#include "platform.h"
+#include "ram.h"
+#include "request.h"
+#include "storage.h"
+#include "uring.h"
+#include "version.h"
+
+/**
+ * The `ras_storage_t` (`struct ras_storage_s`) type represents
+ * the storage context for a random access storage interface.
+ */
+typedef struct ras_storage_s ras_storage_t;
+
+/**
+ * The `ras_storage_options_t` (`struct ras_storage_options_s`) type represents
+ * the initialization options for the `ras_storage_t` type used with the
+ * `ras_storge_new()` and `ras_storge_init()` functions.
+ */
+typedef struct ras_storage_options_s ras_storage_options_t;
+
+/**
+ * The `ras_request_t` (`struct ras_request_s`) type represents a request
+ * operation that may be initiated by one of the `ras_storage_*()` functions
+ * that *open*, *close*, *read*, *write, *stat*, and *destroy* on random access
+ * storage interface implementations. A request contains the information needed
+ * to complete a request operation and call back to the caller.
+ */
+typedef struct ras_request_s ras_request_t;
+
+/**
+ * The `ras_storage_stats_t` (`struct ras_storage_stats_s`) type represents a
+ * structure containing stats about the random access storage interface, such
+ * as `size`.
+ */
+typedef struct ras_storage_stats_s ras_storage_stats_t;
+
+/**
+ * The `ras_storage_counters_t` (`struct ras_storage_counters_s`) type
+ * represents a structure of dispatch counters for a random access storage
+ * interface, such as `hazard_stalls`.
+ */
+typedef struct ras_storage_counters_s ras_storage_counters_t;
+
+/**
+ * The `ras_storage_schedule_t` (`enum ras_storage_schedule`) type is an
+ * enumeration of the policies a storage dispatches queued requests by.
+ */
+typedef enum ras_storage_schedule ras_storage_schedule_t;
+
+/**
+ * The `ras_allocator_stats_t` (`struct ras_allocator_stats_s`) type represents
+ * a structure of counters for the number of times `ras_alloc()` and
+ * `ras_free()` have been called and the number of requests that were served
+ * from, or missed, a storage request pool.
+ */
+typedef struct ras_allocator_stats_s ras_allocator_stats_t;
+
+/**
+ * The `ras_request_type_t` (`enum ras_request_type`) type is an enumeration
+ * of the possible request type the implementation can process.
+ */
+typedef enum ras_request_type ras_request_type_t;
+
+/**
+ * The `ras_request_control_t` (`struct ras_request_control_s`) type
+ * represents how a request made with a `ras_storage_*_ex()` function is
+ * scheduled and canceled.
+ */
+typedef struct ras_request_control_s ras_request_control_t;
+
+/**
+ * The `ras_request_priority_t` (`enum ras_request_priority`) type is an
+ * enumeration of the priority classes queued requests are dispatched by.
+ */
+typedef enum ras_request_priority ras_request_priority_t;
+
+/**
+ * The `ras_executor_t` (`struct ras_executor_s`) type represents a fixed
+ * pool of worker threads with work stealing deques that a storage can use
+ * to run blocking operations off the thread that makes requests.
+ */
+typedef struct ras_executor_s ras_executor_t;
+
+/**
+ * The `ras_executor_options_t` (`struct ras_executor_options_s`) type
+ * represents the initial configurable state for an executor.
+ */
+typedef struct ras_executor_options_s ras_executor_options_t;
+
+/**
+ * The `ras_cache_storage_t` (`struct ras_cache_storage_s`) type represents
+ * a storage that serves reads of another storage from a block cache.
+ */
+typedef struct ras_cache_storage_s ras_cache_storage_t;
+
+/**
+ * The `ras_cache_policy_t` (`enum ras_cache_policy`) type is an enumeration
+ * of the block replacement policies of a `ras_cache_storage_t`.
+ */
+typedef enum ras_cache_policy ras_cache_policy_t;
+
+/**
+ * The `ras_file_storage_t` (`struct ras_file_storage_s`) type represents a
+ * storage for a file read and written with `pread(2)` and `pwrite(2)`.
+ */
+typedef struct ras_file_storage_s ras_file_storage_t;
+
+/**
+ * The `ras_mmap_storage_t` (`struct ras_mmap_storage_s`) type represents a
+ * storage for a file that is mapped into memory once when it is opened.
+ */
+typedef struct ras_mmap_storage_s ras_mmap_storage_t;
+
+/**
+ * The `ras_ram_storage_t` (`struct ras_ram_storage_s`) type represents a
+ * storage held in memory pages found through a sparse radix page table.
+ */
+typedef struct ras_ram_storage_s ras_ram_storage_t;
+
+/**
+ * The `ras_ram_storage_options_t` (`struct ras_ram_storage_options_s`) type
+ * represents the initialization options for the `ras_ram_storage_t` type
+ * used with the `ras_ram_storage_new()` function.
+ */
+typedef struct ras_ram_storage_options_s ras_ram_storage_options_t;
+
+/**
+ * The `ras_uring_storage_t` (`struct ras_uring_storage_s`) type represents
+ * a file storage whose operations are submitted to a Linux io_uring.
+ */
+typedef struct ras_uring_storage_s ras_uring_storage_t;
+
+/**
+ * The `ras_uring_storage_options_t` (`struct ras_uring_storage_options_s`)
+ * type represents the initial configurable state for an io_uring backed
+ * file storage used with the `ras_uring_storage_new()` function.
+ */
+typedef struct ras_uring_storage_options_s ras_uring_storage_options_t;
+
+/**
+ */
+typedef struct ras_emitter_s ras_emitter_t;
+
+/**
+ */
+typedef struct ras_emitter_listener_s ras_emitter_listener_t;
+
+/**
+ */
+typedef enum ras_event ras_event_t;
+
+#endif
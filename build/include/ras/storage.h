@@ -0,0 +1,1044 @@
+#ifndef RAS_STORAGE_H
+#define RAS_STORAGE_H
+
+#include "emitter.h"
+#include "executor.h"
+#include "request.h"
+#include "platform.h"
+
+// Forward declarations
+struct ras_emitter_s;
+struct ras_readahead_s;
+struct ras_request_s;
+struct ras_storage_s;
+struct ras_storage_stats_s;
+struct ras_storage_options_s;
+
+/**
+ * The default maximum queued requests (high-water mark) used when
+ * `max_queued` is not given in `struct ras_storage_options_s`.
+ */
+#ifndef RAS_STORAGE_MAX_REQUEST_QUEUE
+#define RAS_STORAGE_MAX_REQUEST_QUEUE 512
+#endif
+
+/**
+ * The initial capacity of the request queue ring buffer. The queue grows
+ * by doubling its capacity on demand up to the high-water mark. This
+ * value must be a power of 2.
+ */
+#ifndef RAS_STORAGE_MIN_REQUEST_QUEUE
+#define RAS_STORAGE_MIN_REQUEST_QUEUE 16
+#endif
+
+/**
+ * The default maximum number of data requests (read, write, delete, stat)
+ * in flight at once used when `max_inflight` is not given in
+ * `struct ras_storage_options_s`.
+ */
+#ifndef RAS_STORAGE_MAX_INFLIGHT
+#define RAS_STORAGE_MAX_INFLIGHT 1
+#endif
+
+/**
+ * The default number of requests preallocated and retained by the request
+ * pool of a storage when `pool_size` is not given in
+ * `struct ras_storage_options_s`.
+ */
+#ifndef RAS_STORAGE_REQUEST_POOL_SIZE
+#define RAS_STORAGE_REQUEST_POOL_SIZE 16
+#endif
+
+/**
+ * The maximum number of queued requests `ras_storage_queue_drain()` looks
+ * at past a request that can not run yet because it overlaps a request in
+ * flight.
+ */
+#ifndef RAS_STORAGE_QUEUE_LOOKAHEAD
+#define RAS_STORAGE_QUEUE_LOOKAHEAD 64
+#endif
+
+/**
+ * The default number of microseconds a queued request waits before it is
+ * dispatched as if its priority class was one higher, used when
+ * `priority_aging` is not given in `struct ras_storage_options_s`.
+ */
+#ifndef RAS_STORAGE_PRIORITY_AGING
+#define RAS_STORAGE_PRIORITY_AGING 10000
+#endif
+
+/**
+ * The number of buckets of the queue wait histograms of a storage. Bucket
+ * `i` counts the requests that waited `[2^i, 2^(i + 1))` nanoseconds in
+ * the queue, the last bucket every request that waited longer.
+ */
+#ifndef RAS_STORAGE_QUEUE_WAIT_BUCKETS
+#define RAS_STORAGE_QUEUE_WAIT_BUCKETS 32
+#endif
+
+/**
+ * The maximum size in bytes of a write `ras_storage_queue_drain()` makes
+ * by merging queued writes that touch or overlap. Merging is disabled when
+ * this value is `0`.
+ */
+#ifndef RAS_STORAGE_MAX_COALESCE
+#define RAS_STORAGE_MAX_COALESCE (1024 * 1024)
+#endif
+
+/**
+ * The number of read streams, told apart by the `shared` pointer of their
+ * reads, whose patterns the read-ahead of a storage follows at once.
+ */
+#ifndef RAS_STORAGE_READAHEAD_STREAMS
+#define RAS_STORAGE_READAHEAD_STREAMS 4
+#endif
+
+/**
+ * The `ras_storage_request_callback_t` callback represents the user
+ * callback for the random access work request to be done.
+ */
+typedef void (ras_storage_request_callback_t)(struct ras_request_s *request);
+
+/**
+ * Policies a storage dispatches the requests that can run from its queue
+ * by.
+ *
+ *   * `RAS_STORAGE_SCHEDULE_FIFO`: Requests run in the order they were
+ *     queued
+ *   * `RAS_STORAGE_SCHEDULE_CSCAN`: Reads, writes and deletes run in the
+ *     order of their offsets, sweeping up from the end of the last one
+ *     that ran and starting over from the lowest offset queued once none
+ *     is past it (circular SCAN)
+ */
+enum ras_storage_schedule {
+  RAS_STORAGE_SCHEDULE_FIFO = 0,
+  RAS_STORAGE_SCHEDULE_CSCAN = 1,
+};
+
+/**
+ * The `ras_storage_open_callback_t` callback represents the user callback
+ * for a random access open request.
+ */
+typedef void (ras_storage_open_callback_t)(
+  struct ras_storage_s *storage,
+  int err);
+
+/**
+ * The `ras_storage_open_read_only_callback_t` callback represents the user callback
+ * for a random access open_read_only request.
+ */
+typedef void (ras_storage_open_read_only_callback_t)(
+  struct ras_storage_s *storage,
+  int err);
+
+/**
+ * The `ras_storage_read_callback_t` callback represents the user callback
+ * for a random access read request.
+ */
+typedef void (ras_storage_read_callback_t)(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size);
+
+/**
+ * The `ras_storage_write_callback_t` callback represents the user callback
+ * for a random access write request.
+ */
+typedef void (ras_storage_write_callback_t)(
+  struct ras_storage_s *storage,
+  int err);
+
+/**
+ * The `ras_storage_delete_callback_t` callback represents the user callback
+ * for a random access delete request.
+ */
+typedef void (ras_storage_delete_callback_t)(
+  struct ras_storage_s *storage,
+  int err);
+
+/**
+ * The `ras_storage_stat_callback_t` callback represents the user callback
+ * for a random access stat request.
+ */
+typedef void (ras_storage_stat_callback_t)(
+  struct ras_storage_s *storage,
+  int err,
+  struct ras_storage_stats_s *stats);
+
+/**
+ * The `ras_storage_close_callback_t` callback represents the user callback
+ * for a random access close request.
+ */
+typedef void (ras_storage_close_callback_t)(
+  struct ras_storage_s *storage,
+  int err);
+
+/**
+ * The `ras_storage_flush_callback_t` callback represents the user callback
+ * for a random access flush request.
+ */
+typedef void (ras_storage_flush_callback_t)(
+  struct ras_storage_s *storage,
+  int err);
+
+/**
+ * The `ras_storage_sync_callback_t` callback represents the user callback
+ * for a random access sync request.
+ */
+typedef void (ras_storage_sync_callback_t)(
+  struct ras_storage_s *storage,
+  int err);
+
+/**
+ * The `ras_storage_destroy_callback_t` callback represents the user callback
+ * for a random access destroy request.
+ */
+typedef void (ras_storage_destroy_callback_t)(
+  struct ras_storage_s *storage,
+  int err);
+
+/**
+ * The `ras_storage_readv_callback_t` callback represents the user callback
+ * for a vectored random access read request.
+ */
+typedef void (ras_storage_readv_callback_t)(
+  struct ras_storage_s *storage,
+  int err,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments);
+
+/**
+ * The `ras_storage_writev_callback_t` callback represents the user callback
+ * for a vectored random access write request.
+ */
+typedef void (ras_storage_writev_callback_t)(
+  struct ras_storage_s *storage,
+  int err);
+
+/**
+ * The `ras_storage_borrow_callback_t` callback represents the user callback
+ * for a borrowed random access read request. `buffer` stays valid until
+ * `loan` is given to `ras_storage_loan_release()`. `loan` is `NULL` if the
+ * request failed.
+ */
+typedef void (ras_storage_borrow_callback_t)(
+  struct ras_storage_s *storage,
+  int err,
+  const void *buffer,
+  unsigned long int size,
+  struct ras_request_s *loan);
+
+/**
+ * The `ras_storage_batch_callback_t` callback represents the storage
+ * interface operation that receives an entire batch of requests submitted
+ * with `ras_storage_submit()`.
+ */
+typedef void (ras_storage_batch_callback_t)(
+  struct ras_storage_s *storage,
+  struct ras_request_s **requests,
+  unsigned long int nrequests);
+
+/**
+ * Fields for `struct ras_storage_options_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ *
+ * layout= [
+ *   open_read_only=0, open=1, read=2, write=3,
+ *   del=4, stat=5, close=6, destroy=7, data=8,
+ *   max_queued=9, pool_size=10, readv=11, writev=12,
+ *   submit_batch=13, max_inflight=14, thread_safe=15,
+ *   executor=16, borrow=17, readahead=18, flush=19,
+ *   sync=20, group_sync=21, sync_window=22,
+ *   priority_aging=23, schedule=24, cancel=25,
+ * ]
+ */
+#define RAS_STORAGE_OPTIONS_FIELDS                \
+  ras_storage_request_callback_t *open_read_only; \
+  ras_storage_request_callback_t *open;           \
+  ras_storage_request_callback_t *read;           \
+  ras_storage_request_callback_t *write;          \
+  ras_storage_request_callback_t *del;            \
+  ras_storage_request_callback_t *stat;           \
+  ras_storage_request_callback_t *close;          \
+  ras_storage_request_callback_t *destroy;        \
+  void *data;                                     \
+  unsigned int max_queued;                        \
+  unsigned int pool_size;                         \
+  ras_storage_request_callback_t *readv;          \
+  ras_storage_request_callback_t *writev;         \
+  ras_storage_batch_callback_t *submit_batch;     \
+  unsigned int max_inflight;                      \
+  unsigned int thread_safe;                       \
+  struct ras_executor_s *executor;                \
+  ras_storage_request_callback_t *borrow;         \
+  unsigned long int readahead;                    \
+  ras_storage_request_callback_t *flush;          \
+  ras_storage_request_callback_t *sync;           \
+  unsigned int group_sync;                        \
+  unsigned long int sync_window;                  \
+  unsigned long int priority_aging;               \
+  enum ras_storage_schedule schedule;             \
+  ras_storage_request_callback_t *cancel;
+
+/**
+ * Represents the initial configurable state for a random access storage
+ * context.
+ *
+ * When `thread_safe` is not `0`, requests may be made from any thread and
+ * storage interface operations may complete requests from any thread.
+ * Requests made by a thread that is not dispatching for the storage are
+ * pushed on to a lock-free submission queue and dispatched by whichever
+ * thread holds the storage dispatch lock, so operations and callbacks may
+ * run on a different thread than the one that made the request. The
+ * `submit_batch()` operation is not used in thread-safe mode and
+ * `ras_storage_destroy()` must not race with other requests.
+ *
+ * When `executor` is given, the `read()`, `write()`, `del()`, `stat()`,
+ * `readv()`, `writev()`, `borrow()`, `flush()` and `sync()` operations are
+ * run on the worker threads of the executor so they may block. The storage
+ * is thread-safe and operations may complete requests from the worker
+ * thread they run on.
+ *
+ * When `borrow` is given, borrowed reads made with `ras_storage_read_borrow()`
+ * are given to it instead of `read()` and it completes them with a pointer
+ * into memory the storage interface holds the data in, such as a mapping.
+ * That memory must not move or change while the loan is held, which the
+ * storage ensures by holding back writes and deletes that overlap it and
+ * open, close and destroy requests until every loan is released. A loan
+ * may be shorter than the request when the memory is not contiguous, the
+ * rest is then borrowed from where it ends.
+ *
+ * When `readahead` is not `0`, the offsets of reads are followed for each
+ * stream of reads sharing a `shared` pointer. Once reads follow each other
+ * at the same distance, sequentially or strided, the window of data after
+ * the next expected read is prefetched with `read()` while less than half a
+ * window is left ahead of the reads. The window starts at four reads,
+ * doubles with every prefetch up to `readahead` bytes and halves on every
+ * read of the stream that misses the prefetched windows. Reads served from
+ * a window complete without a `read()` and writes, deletes, open, close
+ * and destroy requests drop the windows they would make stale.
+ *
+ * When `group_sync` is not `0`, sync requests share `sync()` operations.
+ * A sync request joins the group of sync requests whose `sync()` has not
+ * started yet, or starts a group. A group starts its `sync()` once the
+ * requests being dispatched have run and the `sync()` of the group before
+ * it completed, and every request of the group completes with its result.
+ * Sync requests waiting in a group do not count towards `max_inflight`, a
+ * group counts as one request once its `sync()` starts. With an
+ * `executor`, the group stays open for `sync_window` microseconds more on
+ * the worker thread before its `sync()` starts.
+ *
+ * Queued requests are dispatched by priority class, oldest first within a
+ * class. A request queued for `priority_aging` microseconds is dispatched
+ * as if its class was one higher, and so on, so background requests are
+ * not starved by a steady stream of latency critical ones. Within a class,
+ * queued requests run in the order of the `schedule` policy, so with
+ * `RAS_STORAGE_SCHEDULE_CSCAN` a backlog of reads and writes at scattered
+ * offsets runs as a sweep across the storage. A request never runs ahead
+ * of a request queued before it whose range it overlaps if either writes.
+ *
+ * The `cancel()` operation is given requests in flight that are canceled
+ * with `ras_request_cancel()` or that timed out. It may abort the request,
+ * which then completes with `ECANCELED` or `ETIMEDOUT` if it fails.
+ */
+struct ras_storage_options_s {
+  RAS_STORAGE_OPTIONS_FIELDS
+};
+
+/**
+ * Fields for `struct ras_storage_counters_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_STORAGE_COUNTERS_FIELDS                           \
+  unsigned long int hazard_stalls;                            \
+  unsigned long int coalesced_writes;                         \
+  unsigned long int coalesced_reads;                          \
+  unsigned long int coalesced_bytes;                          \
+  unsigned long int readahead_hits;                           \
+  unsigned long int readahead_misses;                         \
+  unsigned long int readahead_bytes;                          \
+  unsigned long int readahead_wasted;                         \
+  unsigned long int syncs;                                    \
+  unsigned long int syncs_shared;                             \
+  unsigned long int deadline_misses;                          \
+  unsigned long int reordered;                                \
+  unsigned long int canceled;                                 \
+  unsigned long int timeouts;                                 \
+  unsigned long int queue_waits[RAS_REQUEST_PRIORITIES];      \
+  unsigned long int queue_wait[RAS_REQUEST_PRIORITIES];       \
+  unsigned long int queue_wait_max[RAS_REQUEST_PRIORITIES];   \
+  unsigned long int queue_wait_histogram                      \
+    [RAS_REQUEST_PRIORITIES][RAS_STORAGE_QUEUE_WAIT_BUCKETS];
+
+/**
+ * Represents the dispatch counters of a random access storage context.
+ * `hazard_stalls` counts requests that waited because their range overlaps
+ * a write in flight or queued before them. `coalesced_writes` and
+ * `coalesced_reads` count queued requests merged into a request queued
+ * before them and `coalesced_bytes` the bytes they read or wrote.
+ * `readahead_hits` counts reads served from prefetched windows and
+ * `readahead_misses` reads of a stream with prefetched windows that were
+ * not, `readahead_bytes` counts the bytes prefetched and `readahead_wasted`
+ * the prefetched bytes dropped before a read was served from them.
+ * `syncs` counts `sync()` operations and `syncs_shared` the sync requests
+ * completed by a `sync()` started for another request of their group.
+ * `deadline_misses` counts queued requests dispatched after their
+ * deadline and `reordered` the queued requests dispatched ahead of a
+ * request queued before them that could run for their priority class,
+ * deadline or offset. `canceled` counts requests canceled with
+ * `ras_request_cancel()` and `timeouts` requests that timed out, queued or
+ * in flight. For each `enum ras_request_priority` class, `queue_waits`
+ * counts the requests dispatched from the queue, `queue_wait` and
+ * `queue_wait_max` are the total and the longest time they waited in
+ * nanoseconds and `queue_wait_histogram` counts them by time waited.
+ */
+struct ras_storage_counters_s {
+  RAS_STORAGE_COUNTERS_FIELDS
+};
+
+/**
+ * Fields for `struct ras_storage_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_STORAGE_FIELDS                                     \
+  unsigned int alloc:1;                                        \
+  unsigned int opened:1;                                       \
+  unsigned int closed:1;                                       \
+  unsigned int queue_head;                                     \
+  unsigned int queue_size;                                     \
+  unsigned int queued;                                         \
+  unsigned int pending;                                        \
+  unsigned int prioritized;                                    \
+  unsigned int tombstones;                                     \
+  unsigned long int position;                                  \
+  unsigned long int next_expiry;                               \
+  unsigned int readable:1;                                     \
+  unsigned int statable:1;                                     \
+  unsigned int writable:1;                                     \
+  unsigned int deletable:1;                                    \
+  unsigned int destroyed:1;                                    \
+  unsigned int needs_open:1;                                   \
+  unsigned int prefer_read_only:1;                             \
+  unsigned int saturated:1;                                    \
+  unsigned int barrier:1;                                      \
+  unsigned int draining;                                       \
+  struct ras_emitter_s emitter;                                \
+  struct ras_request_s last_request;                           \
+  struct ras_request_s **queue;                                \
+  struct ras_request_s *inflight;                              \
+  struct ras_request_s *loans;                                 \
+  struct ras_readahead_s *readahead;                           \
+  struct ras_request_s *sync_group;                            \
+  struct ras_request_s *syncing;                               \
+  unsigned int sync_waiting;                                   \
+  struct ras_storage_counters_s counters;                      \
+  void *owner;                                                 \
+  unsigned int locks;                                          \
+  unsigned int pool_lock;                                      \
+  unsigned int submitted;                                      \
+  unsigned int expired:1;                                      \
+  struct ras_request_s *submit_head;                           \
+  struct ras_request_s *submit_tail;                           \
+  struct ras_request_s submit_stub;                            \
+  struct ras_request_s *pool;                                  \
+  unsigned int pooled;                                         \
+  struct ras_storage_options_s options;                        \
+  void *data;                                                  \
+
+/**
+ * Represents the state for a random access storage context.
+ */
+struct ras_storage_s {
+  RAS_STORAGE_FIELDS
+};
+
+/**
+ * Fields for `struct ras_storage_stats_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_STORAGE_STATS_FIELDS \
+  unsigned long int size;        \
+  void *extended;
+
+/**
+ * Represents the state for random access storage stats.
+ */
+struct ras_storage_stats_s {
+  RAS_STORAGE_STATS_FIELDS
+};
+
+/**
+ * Allocates a pointer to 'struct ras_storage_s'.
+ * Calls 'ras_alloc()' internally and will return 'NULL'
+ * on allocation errors.
+ */
+RAS_EXPORT struct ras_storage_s *
+ras_storage_alloc();
+
+/**
+ * Initializes a pointer to `struct ras_storage_s` with options from
+ * `struct ras_storage_options_s`. Returns `0` on success, otherwise an
+ * error code found in `errno.h` with its sign flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ */
+RAS_EXPORT int
+ras_storage_init(
+  struct ras_storage_s *storage,
+  struct ras_storage_options_s options);
+
+/**
+ * Allocates and initializes a pointer to `struct ras_storage_s`. Returns
+ * `NULL` on error and `errno` is set to an error code found in `errno.h`.
+ */
+RAS_EXPORT struct ras_storage_s *
+ras_storage_new(struct ras_storage_options_s options);
+
+/**
+ * Frees a pointer to `struct ras_storage_s`.
+ */
+RAS_EXPORT void
+ras_storage_free(struct ras_storage_s *storage);
+
+/**
+ * Opens the storage interface. The storage interface must be initialized
+ * with an `open()` operation in `struct ras_storage_options_s` given to
+ * `ras_storage_new()` or `ras_storage_init()`.
+ */
+RAS_EXPORT int
+ras_storage_open(
+  struct ras_storage_s *storage,
+  ras_storage_open_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_open_shared(
+  struct ras_storage_s *storage,
+  ras_storage_open_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+/**
+ * Reads a buffer from the storage interface. The storage interface must be
+ * initialized with a `read()` operation in `struct ras_storage_options_s`
+ * given to `ras_storage_new()` or `ras_storage_init()`.
+ */
+RAS_EXPORT int
+ras_storage_read(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_read_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_read_shared(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_read_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+/**
+ * The `_ex` functions make the same request as the `_shared` function of
+ * the same name, scheduled and canceled by `control` if it is not `NULL`.
+ * The request is dispatched by the `priority` class and `deadline`, times
+ * out after `timeout` microseconds and is set to `handle` for
+ * `ras_storage_cancel()` until it is freed, see
+ * `struct ras_request_options_s`. `ras_storage_read_ex()`,
+ * `ras_storage_read_into_ex()`, `ras_storage_read_borrow_ex()`,
+ * `ras_storage_write_ex()`, `ras_storage_readv_ex()`,
+ * `ras_storage_writev_ex()` and `ras_storage_delete_ex()` are provided.
+ */
+RAS_EXPORT int
+ras_storage_read_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_read_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control);
+
+/**
+ * Reads a buffer from the storage interface into caller supplied memory.
+ * The storage interface writes directly into `buffer` which must be at least
+ * `size` bytes and remain valid until `callback` is called. No intermediate
+ * buffer is allocated for the request. The storage interface must be
+ * initialized with a `read()` operation in `struct ras_storage_options_s`
+ * given to `ras_storage_new()` or `ras_storage_init()`.
+ */
+RAS_EXPORT int
+ras_storage_read_into(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  void *buffer,
+  ras_storage_read_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_read_into_shared(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  void *buffer,
+  ras_storage_read_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+RAS_EXPORT int
+ras_storage_read_into_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  void *buffer,
+  ras_storage_read_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control);
+
+/**
+ * Reads a buffer from the storage interface without copying it. `callback`
+ * is given a pointer into the memory of the storage interface if it was
+ * initialized with a `borrow()` operation, otherwise into a buffer the
+ * request read into with its `read()` operation. The buffer is lent
+ * together with a `loan` token that must be given to
+ * `ras_storage_loan_release()` once the buffer is no longer needed. Until
+ * then writes and deletes that overlap the buffer and open, close and
+ * destroy requests are held back. Returns `0` on success, otherwise an
+ * error code found in `errno.h` with its sign flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ *   * `EINVAL`: The `callback` is `NULL`
+ */
+RAS_EXPORT int
+ras_storage_read_borrow(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_borrow_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_read_borrow_shared(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_borrow_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+RAS_EXPORT int
+ras_storage_read_borrow_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_borrow_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control);
+
+/**
+ * Releases a `loan` given to a `ras_storage_borrow_callback_t` callback and
+ * runs requests that were held back by it. The lent buffer must not be
+ * used after this call. May be called from the callback or any time after,
+ * and from any thread if the storage is thread-safe. Returns `0` on
+ * success, otherwise an error code found in `errno.h` with its sign
+ * flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_request_s *loan' is `NULL`
+ *   * `EINVAL`: The `loan` is not an outstanding loan
+ */
+RAS_EXPORT int
+ras_storage_loan_release(struct ras_request_s *loan);
+
+/**
+ * Writes a buffer to the storage interface. The storage interface must be
+ * initialized with a `write()` operation in `struct ras_storage_options_s`
+ * given to `ras_storage_new()` or `ras_storage_init()`.
+ */
+RAS_EXPORT int
+ras_storage_write(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  const void *buffer,
+  ras_storage_write_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_write_shared(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  const void *buffer,
+  ras_storage_write_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+RAS_EXPORT int
+ras_storage_write_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  const void *buffer,
+  ras_storage_write_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control);
+
+/**
+ * Reads `nsegments` (offset, size, buffer) segments from the storage
+ * interface as a single request that completes once. Each segment is read
+ * into its caller supplied `buffer` which must remain valid until `callback`
+ * is called. If the storage interface was initialized with a `readv()`
+ * operation in `struct ras_storage_options_s` it is given the entire vector,
+ * otherwise each segment is given to the `read()` operation.
+ */
+RAS_EXPORT int
+ras_storage_readv(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_readv_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_readv_shared(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_readv_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+RAS_EXPORT int
+ras_storage_readv_ex(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_readv_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control);
+
+/**
+ * Writes `nsegments` (offset, size, buffer) segments to the storage
+ * interface as a single request that completes once. If the storage
+ * interface was initialized with a `writev()` operation in
+ * `struct ras_storage_options_s` it is given the entire vector, otherwise
+ * each segment is given to the `write()` operation.
+ */
+RAS_EXPORT int
+ras_storage_writev(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_writev_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_writev_shared(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_writev_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+RAS_EXPORT int
+ras_storage_writev_ex(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_writev_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control);
+
+/**
+ * Deletes a buffer regionfrom the storage interface. The storage interface
+ * must be initialized with a `del()` operation in
+ * `struct ras_storage_options_s` given to `ras_storage_new()` or
+ * `ras_storage_init()`.
+ */
+RAS_EXPORT int
+ras_storage_delete(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_delete_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_delete_shared(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_delete_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+RAS_EXPORT int
+ras_storage_delete_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_delete_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control);
+
+/**
+ * Queries the storage interface for stats. The storage interface must be
+ * initialized with a `stat()` operation `struct ras_storage_options_s`
+ * given to `ras_storage_new()` or `ras_storage_init()`.
+ */
+RAS_EXPORT int
+ras_storage_stat(
+  struct ras_storage_s *storage,
+  ras_storage_stat_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_stat_shared(
+  struct ras_storage_s *storage,
+  ras_storage_stat_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+/**
+ * Flushes the writes the storage interface holds in memory, such as a
+ * write-back cache, to where it stores them. The flush is ordered after
+ * the writes and deletes made before it and completes once they are
+ * flushed. Storage interfaces initialized without a `flush()` operation in
+ * `struct ras_storage_options_s` hold no writes and complete the flush
+ * right away. Returns `0` on success, otherwise an error code found in
+ * `errno.h` with its sign flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ */
+RAS_EXPORT int
+ras_storage_flush(
+  struct ras_storage_s *storage,
+  ras_storage_flush_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_flush_shared(
+  struct ras_storage_s *storage,
+  ras_storage_flush_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+/**
+ * Syncs the data written to the storage interface to durable storage, such
+ * as with `fdatasync(2)`. The sync is ordered after the writes and deletes
+ * made before it and completes once they are durable. Storage interfaces
+ * initialized without a `sync()` operation in `struct ras_storage_options_s`
+ * complete the sync right away. Returns `0` on success, otherwise an error
+ * code found in `errno.h` with its sign flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ */
+RAS_EXPORT int
+ras_storage_sync(
+  struct ras_storage_s *storage,
+  ras_storage_sync_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_sync_shared(
+  struct ras_storage_s *storage,
+  ras_storage_sync_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+/**
+ * Closes the storage interface. The storage interface must be initialized
+ * with a `close()` operation in `struct ras_storage_options_s` given to
+ * `ras_storage_new()` or `ras_storage_init()`.
+ */
+RAS_EXPORT int
+ras_storage_close(
+  struct ras_storage_s *storage,
+  ras_storage_close_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_close_shared(
+  struct ras_storage_s *storage,
+  ras_storage_close_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+/**
+ * Destroys and frees a pointer to `struct ras_storage_s` to the storage
+ * interface. To handle the destruction of more memory, the storage interface
+ * must be initialized with a `destroy()` operation in
+ * `struct ras_storage_options_s` given to `ras_storage_new()` or
+ * `ras_storage_init()`.
+ */
+RAS_EXPORT int
+ras_storage_destroy(
+  struct ras_storage_s *storage,
+  ras_storage_destroy_callback_t *callback);
+
+RAS_EXPORT int
+ras_storage_destroy_shared(
+  struct ras_storage_s *storage,
+  ras_storage_destroy_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared);
+
+/**
+ * Submits a batch of `count` data requests described by `options` in a
+ * single pass. Every request is validated, allocated, and queued or run
+ * before any completes. Only `RAS_REQUEST_READ`, `RAS_REQUEST_WRITE`,
+ * `RAS_REQUEST_DELETE`, `RAS_REQUEST_STAT`, `RAS_REQUEST_READV` and
+ * `RAS_REQUEST_WRITEV` requests may be submitted. A `RAS_REQUEST_READ` with
+ * `data` behaves like `ras_storage_read_into()`. The `before` and `after`
+ * fields of each `struct ras_request_options_s` are ignored.
+ *
+ * If the storage interface was initialized with a `submit_batch()`
+ * operation in `struct ras_storage_options_s` and the storage is open and
+ * idle, it is given the entire batch, otherwise each request is run in
+ * order. The entire batch is only given to `submit_batch()` if it fits
+ * within `max_inflight`. Returns `0` on success, otherwise an error code
+ * found in `errno.h` with its sign flipped and `errno` set. No request in
+ * the batch is submitted on error.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ *   * `EINVAL`: A request in the batch has an unsupported type
+ *   * `EAGAIN`: The queue can not hold the entire batch
+ *   * `ENOMEM`: The batch could not be allocated
+ */
+RAS_EXPORT int
+ras_storage_submit(
+  struct ras_storage_s *storage,
+  const struct ras_request_options_s *options,
+  unsigned long int count);
+
+/**
+ * Returns the head of the queue pointing to a `struct ras_request_s` type and
+ * advances the head of the queue by 1.
+ */
+RAS_EXPORT struct ras_request_s *
+ras_storage_queue_shift(struct ras_storage_s *storage);
+
+/**
+ * Pushes a `struct ras_request_s` pointer on to the queue returning
+ * the new queue length. The queue grows on demand up to the `max_queued`
+ * high-water mark given in `struct ras_storage_options_s`. On error, an
+ * error code found in `errno.h` with its sign flipped is returned and
+ * `errno` set.
+ *
+ * A `RAS_EVENT_FULL` event is emitted when a request fills the queue up to
+ * `max_queued`, after which requests are rejected with `EAGAIN` without
+ * another event. A `RAS_EVENT_DRAIN` event is emitted once a full queue has
+ * been emptied.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ *   * `EAGAIN`: The queue is at its high-water mark
+ *   * `ENOMEM`: The queue could not grow
+ */
+RAS_EXPORT int
+ras_storage_queue_push(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request);
+
+/**
+ * Runs queued requests while they are ready to run. Data requests run while
+ * fewer than `max_inflight` requests are in flight. A data request that
+ * conflicts (see `ras_request_conflicts()`) with a request in flight waits for
+ * it to complete while later requests that do not conflict with it, or with
+ * any request in flight, run ahead of it. At most
+ * `RAS_STORAGE_QUEUE_LOOKAHEAD` queued requests are considered. While a
+ * request with a priority class other than `RAS_REQUEST_PRIORITY_NORMAL` or a
+ * deadline is queued, the request that can run with the most urgent deadline
+ * or priority class (see `struct ras_request_options_s`) runs first, never
+ * ahead of a request queued before it that it conflicts with. With
+ * `RAS_STORAGE_SCHEDULE_CSCAN`, requests that rank the same run in the order
+ * of their offsets from where the last read or write ended. Barrier requests
+ * (open, close, destroy) run once every request in flight has completed and
+ * block the queue until they complete. A read or write that can run is merged
+ * with the requests of the same type queued after it that touch or overlap its
+ * range, up to `RAS_STORAGE_MAX_COALESCE` bytes, and that no request they
+ * would overtake conflicts with. The storage interface is given a single read
+ * or write of a buffer spanning them, holding the data of merged writes with
+ * later writes winning where they overlap, and the callback of each merged
+ * request is called in queue order once it completes. Merged reads are given
+ * the slice of the read in their range, copied into their buffer if they were
+ * given one with `ras_storage_read_into()`. Returns the number of requests
+ * run.
+ */
+RAS_EXPORT int
+ras_storage_queue_drain(struct ras_storage_s *storage);
+
+/**
+ * Returns the `struct ras_request_s` pointer at `index` relative to the
+ * head of the queue or `NULL` if `index` is out of range.
+ */
+RAS_EXPORT struct ras_request_s *
+ras_storage_queue_at(struct ras_storage_s *storage, unsigned int index);
+
+/**
+ * Removes and returns the `struct ras_request_s` pointer at `index` relative
+ * to the head of the queue or `NULL` if `index` is out of range. Requests
+ * before `index` keep their order.
+ */
+RAS_EXPORT struct ras_request_s *
+ras_storage_queue_remove(struct ras_storage_s *storage, unsigned int index);
+
+/**
+ * Completes the queued requests of the storage whose timeout passed with
+ * `ETIMEDOUT` and gives the requests in flight whose timeout passed to the
+ * `cancel()` operation of the storage. Requests also time out when the queue
+ * is drained, so this only needs to be called periodically while requests
+ * may wait long without any completing. A storage destroyed in the callback
+ * of a request that timed out is destroyed once every request that timed
+ * out has completed. Returns the number of requests that timed out,
+ * otherwise an error code found in `errno.h` with its sign flipped and
+ * `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ */
+RAS_EXPORT int
+ras_storage_expire(struct ras_storage_s *storage);
+
+/**
+ * Cancels the request `handle` is set to, see `ras_request_cancel()`. The
+ * handle is read with the dispatch lock of the storage held, so unlike
+ * `ras_request_cancel()` this may be called on any thread, even while the
+ * request completes. Returns `0` on success, otherwise an error code found
+ * in `errno.h` with its sign flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' or `handle` is `NULL`
+ *   * `EINVAL`: The request is a barrier request or not of the `storage`
+ *   * `EALREADY`: The request completed, was canceled or timed out already
+ *   * `EBUSY`: The request is in flight and can not be canceled
+ */
+RAS_EXPORT int
+ras_storage_cancel(
+  struct ras_storage_s *storage,
+  struct ras_request_s **handle);
+
+/**
+ * Returns a copy of the dispatch counters of the storage.
+ */
+RAS_EXPORT struct ras_storage_counters_s
+ras_storage_counters(const struct ras_storage_s *storage);
+
+/**
+ * Returns an upper bound in nanoseconds of the time `percentile` percent
+ * of the requests of the `priority` class dispatched from the queue of the
+ * storage waited, such as `99` for the p99 queue wait, computed from the
+ * queue wait histogram. Returns `0` if no request of the class waited.
+ */
+RAS_EXPORT unsigned long int
+ras_storage_queue_wait_percentile(
+  const struct ras_storage_s *storage,
+  enum ras_request_priority priority,
+  unsigned int percentile);
+
+#endif
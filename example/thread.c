@@ -1,51 +1,23 @@
 #include <ras/ras.h>
-#include <pthread.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sched.h>
 #include <errno.h>
 #include <stdio.h>
 
-#define MAX_THREADS 16
+#define MAX_THREADS 4
 #define SHARED_MEMORY_BYTES 64
 
-typedef struct thread_s thread_t;
 typedef struct thread_context_s thread_context_t;
 
-typedef void *(pthread_start_routine_t)(void *);
-
-struct thread_s {
-  pthread_t id;
-  pthread_attr_t attr;
-  unsigned int index;
-  ras_request_t *request;
-};
-
 struct thread_context_s {
-  thread_t **threads;
-  unsigned int count;
   unsigned char *memory; // allocated in 'open()'
+  unsigned int done;
 };
 
 static void
-forward(ras_request_t *request, pthread_start_routine_t *start) {
-  thread_context_t *context = (thread_context_t *) request->storage->data;
-  thread_t **threads = context->threads;
-  thread_t *thread = malloc(sizeof(*thread));
-
-  *thread = (thread_t){ 0 };
-  thread->index = context->count;
-  thread->request = request;
-  context->threads[context->count++] = thread;
-
-  pthread_attr_init(&thread->attr);
-  pthread_create(&thread->id, &thread->attr, start, thread);
-}
-
-static void *
-open_storage_thread(void *arg) {
-  thread_t *thread = (thread_t *) arg;
-  ras_request_t *request = thread->request;
+open_storage(ras_request_t *request) {
   thread_context_t *context = (thread_context_t *) request->storage->data;
 
   if (0 == context->memory) {
@@ -53,15 +25,10 @@ open_storage_thread(void *arg) {
   }
 
   request->callback(request, 0, 0, 0);
-
-  pthread_exit(0);
-  return 0;
 }
 
-static void *
-close_storage_thread(void *arg) {
-  thread_t *thread = (thread_t *) arg;
-  ras_request_t *request = thread->request;
+static void
+close_storage(ras_request_t *request) {
   thread_context_t *context = (thread_context_t *) request->storage->data;
 
   if (0 != context->memory) {
@@ -72,15 +39,10 @@ close_storage_thread(void *arg) {
   }
 
   request->callback(request, 0, 0, 0);
-
-  pthread_exit(0);
-  return 0;
 }
 
-static void *
-destroy_storage_thread(void *arg) {
-  thread_t *thread = (thread_t *) arg;
-  ras_request_t *request = thread->request;
+static void
+destroy_storage(ras_request_t *request) {
   thread_context_t *context = (thread_context_t *) request->storage->data;
 
   if (0 != context->memory) {
@@ -89,14 +51,11 @@ destroy_storage_thread(void *arg) {
   }
 
   request->callback(request, 0, 0, 0);
-  pthread_exit(0);
-  return 0;
 }
 
-static void *
-read_storage_thread(void *arg) {
-  thread_t *thread = (thread_t *) arg;
-  ras_request_t *request = thread->request;
+// runs on an executor worker thread
+static void
+read_storage(ras_request_t *request) {
   thread_context_t *context = (thread_context_t *) request->storage->data;
 
   unsigned char *buffer = request->data;
@@ -109,14 +68,11 @@ read_storage_thread(void *arg) {
   }
 
   request->callback(request, 0, buffer, size);
-  pthread_exit(0);
-  return 0;
 }
 
-static void *
-write_storage_thread(void *arg) {
-  thread_t *thread = (thread_t *) arg;
-  ras_request_t *request = thread->request;
+// runs on an executor worker thread
+static void
+write_storage(ras_request_t *request) {
   thread_context_t *context = (thread_context_t *) request->storage->data;
 
   unsigned char *buffer = request->data;
@@ -129,33 +85,6 @@ write_storage_thread(void *arg) {
   }
 
   request->callback(request, 0, buffer, size);
-  pthread_exit(0);
-  return 0;
-}
-
-static void
-open_storage(ras_request_t *request) {
-  forward(request, open_storage_thread);
-}
-
-static void
-close_storage(ras_request_t *request) {
-  forward(request, close_storage_thread);
-}
-
-static void
-destroy_storage(ras_request_t *request) {
-  forward(request, destroy_storage_thread);
-}
-
-static void
-read_storage(ras_request_t *request) {
-  forward(request, read_storage_thread);
-}
-
-static void
-write_storage(ras_request_t *request) {
-  forward(request, write_storage_thread);
 }
 
 static void
@@ -170,7 +99,9 @@ onclose(ras_storage_t *storage, int err) {
 
 static void
 ondestroy(ras_storage_t *storage, int err) {
+  thread_context_t *context = (thread_context_t *) storage->data;
   printf("ondestroy(err=%d)\n", err);
+  __atomic_store_n(&context->done, 1, __ATOMIC_RELEASE);
 }
 
 static void
@@ -197,9 +128,10 @@ int
 main(void) {
   thread_context_t context = { 0 };
   ras_storage_t storage = { 0 };
-
-  context.threads = malloc(MAX_THREADS * sizeof(context.threads));
-  memset(context.threads, 0, sizeof(*context.threads));
+  ras_executor_t *executor = ras_executor_new(
+    (ras_executor_options_t) {
+      .workers = MAX_THREADS
+    });
 
   ras_storage_init(&storage,
     (ras_storage_options_t) {
@@ -208,21 +140,18 @@ main(void) {
       .read = read_storage,
       .write = write_storage,
       .close = close_storage,
-      .destroy = destroy_storage
+      .destroy = destroy_storage,
+      .executor = executor
     });
 
   const char *buffer = "hello";
   //ras_storage_open(&storage, onopen);
   ras_storage_write(&storage, 0, strlen(buffer), buffer, onwrite);
 
-  for (int i = 0; i < context.count; ++i) {
-    thread_t *thread = context.threads[i];
-    pthread_join(thread->id, 0);
-    context.threads[i] = 0;
-    free(thread);
+  while (0 == __atomic_load_n(&context.done, __ATOMIC_ACQUIRE)) {
+    sched_yield();
   }
 
-
-  free(context.threads);
+  ras_executor_free(executor);
   return 0;
 }
@@ -12,6 +12,8 @@ struct ras_allocator_stats_s;
 struct ras_allocator_stats_s {
   unsigned int alloc;
   unsigned int free;
+  unsigned int pool_hit;
+  unsigned int pool_miss;
 };
 
 /**
@@ -32,6 +34,19 @@ ras_allocator_alloc_count();
 RAS_EXPORT int
 ras_allocator_free_count();
 
+/**
+ * Returns number of requests served from a storage request pool.
+ */
+RAS_EXPORT int
+ras_allocator_pool_hit_count();
+
+/**
+ * Returns number of requests that missed a storage request pool
+ * and were allocated with `ras_alloc()`.
+ */
+RAS_EXPORT int
+ras_allocator_pool_miss_count();
+
 /**
  * Set the allocator function used in the library.
  * `malloc()=`
@@ -47,6 +47,8 @@ enum ras_event {
   RAS_EVENT_OPEN = 0xff + 4,
   RAS_EVENT_CLOSE = 0xff + 5,
   RAS_EVENT_DESTROY = 0xff + 6,
+  RAS_EVENT_FULL = 0xff + 7,
+  RAS_EVENT_DRAIN = 0xff + 8,
   RAS_STORAGE_EVENT_NONE = RAS_MAX_ENUM
 };
 
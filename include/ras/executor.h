@@ -0,0 +1,188 @@
+#ifndef RAS_EXECUTOR_H
+#define RAS_EXECUTOR_H
+
+#include <pthread.h>
+#include "platform.h"
+
+// Forward declarations
+struct ras_executor_s;
+struct ras_executor_task_s;
+struct ras_executor_stats_s;
+struct ras_executor_worker_s;
+struct ras_executor_options_s;
+
+/**
+ * The default number of worker threads used when `workers` is not given in
+ * `struct ras_executor_options_s`.
+ */
+#ifndef RAS_EXECUTOR_WORKERS
+#define RAS_EXECUTOR_WORKERS 4
+#endif
+
+/**
+ * The default initial capacity of the task deque of each worker used when
+ * `capacity` is not given in `struct ras_executor_options_s`. Deques grow
+ * by doubling their capacity on demand. This value must be a power of 2.
+ */
+#ifndef RAS_EXECUTOR_DEQUE_CAPACITY
+#define RAS_EXECUTOR_DEQUE_CAPACITY 64
+#endif
+
+/**
+ * The `ras_executor_work_t` callback represents a unit of work run on a
+ * worker thread of an executor.
+ */
+typedef void (ras_executor_work_t)(void *data);
+
+/**
+ * Represents a unit of work queued on a worker deque.
+ */
+struct ras_executor_task_s {
+  ras_executor_work_t *work;
+  void *data;
+};
+
+/**
+ * Fields for `struct ras_executor_worker_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_EXECUTOR_WORKER_FIELDS       \
+  struct ras_executor_s *executor;       \
+  struct ras_executor_task_s *tasks;     \
+  unsigned int index;                    \
+  unsigned int lock;                     \
+  unsigned int head;                     \
+  unsigned int size;                     \
+  unsigned int capacity;                 \
+  unsigned long int executed;            \
+  unsigned long int stolen;              \
+  pthread_t thread;
+
+/**
+ * Represents a worker thread and its task deque. The worker runs tasks
+ * from the bottom of its own deque and steals tasks from the top of the
+ * deques of other workers when its own deque is empty.
+ */
+struct ras_executor_worker_s {
+  RAS_EXECUTOR_WORKER_FIELDS
+};
+
+/**
+ * Fields for `struct ras_executor_options_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ *
+ * layout= [ workers=0, capacity=1 ]
+ */
+#define RAS_EXECUTOR_OPTIONS_FIELDS \
+  unsigned int workers;             \
+  unsigned int capacity;
+
+/**
+ * Represents the initial configurable state for an executor. The
+ * `capacity` of the task deque of each worker is rounded up to a power of
+ * 2.
+ */
+struct ras_executor_options_s {
+  RAS_EXECUTOR_OPTIONS_FIELDS
+};
+
+/**
+ * Fields for `struct ras_executor_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_EXECUTOR_FIELDS                \
+  unsigned int alloc:1;                    \
+  unsigned int stopping;                   \
+  unsigned int sleeping;                   \
+  unsigned int queued;                     \
+  unsigned int next;                       \
+  unsigned int started;                    \
+  struct ras_executor_worker_s *workers;   \
+  struct ras_executor_worker_s *reaper;    \
+  pthread_mutex_t mutex;                   \
+  pthread_cond_t cond;                     \
+  struct ras_executor_options_s options;
+
+/**
+ * Represents a fixed pool of worker threads that run blocking storage
+ * interface operations off the thread that makes requests.
+ */
+struct ras_executor_s {
+  RAS_EXECUTOR_FIELDS
+};
+
+/**
+ * Represents the counters of an executor summed over its workers.
+ */
+struct ras_executor_stats_s {
+  unsigned long int executed;
+  unsigned long int stolen;
+};
+
+/**
+ * Allocates a pointer to 'struct ras_executor_s'.
+ * Calls 'ras_alloc()' internally and will return 'NULL'
+ * on allocation errors.
+ */
+RAS_EXPORT struct ras_executor_s *
+ras_executor_alloc();
+
+/**
+ * Initializes a pointer to `struct ras_executor_s` with options from
+ * `struct ras_executor_options_s` and starts its worker threads. Returns `0`
+ * on success, otherwise an error code found in `errno.h` with its sign
+ * flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_executor_s *executor' is `NULL`
+ *   * `EINVAL`: The `capacity` can not be rounded up to a power of 2
+ *   * `ENOMEM`: The workers could not be allocated
+ *   * `EAGAIN`: A worker thread could not be started
+ */
+RAS_EXPORT int
+ras_executor_init(
+  struct ras_executor_s *executor,
+  struct ras_executor_options_s options);
+
+/**
+ * Allocates and initializes a pointer to `struct ras_executor_s`. Returns
+ * `NULL` on error and `errno` is set to an error code found in `errno.h`.
+ */
+RAS_EXPORT struct ras_executor_s *
+ras_executor_new(struct ras_executor_options_s options);
+
+/**
+ * Stops and frees a pointer to `struct ras_executor_s`. Tasks that were
+ * submitted before, or while, the executor stops are run before the worker
+ * threads are joined. Storages using the executor must be destroyed first.
+ * When called from a worker thread of the executor, for example by a
+ * storage destroyed on that thread, the other workers are joined and the
+ * calling worker frees the executor once its current task returns.
+ */
+RAS_EXPORT void
+ras_executor_free(struct ras_executor_s *executor);
+
+/**
+ * Submits `work` to be called with `data` on a worker thread. Work submitted
+ * from a worker thread is queued on the deque of that worker, otherwise
+ * workers are chosen round-robin. Returns `0` on success, otherwise an error
+ * code found in `errno.h` with its sign flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_executor_s *executor' or `work` is `NULL`
+ *   * `ECANCELED`: The executor is stopping
+ *   * `ENOMEM`: The deque of the worker could not grow
+ */
+RAS_EXPORT int
+ras_executor_submit(
+  struct ras_executor_s *executor,
+  ras_executor_work_t *work,
+  void *data);
+
+/**
+ * Returns the counters of the executor.
+ */
+RAS_EXPORT struct ras_executor_stats_s
+ras_executor_stats(struct ras_executor_s *executor);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef RAS_FILE_H
+#define RAS_FILE_H
+
+#include "platform.h"
+#include "storage.h"
+
+// Forward declarations
+struct ras_file_storage_s;
+
+/**
+ * The mode a file is created with when `O_CREAT` is given to
+ * `ras_file_storage_new()`.
+ */
+#ifndef RAS_FILE_MODE
+#define RAS_FILE_MODE 0644
+#endif
+
+/**
+ * Fields for `struct ras_file_storage_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_FILE_STORAGE_FIELDS \
+  RAS_STORAGE_FIELDS            \
+  char *path;                   \
+  int flags;                    \
+  int fd;
+
+/**
+ * Represents a storage for a file that is opened once and read and written
+ * with positional `pread(2)` and `pwrite(2)` calls.
+ */
+struct ras_file_storage_s {
+  RAS_FILE_STORAGE_FIELDS
+};
+
+/**
+ * Allocates and initializes a storage for the file at `path`, opened with
+ * `open(2)` `flags` by `ras_storage_open()` or implicitly by the first
+ * request. Short reads and writes are continued until the request is
+ * done; a read returns fewer bytes only at the end of the file. `stat`
+ * uses `fstat(2)` and `del` punches a hole with `fallocate(2)`, writing
+ * zeros on file systems that do not support it and `sync` uses
+ * `fdatasync(2)`, shared by the sync requests dispatched together. Offsets
+ * are `unsigned long int` and are given to the file operations as a 64-bit
+ * `off_t`, so files larger than 4 GiB can be read and written where
+ * `unsigned long int` is 64-bit, such as on LP64 platforms. Returns `NULL`
+ * on error and `errno` is set to an error code found in `errno.h`.
+ */
+RAS_EXPORT struct ras_storage_s *
+ras_file_storage_new(const char *path, int flags);
+
+#endif
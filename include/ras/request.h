@@ -7,6 +7,7 @@
 struct ras_request_s;
 struct ras_storage_s;
 struct ras_request_options_s;
+struct ras_request_segment_s;
 
 /**
  * The `ras_request_callback_t` callback represents the user
@@ -29,29 +30,99 @@ enum ras_request_type {
   RAS_REQUEST_OPEN = 4,
   RAS_REQUEST_CLOSE = 5,
   RAS_REQUEST_DESTROY = 6,
+  RAS_REQUEST_READV = 7,
+  RAS_REQUEST_WRITEV = 8,
+  RAS_REQUEST_BORROW = 9,
+  RAS_REQUEST_FLUSH = 10,
+  RAS_REQUEST_SYNC = 11,
   RAS_REQUEST_NONE = RAS_MAX_ENUM
 };
 
+/**
+ * Priority classes of queued requests. Requests of a higher class are
+ * dispatched before requests of a lower class queued before them.
+ *
+ *   * `RAS_REQUEST_PRIORITY_NORMAL`: The default class
+ *   * `RAS_REQUEST_PRIORITY_HIGH`: Latency critical requests, such as reads
+ *     a caller waits on
+ *   * `RAS_REQUEST_PRIORITY_LOW`: Background requests, such as compaction
+ */
+enum ras_request_priority {
+  RAS_REQUEST_PRIORITY_NORMAL = 0,
+  RAS_REQUEST_PRIORITY_HIGH = 1,
+  RAS_REQUEST_PRIORITY_LOW = 2,
+};
+
+/**
+ * The number of `enum ras_request_priority` classes.
+ */
+#define RAS_REQUEST_PRIORITIES 3
+
+/**
+ * Fields for `struct ras_request_control_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ *
+ * layout= [ priority=0, deadline=1, timeout=2, handle=3 ]
+ */
+#define RAS_REQUEST_CONTROL_FIELDS        \
+  enum ras_request_priority priority;     \
+  unsigned long int deadline;             \
+  unsigned long int timeout;              \
+  struct ras_request_s **handle;
+
+/**
+ * Represents how a request made with one of the `ras_storage_*_ex()`
+ * functions is scheduled and canceled. The fields have the meaning of the
+ * fields of the same name in `struct ras_request_options_s`.
+ */
+struct ras_request_control_s {
+  RAS_REQUEST_CONTROL_FIELDS
+};
+
+/**
+ * Represents a single (offset, size, buffer) segment of a vectored
+ * `RAS_REQUEST_READV` or `RAS_REQUEST_WRITEV` request.
+ */
+struct ras_request_segment_s {
+  unsigned long int offset;
+  unsigned long int size;
+  void *buffer;
+};
+
 /**
  * Fields for `struct ras_request_options_s` that can be used for
  * extending structures that ensure correct memory layout.
  */
-#define RAS_REQUEST_OPTIONS_FIELDS  \
-  enum ras_request_type type;       \
-  struct ras_storage_s *storage;    \
-  ras_request_callback_t *before;   \
-  ras_request_callback_t *after;    \
-  ras_request_callback_t *emit;     \
-  ras_request_callback_t *hook;     \
-  unsigned long int offset;         \
-  unsigned long int size;           \
-  void *callback;                   \
-  void *shared;                     \
-  void *data;
+#define RAS_REQUEST_OPTIONS_FIELDS        \
+  enum ras_request_type type;             \
+  struct ras_storage_s *storage;          \
+  ras_request_callback_t *before;         \
+  ras_request_callback_t *after;          \
+  ras_request_callback_t *emit;           \
+  ras_request_callback_t *hook;           \
+  unsigned long int offset;               \
+  unsigned long int size;                 \
+  void *callback;                         \
+  void *shared;                           \
+  void *data;                             \
+  struct ras_request_segment_s *segments; \
+  unsigned long int nsegments;            \
+  enum ras_request_priority priority;     \
+  unsigned long int deadline;             \
+  unsigned long int timeout;              \
+  struct ras_request_s **handle;
 
 /**
  * Represents the initial configurable state for a random access storage
- * opertion request context.
+ * opertion request context. A queued request is dispatched by its
+ * `priority` class and, if `deadline` is not `0`, before requests of its
+ * class without one or with a later one and before every class once
+ * `deadline` microseconds passed since it was made. If `timeout` is not
+ * `0`, the request completes with `ETIMEDOUT` if it is still queued
+ * `timeout` microseconds after it was made and is given to the `cancel()`
+ * operation of its storage if it is in flight. If `handle` is not `NULL`,
+ * it is set to the request, which can be canceled with it through
+ * `ras_storage_cancel()`, and set to `NULL` once the request is freed.
  */
 struct ras_request_options_s {
   RAS_REQUEST_OPTIONS_FIELDS
@@ -61,24 +132,45 @@ struct ras_request_options_s {
  * Fields for `struct ras_request_s` that can be used for
  * extending structures that ensure correct memory layout.
  */
-#define RAS_REQUEST_FIELDS          \
-  unsigned int alloc:1;             \
-  unsigned int id;                  \
-  int err;                          \
-  unsigned long int offset;         \
-  unsigned long int size;           \
-  unsigned int pending:1;           \
-  unsigned int destroyed:1;         \
-  enum ras_request_type type;       \
-  struct ras_storage_s *storage;    \
-  ras_request_callback_t *before;   \
-  ras_request_callback_t *callback; \
-  ras_request_callback_t *after;    \
-  ras_request_callback_t *emit;     \
-  ras_request_callback_t *hook;     \
-  void *shared;                     \
-  void *data;                       \
-  void *done;
+#define RAS_REQUEST_FIELDS                \
+  unsigned int alloc:1;                   \
+  unsigned int id;                        \
+  int err;                                \
+  unsigned long int offset;               \
+  unsigned long int size;                 \
+  unsigned int pending:1;                 \
+  unsigned int destroyed:1;               \
+  enum ras_request_type type;             \
+  struct ras_storage_s *storage;          \
+  ras_request_callback_t *before;         \
+  ras_request_callback_t *callback;       \
+  ras_request_callback_t *after;          \
+  ras_request_callback_t *emit;           \
+  ras_request_callback_t *hook;           \
+  void *shared;                           \
+  void *data;                             \
+  void *done;                             \
+  struct ras_request_s *next;             \
+  struct ras_request_s *parent;           \
+  struct ras_request_segment_s *segments; \
+  unsigned long int nsegments;            \
+  unsigned long int remaining;            \
+  unsigned long int transferred;          \
+  struct ras_request_s *inflight_prev;    \
+  struct ras_request_s *inflight_next;    \
+  struct ras_request_s *joined;           \
+  enum ras_request_priority priority;     \
+  unsigned long int deadline;             \
+  unsigned long int queued_at;            \
+  unsigned long int expires;              \
+  struct ras_request_s **handle;          \
+  unsigned int slot;                      \
+  unsigned int queued:1;                  \
+  unsigned int running:1;                 \
+  int canceled;                           \
+  unsigned int stalled:1;                 \
+  unsigned int loaned:1;                  \
+  void (*operation)(struct ras_request_s *);
 
 /**
  * Represents the state for a random access storage operation context.
@@ -109,18 +201,66 @@ ras_request_init(
   const struct ras_request_options_s options);
 
 /**
- * Allocates and initializes a pointer to `struct ras_request_s`. Returns
- * `NULL` on error and `errno` is set to an error code found in `errno.h`.
+ * Allocates and initializes a pointer to `struct ras_request_s`. The request
+ * is taken from the request pool of `options.storage` when one is available,
+ * otherwise it is allocated with `ras_request_alloc()`. Returns `NULL` on
+ * error and `errno` is set to an error code found in `errno.h`.
  */
 RAS_EXPORT struct ras_request_s *
 ras_request_new(const struct ras_request_options_s options);
 
 /**
- * Frees a pointer to `struct ras_request_s`.
+ * Frees a pointer to `struct ras_request_s`. The request is returned to the
+ * request pool of its storage if the pool has not reached `pool_size`.
  */
 RAS_EXPORT void
 ras_request_free(struct ras_request_s *request);
 
+/**
+ * Cancels `request`, which completes with `ECANCELED`. A queued request is
+ * removed from the queue in constant time, no longer counts towards
+ * `max_queued` and completes right away. A
+ * request in flight is given to the `cancel()` operation of its storage,
+ * if it has one, and completes with `ECANCELED` if it then fails, or with
+ * its result if it completed anyway. With a `thread_safe` storage a request
+ * may complete, and be freed or reused from the pool, on another thread at
+ * any time, so this is only valid where it can not, such as in a callback
+ * of a request of the same storage. Use `ras_storage_cancel()` with the
+ * handle of the request anywhere else. Returns `0` on success, otherwise
+ * an error code found in `errno.h` with its sign flipped and `errno` set.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_request_s *request' is `NULL` or was freed
+ *   * `EINVAL`: The `request` is a barrier request
+ *   * `EALREADY`: The `request` was canceled or timed out already
+ *   * `EBUSY`: The `request` is in flight and can not be canceled
+ */
+RAS_EXPORT int
+ras_request_cancel(struct ras_request_s *request);
+
+/**
+ * Returns `1` if requests of `type` are barriers, otherwise `0`. A barrier
+ * (`RAS_REQUEST_OPEN`, `RAS_REQUEST_CLOSE` and `RAS_REQUEST_DESTROY`) waits
+ * for every request in flight to complete before it runs and no request
+ * queued after it runs until it completes.
+ */
+RAS_EXPORT int
+ras_request_is_barrier(enum ras_request_type type);
+
+/**
+ * Returns `1` if request `b` must wait for request `a` (or the other way
+ * around) to complete, otherwise `0`. Requests conflict when either is a
+ * barrier or when either writes (`RAS_REQUEST_WRITE`, `RAS_REQUEST_WRITEV`,
+ * `RAS_REQUEST_DELETE`) to a `[offset, offset + size)` range that overlaps
+ * the range of the other. A `RAS_REQUEST_STAT`, a `RAS_REQUEST_FLUSH` and
+ * a `RAS_REQUEST_SYNC` cover the entire storage.
+ * Reads never conflict with reads.
+ */
+RAS_EXPORT int
+ras_request_conflicts(
+  const struct ras_request_s *a,
+  const struct ras_request_s *b);
+
 /**
  * Runs the request for a random access operation.
  */
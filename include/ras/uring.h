@@ -0,0 +1,113 @@
+#ifndef RAS_URING_H
+#define RAS_URING_H
+
+#include <sys/uio.h>
+#include "executor.h"
+#include "platform.h"
+#include "storage.h"
+
+// Forward declarations
+struct ras_uring_s;
+struct ras_uring_storage_s;
+struct ras_uring_storage_options_s;
+
+/**
+ * The default number of submission queue entries of the io_uring used when
+ * `entries` is not given in `struct ras_uring_storage_options_s`. This
+ * value must be a power of 2.
+ */
+#ifndef RAS_URING_ENTRIES
+#define RAS_URING_ENTRIES 256
+#endif
+
+/**
+ * Fields for `struct ras_uring_storage_options_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ *
+ * layout= [
+ *   flags=0, mode=1, entries=2, buffers=3, nbuffers=4,
+ *   workers=5, fallback=6, sync_window=7,
+ * ]
+ */
+#define RAS_URING_STORAGE_OPTIONS_FIELDS \
+  int flags;                             \
+  unsigned int mode;                     \
+  unsigned int entries;                  \
+  struct iovec *buffers;                 \
+  unsigned int nbuffers;                 \
+  unsigned int workers;                  \
+  unsigned int fallback;                 \
+  unsigned long int sync_window;
+
+/**
+ * Represents the initial configurable state for an io_uring backed file
+ * storage. `flags` and `mode` are given to `open(2)`. `buffers` are
+ * registered with the io_uring and reads and writes whose buffer lies
+ * within one of them use fixed buffer operations. `workers` is the size of
+ * the `pread(2)`/`pwrite(2)` pool used when io_uring is not available or
+ * `fallback` is not `0`. Sync requests use `fdatasync(2)`, shared by the
+ * sync requests made while one is in flight, and `sync_window` is the
+ * `sync_window` of `struct ras_storage_options_s` for the pool.
+ */
+struct ras_uring_storage_options_s {
+  RAS_URING_STORAGE_OPTIONS_FIELDS
+};
+
+/**
+ * Fields for `struct ras_uring_storage_s` that can be used for
+ * extending structures that ensure correct memory layout.
+ */
+#define RAS_URING_STORAGE_FIELDS                    \
+  RAS_STORAGE_FIELDS                                \
+  struct ras_uring_storage_options_s uring_options; \
+  struct ras_uring_s *ring;                         \
+  struct ras_executor_s *executor;                  \
+  char *path;                                       \
+  int fd;
+
+/**
+ * Represents a file storage whose operations are submitted to a Linux
+ * io_uring. Submissions are batched until `ras_uring_storage_poll()` is
+ * called or the submission queue is full.
+ */
+struct ras_uring_storage_s {
+  RAS_URING_STORAGE_FIELDS
+};
+
+/**
+ * Allocates and initializes an io_uring backed storage for the file at
+ * `path`. The file is opened by `ras_storage_open()` or implicitly by the
+ * first request. If the kernel does not support io_uring, operations run
+ * with `pread(2)` and `pwrite(2)` on an executor thread pool instead and
+ * complete on its worker threads. Returns `NULL` on error and `errno` is
+ * set to an error code found in `errno.h`.
+ */
+RAS_EXPORT struct ras_storage_s *
+ras_uring_storage_new(
+  const char *path,
+  struct ras_uring_storage_options_s options);
+
+/**
+ * Submits batched operations and reaps completed operations of an io_uring
+ * backed storage, calling request callbacks on the calling thread. Waits for
+ * at least `wait` operations to complete. Requests whose timeout passed are
+ * timed out first with `ras_storage_expire()`, operations in flight are
+ * cancelled with `IORING_OP_ASYNC_CANCEL`. Returns the number of operations
+ * reaped, otherwise an error code found in `errno.h` with its sign flipped and
+ * `errno` set. Returns `0` when using the `pread(2)` and `pwrite(2)` pool. The
+ * storage may be freed by a destroy request completed in this call.
+ *
+ * Possible Error Codes
+ *   * `EFAULT`: The 'struct ras_storage_s *storage' is `NULL`
+ */
+RAS_EXPORT int
+ras_uring_storage_poll(struct ras_storage_s *storage, unsigned int wait);
+
+/**
+ * Returns `1` if the storage submits operations to an io_uring, otherwise
+ * `0` if it uses the `pread(2)` and `pwrite(2)` pool.
+ */
+RAS_EXPORT int
+ras_uring_storage_supported(struct ras_storage_s *storage);
+
+#endif
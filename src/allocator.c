@@ -1,4 +1,5 @@
 #include "ras/allocator.h"
+#include "stats.h"
 #include <stdlib.h>
 
 #ifndef RAS_ALLOCATOR_ALLOC
@@ -14,22 +15,52 @@ static void (*dealloc)(void *) = RAS_ALLOCATOR_FREE;
 
 static struct ras_allocator_stats_s stats = { 0 };
 
+// counters are updated atomically so storages in thread-safe mode
+// may allocate from any thread
+#define INCREMENT(counter) \
+  (void) __atomic_fetch_add(&(counter), 1, __ATOMIC_RELAXED)
+
+#define LOAD(counter) \
+  __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
 const struct ras_allocator_stats_s
 ras_allocator_stats() {
   return (struct ras_allocator_stats_s) {
-    .alloc = stats.alloc,
-    .free = stats.free
+    .alloc = LOAD(stats.alloc),
+    .free = LOAD(stats.free),
+    .pool_hit = LOAD(stats.pool_hit),
+    .pool_miss = LOAD(stats.pool_miss)
   };
 }
 
 int
 ras_allocator_alloc_count() {
-  return stats.alloc;
+  return LOAD(stats.alloc);
 }
 
 int
 ras_allocator_free_count() {
-  return stats.free;
+  return LOAD(stats.free);
+}
+
+int
+ras_allocator_pool_hit_count() {
+  return LOAD(stats.pool_hit);
+}
+
+int
+ras_allocator_pool_miss_count() {
+  return LOAD(stats.pool_miss);
+}
+
+void
+ras_allocator_stats_pool_hit() {
+  INCREMENT(stats.pool_hit);
+}
+
+void
+ras_allocator_stats_pool_miss() {
+  INCREMENT(stats.pool_miss);
 }
 
 void
@@ -47,10 +78,10 @@ ras_alloc(unsigned long int size) {
   if (0 == size) {
     return 0;
   } else if (0 != alloc) {
-    (void) stats.alloc++;
+    INCREMENT(stats.alloc);
     return alloc(size);
   } else {
-    (void) stats.alloc++;
+    INCREMENT(stats.alloc);
     return malloc(size);
   }
 }
@@ -60,10 +91,10 @@ ras_free(void *ptr) {
   if (0 == ptr) {
     return;
   } else if (0 != dealloc) {
-    (void) stats.free++;
+    INCREMENT(stats.free);
     dealloc(ptr);
   } else {
-    (void) stats.free++;
+    INCREMENT(stats.free);
     free(ptr);
   }
 }
@@ -0,0 +1,1629 @@
+#include "ras/allocator.h"
+#include "ras/cache.h"
+#include "ras/emitter.h"
+#include "ras/request.h"
+#include "ras/storage.h"
+#include "dispatch.h"
+#include "require.h"
+#include "clock.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define RAS_CACHE_NONE ((unsigned long int) -1)
+
+/**
+ * The lists an entry of the cache is on. Resident blocks are on `T1` and,
+ * for `RAS_CACHE_ARC`, on `T2` once they are read again. `B1` and `B2` are
+ * the ARC ghost lists of the blocks recently evicted from `T1` and `T2`,
+ * which hold no data.
+ */
+enum ras_cache_list {
+  RAS_CACHE_T1 = 0,
+  RAS_CACHE_T2 = 1,
+  RAS_CACHE_B1 = 2,
+  RAS_CACHE_B2 = 3,
+  RAS_CACHE_FREE = 4,
+  RAS_CACHE_LISTS = 5,
+};
+
+/**
+ * The write-back states of a cached block. A `RAS_CACHE_FLUSHING` block is
+ * being written to the inner storage and becomes `RAS_CACHE_CLEAN` once
+ * that write completes, unless it was written to again meanwhile.
+ */
+enum ras_cache_state {
+  RAS_CACHE_CLEAN = 0,
+  RAS_CACHE_DIRTY = 1,
+  RAS_CACHE_FLUSHING = 2,
+};
+
+/**
+ * An entry of the cache for the block at `key`, linked on its list by
+ * index with the most recently used entry at the head.
+ */
+struct ras_cache_entry_s {
+  unsigned long int key;
+  unsigned long int prev;
+  unsigned long int next;
+  unsigned char *data;
+  unsigned int list;
+  unsigned int referenced;
+  unsigned int state;
+};
+
+struct ras_cache_list_s {
+  unsigned long int head;
+  unsigned long int tail;
+  unsigned long int size;
+};
+
+/**
+ * The state of a block cache. `table` maps keys to entries with linear
+ * probing, `spare` holds the block buffers not in use, `target` is the
+ * ARC target size of `T1` and `hand` the position of the CLOCK hand. In
+ * write-back mode `flushing` counts the flushes in flight, `finished` holds
+ * the flushes done while others are not, `dirtied` is when the oldest
+ * dirty block became dirty and `length` the end of the furthest write kept
+ * in the cache.
+ */
+struct ras_cache_s {
+  struct ras_cache_list_s lists[RAS_CACHE_LISTS];
+  struct ras_cache_entry_s *entries;
+  struct ras_cache_flush_s *finished;
+  unsigned long int *table;
+  unsigned char **spare;
+  unsigned char *memory;
+  unsigned long int nentries;
+  unsigned long int nspare;
+  unsigned long int mask;
+  unsigned long int target;
+  unsigned long int hand;
+  unsigned long int flushing;
+  unsigned long int dirtied;
+  unsigned long int length;
+  unsigned int bits;
+};
+
+/**
+ * A read of the blocks a read of the cache storage touches that are not
+ * cached from the inner storage, from the first to the last of them.
+ * `resident` marks the blocks in between that were cached, and copied,
+ * when it was made. `generation` is the generation of the cache storage
+ * when it was made so blocks are not cached if a write or delete raced
+ * with it.
+ */
+struct ras_cache_fill_s {
+  struct ras_request_s *request;
+  unsigned long int generation;
+  unsigned long int offset;
+  unsigned long int size;
+  unsigned char *resident;
+  unsigned char data[];
+};
+
+/**
+ * A flush of the dirty blocks of a write-back cache storage. `pending`
+ * counts its runs in flight, and one more until they are all started.
+ * `request` is the flush, close or destroy request it was made for, if any.
+ */
+struct ras_cache_flush_s {
+  struct ras_cache_storage_s *storage;
+  struct ras_request_s *request;
+  struct ras_cache_flush_s *next;
+  unsigned long int started;
+  unsigned long int pending;
+  unsigned long int bytes;
+  int err;
+};
+
+/**
+ * A write of `count` consecutive dirty blocks from `key` to the inner
+ * storage, copied when it was made.
+ */
+struct ras_cache_run_s {
+  struct ras_cache_flush_s *flush;
+  unsigned long int key;
+  unsigned long int count;
+  unsigned char data[];
+};
+
+typedef void (ras_cache_visit_t)(
+  struct ras_cache_storage_s *storage,
+  unsigned long int index,
+  struct ras_request_s *request);
+
+static unsigned long int
+ras_cache_hash(const struct ras_cache_s *cache, unsigned long int key) {
+  return (key * 0x9e3779b97f4a7c15UL) >> (64 - cache->bits);
+}
+
+static unsigned long int
+ras_cache_find(const struct ras_cache_s *cache, unsigned long int key) {
+  unsigned long int slot = ras_cache_hash(cache, key);
+
+  while (RAS_CACHE_NONE != cache->table[slot]) {
+    if (key == cache->entries[cache->table[slot]].key) {
+      return cache->table[slot];
+    }
+
+    slot = (slot + 1) & cache->mask;
+  }
+
+  return RAS_CACHE_NONE;
+}
+
+static void
+ras_cache_table_insert(struct ras_cache_s *cache, unsigned long int index) {
+  unsigned long int slot = ras_cache_hash(cache, cache->entries[index].key);
+
+  while (RAS_CACHE_NONE != cache->table[slot]) {
+    slot = (slot + 1) & cache->mask;
+  }
+
+  cache->table[slot] = index;
+}
+
+/**
+ * Removes the entry at `index` from the table, shifting the entries
+ * probed past it back so lookups never need tombstones.
+ */
+static void
+ras_cache_table_remove(struct ras_cache_s *cache, unsigned long int index) {
+  unsigned long int slot = ras_cache_hash(cache, cache->entries[index].key);
+  unsigned long int next = 0;
+
+  while (index != cache->table[slot]) {
+    slot = (slot + 1) & cache->mask;
+  }
+
+  for (next = (slot + 1) & cache->mask;
+       RAS_CACHE_NONE != cache->table[next];
+       next = (next + 1) & cache->mask) {
+    const unsigned long int home =
+      ras_cache_hash(cache, cache->entries[cache->table[next]].key);
+
+    // an entry may move back unless its home lies between the hole and it
+    if (((next - home) & cache->mask) >= ((next - slot) & cache->mask)) {
+      cache->table[slot] = cache->table[next];
+      slot = next;
+    }
+  }
+
+  cache->table[slot] = RAS_CACHE_NONE;
+}
+
+static void
+ras_cache_unlink(struct ras_cache_s *cache, unsigned long int index) {
+  struct ras_cache_entry_s *entry = &cache->entries[index];
+  struct ras_cache_list_s *list = &cache->lists[entry->list];
+
+  if (RAS_CACHE_NONE == entry->prev) {
+    list->head = entry->next;
+  } else {
+    cache->entries[entry->prev].next = entry->next;
+  }
+
+  if (RAS_CACHE_NONE == entry->next) {
+    list->tail = entry->prev;
+  } else {
+    cache->entries[entry->next].prev = entry->prev;
+  }
+
+  list->size--;
+}
+
+static void
+ras_cache_push(
+  struct ras_cache_s *cache,
+  unsigned int list,
+  unsigned long int index
+) {
+  struct ras_cache_entry_s *entry = &cache->entries[index];
+
+  entry->list = list;
+  entry->prev = RAS_CACHE_NONE;
+  entry->next = cache->lists[list].head;
+
+  if (RAS_CACHE_NONE == entry->next) {
+    cache->lists[list].tail = index;
+  } else {
+    cache->entries[entry->next].prev = index;
+  }
+
+  cache->lists[list].head = index;
+  cache->lists[list].size++;
+}
+
+/**
+ * Moves the block at `index` to the ghost `list`, giving back its buffer.
+ */
+static void
+ras_cache_demote(
+  struct ras_cache_storage_s *storage,
+  unsigned long int index,
+  unsigned int list
+) {
+  struct ras_cache_s *cache = storage->cache;
+  struct ras_cache_entry_s *entry = 0;
+
+  if (RAS_CACHE_NONE == index) {
+    return;
+  }
+
+  entry = &cache->entries[index];
+  cache->spare[cache->nspare++] = entry->data;
+  entry->data = 0;
+  storage->cached--;
+  storage->evictions++;
+  ras_cache_unlink(cache, index);
+  ras_cache_push(cache, list, index);
+}
+
+/**
+ * Forgets the entry at `index`, giving back its buffer if it has one.
+ */
+static void
+ras_cache_release(
+  struct ras_cache_storage_s *storage,
+  unsigned long int index
+) {
+  struct ras_cache_s *cache = storage->cache;
+  struct ras_cache_entry_s *entry = 0;
+
+  if (RAS_CACHE_NONE == index) {
+    return;
+  }
+
+  entry = &cache->entries[index];
+
+  if (0 != entry->data) {
+    cache->spare[cache->nspare++] = entry->data;
+    entry->data = 0;
+    storage->cached--;
+  }
+
+  ras_cache_table_remove(cache, index);
+  ras_cache_unlink(cache, index);
+  ras_cache_push(cache, RAS_CACHE_FREE, index);
+}
+
+static void
+ras_cache_evict(struct ras_cache_storage_s *storage, unsigned long int index) {
+  if (RAS_CACHE_NONE != index) {
+    storage->evictions++;
+    ras_cache_release(storage, index);
+  }
+}
+
+/**
+ * Returns the least recently used block of `list` that is not dirty, or
+ * `RAS_CACHE_NONE` if every block of it is.
+ */
+static unsigned long int
+ras_cache_clean_tail(const struct ras_cache_s *cache, unsigned int list) {
+  unsigned long int index = cache->lists[list].tail;
+
+  while (
+    RAS_CACHE_NONE != index &&
+    RAS_CACHE_CLEAN != cache->entries[index].state
+  ) {
+    index = cache->entries[index].prev;
+  }
+
+  return index;
+}
+
+static unsigned long int
+ras_cache_clock_victim(struct ras_cache_s *cache) {
+  // two sweeps clear every reference bit, so only dirty blocks are left
+  for (unsigned long int i = 0; i < 2 * cache->nentries; ++i) {
+    const unsigned long int index = cache->hand;
+    struct ras_cache_entry_s *entry = &cache->entries[index];
+
+    cache->hand = (cache->hand + 1) % cache->nentries;
+
+    if (RAS_CACHE_T1 != entry->list || RAS_CACHE_CLEAN != entry->state) {
+      continue;
+    }
+
+    if (0 == entry->referenced) {
+      return index;
+    }
+
+    entry->referenced = 0;
+  }
+
+  return RAS_CACHE_NONE;
+}
+
+/**
+ * Makes room for a block in a full ARC cache by moving the least recently
+ * used block of `T1` or `T2` to its ghost list, depending on the target
+ * size of `T1`.
+ */
+static void
+ras_cache_arc_replace(struct ras_cache_storage_s *storage, int b2) {
+  struct ras_cache_s *cache = storage->cache;
+  const struct ras_cache_list_s *t1 = &cache->lists[RAS_CACHE_T1];
+  const struct ras_cache_list_s *t2 = &cache->lists[RAS_CACHE_T2];
+  unsigned int from = RAS_CACHE_T2;
+  unsigned long int victim = 0;
+
+  if (storage->cached < storage->capacity) {
+    return;
+  }
+
+  if (t1->size > 0 && (
+    t1->size > cache->target ||
+    (0 != b2 && t1->size == cache->target) ||
+    0 == t2->size
+  )) {
+    from = RAS_CACHE_T1;
+  }
+
+  victim = ras_cache_clean_tail(cache, from);
+
+  // dirty blocks are never evicted, so the other list gives up a block
+  if (RAS_CACHE_NONE == victim) {
+    from = RAS_CACHE_T1 == from ? RAS_CACHE_T2 : RAS_CACHE_T1;
+    victim = ras_cache_clean_tail(cache, from);
+  }
+
+  ras_cache_demote(
+    storage,
+    victim,
+    RAS_CACHE_T1 == from ? RAS_CACHE_B1 : RAS_CACHE_B2);
+}
+
+/**
+ * Adapts the ARC target size of `T1` to a miss of the block that was
+ * remembered at `ghost`, if it was, and makes room for the block.
+ */
+static void
+ras_cache_arc_admit(
+  struct ras_cache_storage_s *storage,
+  unsigned long int ghost
+) {
+  struct ras_cache_s *cache = storage->cache;
+  const unsigned long int capacity = storage->capacity;
+  const struct ras_cache_list_s *t1 = &cache->lists[RAS_CACHE_T1];
+  const struct ras_cache_list_s *t2 = &cache->lists[RAS_CACHE_T2];
+  const struct ras_cache_list_s *b1 = &cache->lists[RAS_CACHE_B1];
+  const struct ras_cache_list_s *b2 = &cache->lists[RAS_CACHE_B2];
+  unsigned long int delta = 1;
+
+  if (RAS_CACHE_NONE != ghost && RAS_CACHE_B1 == cache->entries[ghost].list) {
+    // evicted from `T1` too soon, so `T1` should be larger
+    if (b2->size > b1->size) {
+      delta = b2->size / b1->size;
+    }
+
+    cache->target = capacity - cache->target > delta
+      ? cache->target + delta
+      : capacity;
+
+    ras_cache_arc_replace(storage, 0);
+  } else if (RAS_CACHE_NONE != ghost) {
+    // evicted from `T2` too soon, so `T2` should be larger
+    if (b1->size > b2->size) {
+      delta = b1->size / b2->size;
+    }
+
+    cache->target = cache->target > delta ? cache->target - delta : 0;
+    ras_cache_arc_replace(storage, 1);
+  } else if (t1->size + b1->size >= capacity) {
+    if (t1->size < capacity && b1->size > 0) {
+      ras_cache_release(storage, b1->tail);
+      ras_cache_arc_replace(storage, 0);
+    } else {
+      ras_cache_evict(storage, ras_cache_clean_tail(cache, RAS_CACHE_T1));
+    }
+  } else if (t1->size + t2->size + b1->size + b2->size >= capacity) {
+    if (t1->size + t2->size + b1->size + b2->size >= 2 * capacity) {
+      ras_cache_release(storage, b2->tail);
+    }
+
+    ras_cache_arc_replace(storage, 0);
+  }
+}
+
+/**
+ * Marks the block at `index` as read again.
+ */
+static void
+ras_cache_access(struct ras_cache_storage_s *storage, unsigned long int index) {
+  struct ras_cache_s *cache = storage->cache;
+
+  switch (storage->policy) {
+    case RAS_CACHE_LRU:
+      ras_cache_unlink(cache, index);
+      ras_cache_push(cache, RAS_CACHE_T1, index);
+      break;
+
+    case RAS_CACHE_CLOCK:
+      cache->entries[index].referenced = 1;
+      break;
+
+    case RAS_CACHE_ARC:
+      ras_cache_unlink(cache, index);
+      ras_cache_push(cache, RAS_CACHE_T2, index);
+      break;
+  }
+}
+
+/**
+ * Returns the cached block at `key`, or `NULL` if it is not cached.
+ */
+static unsigned char *
+ras_cache_lookup(struct ras_cache_storage_s *storage, unsigned long int key) {
+  const unsigned long int index = ras_cache_find(storage->cache, key);
+
+  if (RAS_CACHE_NONE == index) {
+    return 0;
+  }
+
+  return storage->cache->entries[index].data;
+}
+
+/**
+ * Caches the block at `key`, evicting a block if the cache is full. Returns
+ * the buffer the block must be copied to, or `NULL` if the block was cached
+ * already or no buffer is left because every block is dirty.
+ */
+static unsigned char *
+ras_cache_insert(struct ras_cache_storage_s *storage, unsigned long int key) {
+  struct ras_cache_s *cache = storage->cache;
+  unsigned long int index = ras_cache_find(cache, key);
+  unsigned int list = RAS_CACHE_T1;
+
+  if (RAS_CACHE_NONE != index && 0 != cache->entries[index].data) {
+    ras_cache_access(storage, index);
+    return 0;
+  }
+
+  switch (storage->policy) {
+    case RAS_CACHE_LRU:
+      if (storage->cached == storage->capacity) {
+        ras_cache_evict(storage, ras_cache_clean_tail(cache, RAS_CACHE_T1));
+      }
+      break;
+
+    case RAS_CACHE_CLOCK:
+      if (storage->cached == storage->capacity) {
+        ras_cache_evict(storage, ras_cache_clock_victim(cache));
+      }
+      break;
+
+    case RAS_CACHE_ARC:
+      ras_cache_arc_admit(storage, index);
+
+      // blocks remembered by a ghost list were read before
+      if (RAS_CACHE_NONE != index) {
+        list = RAS_CACHE_T2;
+      }
+      break;
+  }
+
+  if (0 == cache->nspare) {
+    return 0;
+  }
+
+  if (RAS_CACHE_NONE == index) {
+    index = cache->lists[RAS_CACHE_FREE].head;
+
+    if (RAS_CACHE_NONE == index) {
+      return 0;
+    }
+
+    cache->entries[index].key = key;
+    ras_cache_table_insert(cache, index);
+  }
+
+  ras_cache_unlink(cache, index);
+  ras_cache_push(cache, list, index);
+  cache->entries[index].referenced = 0;
+  cache->entries[index].state = RAS_CACHE_CLEAN;
+  cache->entries[index].data = cache->spare[--cache->nspare];
+  storage->cached++;
+  return cache->entries[index].data;
+}
+
+/**
+ * Calls `visit` for every cached block `request` overlaps, looking up each
+ * block of the request or scanning the entries if there are fewer.
+ */
+static void
+ras_cache_each(
+  struct ras_cache_storage_s *storage,
+  struct ras_request_s *request,
+  ras_cache_visit_t *visit
+) {
+  struct ras_cache_s *cache = storage->cache;
+  const unsigned long int first = request->offset / storage->block_size;
+  unsigned long int end = request->offset + request->size;
+  unsigned long int last = 0;
+
+  if (0 == request->size) {
+    return;
+  }
+
+  if (end < request->offset) {
+    end = 0;
+  }
+
+  last = (end - 1) / storage->block_size;
+
+  if (last - first >= cache->nentries) {
+    for (unsigned long int i = 0; i < cache->nentries; ++i) {
+      const struct ras_cache_entry_s *entry = &cache->entries[i];
+
+      if (0 != entry->data && entry->key >= first && entry->key <= last) {
+        visit(storage, i, request);
+      }
+    }
+
+    return;
+  }
+
+  for (unsigned long int key = first; key <= last; ++key) {
+    const unsigned long int index = ras_cache_find(cache, key);
+
+    if (RAS_CACHE_NONE != index && 0 != cache->entries[index].data) {
+      visit(storage, index, request);
+    }
+  }
+}
+
+static void
+ras_cache_update(
+  struct ras_cache_storage_s *storage,
+  unsigned long int index,
+  struct ras_request_s *request
+) {
+  const struct ras_cache_entry_s *entry = &storage->cache->entries[index];
+  const unsigned long int start = entry->key * storage->block_size;
+  unsigned long int from = start;
+  unsigned long int to = start + storage->block_size;
+
+  if (request->offset > from) {
+    from = request->offset;
+  }
+
+  if (request->size < to - request->offset) {
+    to = request->offset + request->size;
+  }
+
+  memcpy(
+    entry->data + (from - start),
+    (const unsigned char *) request->data + (from - request->offset),
+    to - from);
+}
+
+static void
+ras_cache_clear(
+  struct ras_cache_storage_s *storage,
+  unsigned long int index,
+  struct ras_request_s *request
+) {
+  const struct ras_cache_entry_s *entry = &storage->cache->entries[index];
+  const unsigned long int start = entry->key * storage->block_size;
+  unsigned long int from = start;
+  unsigned long int to = start + storage->block_size;
+
+  if (request->offset > from) {
+    from = request->offset;
+  }
+
+  if (request->size < to - request->offset) {
+    to = request->offset + request->size;
+  }
+
+  memset(entry->data + (from - start), 0, to - from);
+}
+
+static void
+ras_cache_dirty(
+  struct ras_cache_storage_s *storage,
+  unsigned long int index,
+  struct ras_request_s *request
+) {
+  struct ras_cache_entry_s *entry = &storage->cache->entries[index];
+
+  if (RAS_CACHE_CLEAN == entry->state) {
+    if (0 == storage->dirty) {
+      storage->cache->dirtied = ras_clock_now();
+    }
+
+    storage->dirty += storage->block_size;
+  }
+
+  entry->state = RAS_CACHE_DIRTY;
+}
+
+static void
+ras_cache_drop(
+  struct ras_cache_storage_s *storage,
+  unsigned long int index,
+  struct ras_request_s *request
+) {
+  // dirty blocks hold writes the inner storage does not have yet
+  if (RAS_CACHE_CLEAN == storage->cache->entries[index].state) {
+    ras_cache_release(storage, index);
+  }
+}
+
+/**
+ * Copies the part of the block at `key` that `request` reads from `block`.
+ */
+static void
+ras_cache_copy(
+  const struct ras_cache_storage_s *storage,
+  unsigned long int key,
+  const unsigned char *block,
+  struct ras_request_s *request
+) {
+  const unsigned long int start = key * storage->block_size;
+  unsigned long int from = start;
+  unsigned long int to = start + storage->block_size;
+
+  if (request->offset > from) {
+    from = request->offset;
+  }
+
+  if (request->size < to - request->offset) {
+    to = request->offset + request->size;
+  }
+
+  memcpy(
+    (unsigned char *) request->data + (from - request->offset),
+    block + (from - start),
+    to - from);
+}
+
+/**
+ * Writes `request` to the cache only if every block it touches is cached
+ * or covered whole by it, caching the blocks it covers and marking them
+ * dirty. The cached blocks it overlaps must be updated already. Returns `1`
+ * if it did, otherwise `0` and the write must be written through.
+ */
+static int
+ras_cache_absorb(
+  struct ras_cache_storage_s *storage,
+  struct ras_request_s *request
+) {
+  const unsigned long int block_size = storage->block_size;
+  const unsigned long int first = request->offset / block_size;
+  const unsigned long int end = request->offset + request->size;
+  const unsigned char *data = request->data;
+  unsigned long int last = 0;
+
+  if (0 == request->size || end < request->offset) {
+    return 0;
+  }
+
+  last = (end - 1) / block_size;
+
+  for (unsigned long int key = first; key <= last; ++key) {
+    if (
+      0 == ras_cache_lookup(storage, key) &&
+      (key * block_size < request->offset || (key + 1) * block_size > end)
+    ) {
+      return 0;
+    }
+  }
+
+  // the cached blocks are marked dirty first so caching the others never
+  // evicts them
+  ras_cache_each(storage, request, ras_cache_dirty);
+
+  for (unsigned long int key = first; key <= last; ++key) {
+    if (0 == ras_cache_lookup(storage, key)) {
+      unsigned char *block = ras_cache_insert(storage, key);
+
+      if (0 == block) {
+        return 0;
+      }
+
+      memcpy(block, data + (key * block_size - request->offset), block_size);
+      ras_cache_dirty(storage, ras_cache_find(storage->cache, key), request);
+    }
+  }
+
+  if (end > storage->cache->length) {
+    storage->cache->length = end;
+  }
+
+  return 1;
+}
+
+static void
+ras_cache_free(struct ras_cache_s *cache) {
+  if (0 != cache) {
+    ras_free(cache->entries);
+    ras_free(cache->table);
+    ras_free(cache->spare);
+    ras_free(cache->memory);
+    ras_free(cache);
+  }
+}
+
+static struct ras_cache_s *
+ras_cache_new(
+  unsigned long int capacity,
+  unsigned long int block_size,
+  enum ras_cache_policy policy
+) {
+  struct ras_cache_s *cache = ras_alloc(sizeof(struct ras_cache_s));
+  unsigned long int size = 1;
+
+  if (0 == cache) {
+    return 0;
+  }
+
+  memset(cache, 0, sizeof(struct ras_cache_s));
+
+  // the ghost lists of ARC remember as many blocks as it caches
+  cache->nentries = RAS_CACHE_ARC == policy ? 2 * capacity : capacity;
+
+  while (size < 2 * cache->nentries) {
+    size <<= 1;
+    cache->bits++;
+  }
+
+  if (0 == cache->bits) {
+    size = 2;
+    cache->bits = 1;
+  }
+
+  cache->mask = size - 1;
+  cache->entries = ras_alloc(
+    cache->nentries * sizeof(struct ras_cache_entry_s));
+  cache->table = ras_alloc(size * sizeof(unsigned long int));
+  cache->spare = ras_alloc(capacity * sizeof(unsigned char *));
+  cache->memory = ras_alloc(capacity * block_size);
+
+  if (
+    0 == cache->entries ||
+    0 == cache->table ||
+    0 == cache->spare ||
+    0 == cache->memory
+  ) {
+    ras_cache_free(cache);
+    return 0;
+  }
+
+  memset(cache->table, 0xff, size * sizeof(unsigned long int));
+
+  for (int i = 0; i < RAS_CACHE_LISTS; ++i) {
+    cache->lists[i].head = RAS_CACHE_NONE;
+    cache->lists[i].tail = RAS_CACHE_NONE;
+  }
+
+  for (unsigned long int i = 0; i < cache->nentries; ++i) {
+    cache->entries[i].data = 0;
+    ras_cache_push(cache, RAS_CACHE_FREE, i);
+  }
+
+  for (unsigned long int i = 0; i < capacity; ++i) {
+    cache->spare[cache->nspare++] = cache->memory + i * block_size;
+  }
+
+  return cache;
+}
+
+/**
+ * Completes the request of the cache storage that `request` was made for
+ * on the inner storage.
+ */
+static int
+ras_cache_storage_forward(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  struct ras_request_s *outer = request->shared;
+  outer->callback(outer, err, value, size);
+  return 0;
+}
+
+static int
+ras_cache_storage_fill(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  struct ras_cache_fill_s *fill = request->shared;
+  struct ras_request_s *outer = fill->request;
+  struct ras_cache_storage_s *storage =
+    (struct ras_cache_storage_s *) outer->storage;
+
+  const unsigned long int block_size = storage->block_size;
+  const unsigned long int first = fill->offset / block_size;
+  const unsigned long int count = fill->size / block_size;
+  const unsigned long int end = outer->offset + outer->size;
+  unsigned long int length = end;
+  unsigned long int copied = 0;
+
+  if (0 != err) {
+    ras_free(fill);
+    outer->callback(outer, err, 0, 0);
+    return 0;
+  }
+
+  if (0 != value && value != fill->data) {
+    memmove(fill->data, value, size);
+  }
+
+  ras_storage_lock((struct ras_storage_s *) storage);
+
+  // blocks read while a write or delete was in flight may be stale, a short
+  // block at the end of the storage may still grow and blocks cached when
+  // the read was made may be newer than the inner storage
+  if (fill->generation == storage->generation) {
+    for (unsigned long int i = 0; (i + 1) * block_size <= size; ++i) {
+      unsigned char *block = 0;
+
+      if (0 != fill->resident[i]) {
+        continue;
+      }
+
+      block = ras_cache_insert(storage, first + i);
+
+      if (0 != block) {
+        memcpy(block, fill->data + i * block_size, block_size);
+      }
+    }
+  }
+
+  // the inner storage ends in the blocks read, past which the storage holds
+  // zeros up to the end of the writes kept in the cache
+  if (size < fill->size) {
+    memset(fill->data + size, 0, fill->size - size);
+    length = fill->offset + size;
+
+    if (storage->cache->length > length) {
+      length = storage->cache->length;
+    }
+  }
+
+  ras_storage_release((struct ras_storage_s *) storage);
+
+  for (unsigned long int i = 0; i < count; ++i) {
+    if (0 == fill->resident[i]) {
+      ras_cache_copy(storage, first + i, fill->data + i * block_size, outer);
+    }
+  }
+
+  if (length > outer->offset) {
+    copied = (length < end ? length : end) - outer->offset;
+  }
+
+  ras_free(fill);
+  outer->callback(outer, 0, outer->data, copied);
+  return 0;
+}
+
+static int
+ras_cache_storage_written(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  struct ras_request_s *outer = request->shared;
+  struct ras_cache_storage_s *storage =
+    (struct ras_cache_storage_s *) outer->storage;
+
+  ras_storage_lock((struct ras_storage_s *) storage);
+
+  // the blocks of a failed write may hold anything now, and a write-back
+  // cache zeroed the blocks of a delete already
+  if (
+    0 != err ||
+    (RAS_REQUEST_DELETE == outer->type && 0 == storage->write_back)
+  ) {
+    ras_cache_each(storage, outer, ras_cache_drop);
+  }
+
+  ras_storage_release((struct ras_storage_s *) storage);
+  outer->callback(outer, err, 0, size);
+  return 0;
+}
+
+static int
+ras_cache_storage_statted(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  struct ras_request_s *outer = request->shared;
+  struct ras_cache_storage_s *storage =
+    (struct ras_cache_storage_s *) outer->storage;
+
+  struct ras_storage_stats_s *stats = outer->data;
+
+  if (0 == err && 0 != value) {
+    memcpy(stats, value, sizeof(struct ras_storage_stats_s));
+
+    // writes kept in the cache may grow the storage
+    ras_storage_lock((struct ras_storage_s *) storage);
+
+    if (storage->cache->length > stats->size) {
+      stats->size = storage->cache->length;
+    }
+
+    ras_storage_release((struct ras_storage_s *) storage);
+  }
+
+  outer->callback(outer, err, outer->data, size);
+  return 0;
+}
+
+/**
+ * Continues the request a flush was made for once the flush is done.
+ * Flushes, syncs, closes and destroys are forwarded to the inner storage unless
+ * the flush failed, in which case the cache is kept.
+ */
+static void
+ras_cache_storage_flushed_all(
+  struct ras_cache_storage_s *storage,
+  struct ras_request_s *request,
+  int err
+) {
+  int rc = 0;
+
+  if (0 == request) {
+    return;
+  }
+
+  if (0 != err) {
+    request->callback(request, err, 0, 0);
+    return;
+  }
+
+  switch (request->type) {
+    case RAS_REQUEST_FLUSH:
+      rc = ras_storage_flush_shared(
+        storage->inner,
+        0,
+        ras_cache_storage_forward,
+        request);
+      break;
+
+    case RAS_REQUEST_SYNC:
+      rc = ras_storage_sync_shared(
+        storage->inner,
+        0,
+        ras_cache_storage_forward,
+        request);
+      break;
+
+    case RAS_REQUEST_CLOSE:
+      rc = ras_storage_close_shared(
+        storage->inner,
+        0,
+        ras_cache_storage_forward,
+        request);
+      break;
+
+    case RAS_REQUEST_DESTROY:
+      ras_cache_free(storage->cache);
+      storage->cache = 0;
+      storage->cached = 0;
+
+      rc = ras_storage_destroy_shared(
+        storage->inner,
+        0,
+        ras_cache_storage_forward,
+        request);
+      break;
+
+    default:
+      break;
+  }
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  }
+}
+
+/**
+ * Marks `flush` as having one less run in flight. Once it has none, it is
+ * done, but its request only continues once the flushes made before it are
+ * done too, so a flush request sees every dirty block written. The requests
+ * of flushes that finish together share the first error of any of them.
+ */
+static void
+ras_cache_storage_flush_done(struct ras_cache_flush_s *flush) {
+  struct ras_cache_storage_s *storage = flush->storage;
+  struct ras_cache_s *cache = storage->cache;
+  struct ras_cache_flush_s *finished = 0;
+  struct ras_cache_flush_s **tail = 0;
+  unsigned long int latency = 0;
+  int err = 0;
+
+  ras_storage_lock((struct ras_storage_s *) storage);
+
+  if (--flush->pending > 0) {
+    ras_storage_release((struct ras_storage_s *) storage);
+    return;
+  }
+
+  latency = ras_clock_now() - flush->started;
+
+  if (flush->bytes > 0) {
+    storage->flushes++;
+    storage->flushed_bytes += flush->bytes;
+    storage->flush_latency = latency;
+
+    if (latency > storage->flush_latency_max) {
+      storage->flush_latency_max = latency;
+    }
+  }
+
+  // blocks written to while they were flushed, or that failed, are dirty
+  if (storage->dirty > 0) {
+    cache->dirtied = ras_clock_now();
+  }
+
+  for (tail = &cache->finished; 0 != *tail; tail = &(*tail)->next) {
+  }
+
+  *tail = flush;
+
+  if (0 == --cache->flushing) {
+    finished = cache->finished;
+    cache->finished = 0;
+  }
+
+  ras_storage_release((struct ras_storage_s *) storage);
+
+  for (flush = finished; 0 != flush; flush = flush->next) {
+    if (0 == err) {
+      err = flush->err;
+    }
+  }
+
+  while (0 != finished) {
+    flush = finished;
+    finished = flush->next;
+    ras_cache_storage_flushed_all(storage, flush->request, err);
+    ras_free(flush);
+  }
+}
+
+/**
+ * Settles the blocks of `run` once it was written, or failed to be, which
+ * stay dirty unless they were written to meanwhile.
+ */
+static void
+ras_cache_storage_settle(
+  struct ras_cache_storage_s *storage,
+  struct ras_cache_run_s *run,
+  int err
+) {
+  struct ras_cache_s *cache = storage->cache;
+
+  for (unsigned long int i = 0; i < run->count; ++i) {
+    const unsigned long int index = ras_cache_find(cache, run->key + i);
+    struct ras_cache_entry_s *entry = &cache->entries[index];
+
+    if (RAS_CACHE_FLUSHING != entry->state) {
+      continue;
+    }
+
+    if (0 == err) {
+      entry->state = RAS_CACHE_CLEAN;
+      storage->dirty -= storage->block_size;
+    } else {
+      entry->state = RAS_CACHE_DIRTY;
+    }
+  }
+
+  if (0 == err) {
+    run->flush->bytes += run->count * storage->block_size;
+  } else if (0 == run->flush->err) {
+    run->flush->err = err;
+  }
+
+  ras_free(run);
+}
+
+static int
+ras_cache_storage_flushed(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  struct ras_cache_run_s *run = request->shared;
+  struct ras_cache_flush_s *flush = run->flush;
+  struct ras_storage_s *storage = (struct ras_storage_s *) flush->storage;
+
+  ras_storage_lock(storage);
+  ras_cache_storage_settle(flush->storage, run, err);
+  ras_storage_release(storage);
+  ras_cache_storage_flush_done(flush);
+  return 0;
+}
+
+/**
+ * Writes `count` consecutive dirty blocks from `key` to the inner storage
+ * for `flush`. Returns `0` on success, otherwise a negative error code.
+ */
+static int
+ras_cache_storage_flush_run(
+  struct ras_cache_storage_s *storage,
+  struct ras_cache_flush_s *flush,
+  unsigned long int key,
+  unsigned long int count
+) {
+  struct ras_cache_s *cache = storage->cache;
+  const unsigned long int block_size = storage->block_size;
+  struct ras_cache_run_s *run =
+    ras_alloc(sizeof(struct ras_cache_run_s) + count * block_size);
+
+  int rc = 0;
+
+  if (0 == run) {
+    flush->err = ENOMEM;
+    return -ENOMEM;
+  }
+
+  run->flush = flush;
+  run->key = key;
+  run->count = count;
+
+  // the blocks are copied so writes to the cache may go on meanwhile
+  for (unsigned long int i = 0; i < count; ++i) {
+    struct ras_cache_entry_s *entry =
+      &cache->entries[ras_cache_find(cache, key + i)];
+
+    memcpy(run->data + i * block_size, entry->data, block_size);
+    entry->state = RAS_CACHE_FLUSHING;
+  }
+
+  flush->pending++;
+  rc = ras_storage_write_shared(
+    storage->inner,
+    key * block_size,
+    count * block_size,
+    run->data,
+    0,
+    ras_cache_storage_flushed,
+    run);
+
+  if (rc < 0) {
+    flush->pending--;
+    ras_cache_storage_settle(storage, run, -rc);
+  }
+
+  return rc < 0 ? rc : 0;
+}
+
+static int
+ras_cache_key_compare(const void *a, const void *b) {
+  const unsigned long int x = *(const unsigned long int *) a;
+  const unsigned long int y = *(const unsigned long int *) b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Writes the dirty blocks to the inner storage in runs of consecutive
+ * blocks sorted by offset, at most `RAS_CACHE_MAX_FLUSH` bytes each, and
+ * continues `request`, if given, once they and the flushes in flight are
+ * written.
+ */
+static void
+ras_cache_storage_flush_dirty(
+  struct ras_cache_storage_s *storage,
+  struct ras_request_s *request
+) {
+  struct ras_cache_s *cache = storage->cache;
+  struct ras_cache_flush_s *flush = ras_alloc(sizeof(struct ras_cache_flush_s));
+  unsigned long int max = RAS_CACHE_MAX_FLUSH / storage->block_size;
+  unsigned long int *keys = 0;
+  unsigned long int nkeys = 0;
+  unsigned long int count = 0;
+
+  if (0 == flush) {
+    if (0 != request) {
+      request->callback(request, ENOMEM, 0, 0);
+    }
+
+    return;
+  }
+
+  memset(flush, 0, sizeof(struct ras_cache_flush_s));
+  flush->storage = storage;
+  flush->request = request;
+  flush->started = ras_clock_now();
+  flush->pending = 1;
+  cache->flushing++;
+
+  if (0 == max) {
+    max = 1;
+  }
+
+  if (storage->dirty > 0) {
+    keys = ras_alloc(storage->capacity * sizeof(unsigned long int));
+
+    if (0 == keys) {
+      flush->err = ENOMEM;
+    }
+  }
+
+  if (0 != keys) {
+    for (unsigned long int i = 0; i < cache->nentries; ++i) {
+      const struct ras_cache_entry_s *entry = &cache->entries[i];
+
+      if (0 != entry->data && RAS_CACHE_DIRTY == entry->state) {
+        keys[nkeys++] = entry->key;
+      }
+    }
+
+    qsort(keys, nkeys, sizeof(unsigned long int), ras_cache_key_compare);
+
+    for (unsigned long int i = 0; i < nkeys; i += count) {
+      count = 1;
+
+      while (
+        i + count < nkeys &&
+        count < max &&
+        keys[i + count] == keys[i] + count
+      ) {
+        count++;
+      }
+
+      if (ras_cache_storage_flush_run(storage, flush, keys[i], count) < 0) {
+        break;
+      }
+    }
+
+    ras_free(keys);
+  }
+
+  ras_cache_storage_flush_done(flush);
+}
+
+/**
+ * Flushes a write-back cache storage if `max_dirty` bytes are dirty, or
+ * if the oldest dirty block became dirty `flush_interval` microseconds ago
+ * or more. There is no timer thread, so the interval is checked by the
+ * requests that run.
+ */
+static void
+ras_cache_storage_expire(struct ras_cache_storage_s *storage) {
+  if (
+    0 == storage->write_back ||
+    0 == storage->dirty ||
+    0 != storage->cache->flushing
+  ) {
+    return;
+  }
+
+  if (
+    storage->dirty >= storage->max_dirty || (
+      0 != storage->flush_interval &&
+      ras_clock_now() - storage->cache->dirtied >=
+        storage->flush_interval * 1000UL
+    )
+  ) {
+    ras_cache_storage_flush_dirty(storage, 0);
+  }
+}
+
+static void
+ras_cache_storage_open(struct ras_request_s *request) {
+  struct ras_cache_storage_s *storage =
+    (struct ras_cache_storage_s *) request->storage;
+
+  const int rc = ras_storage_open_shared(
+    storage->inner,
+    0,
+    ras_cache_storage_forward,
+    request);
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  }
+}
+
+static void
+ras_cache_storage_read(struct ras_request_s *request) {
+  struct ras_cache_storage_s *storage =
+    (struct ras_cache_storage_s *) request->storage;
+
+  struct ras_cache_s *cache = storage->cache;
+  const unsigned long int block_size = storage->block_size;
+  const unsigned long int first = request->offset / block_size;
+  const unsigned long int end = request->offset + request->size;
+  struct ras_cache_fill_s *fill = 0;
+  unsigned long int start = RAS_CACHE_NONE;
+  unsigned long int stop = 0;
+  unsigned long int count = 0;
+  unsigned long int last = 0;
+  int rc = 0;
+
+  ras_cache_storage_expire(storage);
+
+  if (0 == request->size || end < request->offset) {
+    request->callback(request, 0, request->data, 0);
+    return;
+  }
+
+  last = (end - 1) / block_size;
+
+  // cached blocks are copied now, so only the blocks from the first one
+  // that is not cached to the last one are read from the inner storage
+  for (unsigned long int key = first; key <= last; ++key) {
+    const unsigned long int index = ras_cache_find(cache, key);
+
+    if (RAS_CACHE_NONE != index && 0 != cache->entries[index].data) {
+      ras_cache_copy(storage, key, cache->entries[index].data, request);
+      ras_cache_access(storage, index);
+    } else {
+      if (RAS_CACHE_NONE == start) {
+        start = key;
+      }
+
+      stop = key;
+    }
+  }
+
+  // every block is cached, so the read completes without the inner storage
+  if (RAS_CACHE_NONE == start) {
+    storage->hits++;
+    request->callback(request, 0, request->data, request->size);
+    return;
+  }
+
+  storage->misses++;
+  count = stop - start + 1;
+  fill = ras_alloc(
+    sizeof(struct ras_cache_fill_s) + count * block_size + count);
+
+  if (0 == fill) {
+    request->callback(request, ENOMEM, 0, 0);
+    return;
+  }
+
+  fill->request = request;
+  fill->generation = storage->generation;
+  fill->offset = start * block_size;
+  fill->size = count * block_size;
+  fill->resident = fill->data + fill->size;
+
+  for (unsigned long int i = 0; i < count; ++i) {
+    fill->resident[i] = 0 != ras_cache_lookup(storage, start + i);
+  }
+
+  rc = ras_storage_read_into_shared(
+    storage->inner,
+    fill->offset,
+    fill->size,
+    fill->data,
+    0,
+    ras_cache_storage_fill,
+    fill);
+
+  if (rc < 0) {
+    ras_free(fill);
+    request->callback(request, -rc, 0, 0);
+  }
+}
+
+static void
+ras_cache_storage_write(struct ras_request_s *request) {
+  struct ras_cache_storage_s *storage =
+    (struct ras_cache_storage_s *) request->storage;
+
+  int rc = 0;
+
+  ras_cache_storage_expire(storage);
+
+  // flushes copy the blocks they write when they are made, so the cached
+  // blocks are updated before the write reaches the inner storage
+  ras_cache_each(storage, request, ras_cache_update);
+
+  if (0 != storage->write_back && ras_cache_absorb(storage, request)) {
+    ras_cache_storage_expire(storage);
+    request->callback(request, 0, 0, request->size);
+    return;
+  }
+
+  storage->generation++;
+  rc = ras_storage_write_shared(
+    storage->inner,
+    request->offset,
+    request->size,
+    request->data,
+    0,
+    ras_cache_storage_written,
+    request);
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  }
+}
+
+static void
+ras_cache_storage_delete(struct ras_request_s *request) {
+  struct ras_cache_storage_s *storage =
+    (struct ras_cache_storage_s *) request->storage;
+
+  int rc = 0;
+
+  ras_cache_storage_expire(storage);
+
+  // dirty blocks cannot be dropped, so their deleted bytes are zeroed
+  if (0 != storage->write_back) {
+    ras_cache_each(storage, request, ras_cache_clear);
+  }
+
+  storage->generation++;
+  rc = ras_storage_delete_shared(
+    storage->inner,
+    request->offset,
+    request->size,
+    0,
+    ras_cache_storage_written,
+    request);
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  }
+}
+
+static void
+ras_cache_storage_stat(struct ras_request_s *request) {
+  struct ras_cache_storage_s *storage =
+    (struct ras_cache_storage_s *) request->storage;
+
+  const int rc = ras_storage_stat_shared(
+    storage->inner,
+    0,
+    ras_cache_storage_statted,
+    request);
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  }
+}
+
+static void
+ras_cache_storage_flush(struct ras_request_s *request) {
+  ras_cache_storage_flush_dirty(
+    (struct ras_cache_storage_s *) request->storage,
+    request);
+}
+
+static void
+ras_cache_storage_sync(struct ras_request_s *request) {
+  ras_cache_storage_flush_dirty(
+    (struct ras_cache_storage_s *) request->storage,
+    request);
+}
+
+static void
+ras_cache_storage_close(struct ras_request_s *request) {
+  ras_cache_storage_flush_dirty(
+    (struct ras_cache_storage_s *) request->storage,
+    request);
+}
+
+static void
+ras_cache_storage_destroy(struct ras_request_s *request) {
+  ras_cache_storage_flush_dirty(
+    (struct ras_cache_storage_s *) request->storage,
+    request);
+}
+
+struct ras_storage_s *
+ras_cache_storage_new(
+  struct ras_storage_s *inner,
+  unsigned long int capacity,
+  unsigned long int block_size,
+  enum ras_cache_policy policy
+) {
+  struct ras_cache_storage_s *storage = 0;
+
+  if (0 == inner) {
+    errno = EFAULT;
+    return 0;
+  }
+
+  if (0 == block_size) {
+    block_size = RAS_CACHE_BLOCK_SIZE;
+  }
+
+  if (
+    capacity < block_size ||
+    (RAS_CACHE_LRU != policy &&
+     RAS_CACHE_CLOCK != policy &&
+     RAS_CACHE_ARC != policy)
+  ) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  storage = ras_alloc(sizeof(struct ras_cache_storage_s));
+
+  if (0 == storage) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  memset(storage, 0, sizeof(struct ras_cache_storage_s));
+
+  if (ras_storage_init(
+    (struct ras_storage_s *) storage,
+    (struct ras_storage_options_s) {
+      .open = ras_cache_storage_open,
+      .read = ras_cache_storage_read,
+      .write = ras_cache_storage_write,
+      .del = ras_cache_storage_delete,
+      .stat = ras_cache_storage_stat,
+      .flush = ras_cache_storage_flush,
+      .sync = ras_cache_storage_sync,
+      .close = ras_cache_storage_close,
+      .destroy = ras_cache_storage_destroy,
+      .max_inflight = inner->options.max_inflight,
+      .thread_safe = inner->options.thread_safe,
+    }) < 0
+  ) {
+    ras_free(storage);
+    return 0;
+  }
+
+  storage->cache = ras_cache_new(capacity / block_size, block_size, policy);
+
+  if (0 == storage->cache) {
+    ras_storage_free((struct ras_storage_s *) storage);
+    ras_free(storage);
+    errno = ENOMEM;
+    return 0;
+  }
+
+  storage->alloc = 1;
+  storage->inner = inner;
+  storage->policy = policy;
+  storage->block_size = block_size;
+  storage->capacity = capacity / block_size;
+  ras_emitter_init(&storage->emitter);
+  return (struct ras_storage_s *) storage;
+}
+
+int
+ras_cache_storage_write_back(
+  struct ras_storage_s *storage,
+  struct ras_cache_write_back_options_s options
+) {
+  struct ras_cache_storage_s *cache = (struct ras_cache_storage_s *) storage;
+  unsigned long int bytes = 0;
+
+  require(storage, EFAULT);
+  require(ras_cache_storage_read == storage->options.read, EINVAL);
+
+  bytes = cache->capacity * cache->block_size;
+
+  if (0 == options.max_dirty) {
+    options.max_dirty = bytes / 2;
+  }
+
+  // dirty blocks are never evicted, so at most the whole cache is dirty
+  if (options.max_dirty > bytes) {
+    options.max_dirty = bytes;
+  }
+
+  ras_storage_lock(storage);
+  cache->write_back = 1;
+  cache->max_dirty = options.max_dirty;
+  cache->flush_interval = options.interval;
+  ras_storage_release(storage);
+  return 0;
+}
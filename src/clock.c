@@ -0,0 +1,21 @@
+#include "clock.h"
+#include <time.h>
+
+unsigned long int
+ras_clock_now() {
+  struct timespec ts = { 0 };
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+void
+ras_clock_sleep(unsigned long int nanoseconds) {
+  struct timespec ts = { 0 };
+
+  ts.tv_sec = nanoseconds / 1000000000UL;
+  ts.tv_nsec = nanoseconds % 1000000000UL;
+
+  // continues where a signal interrupted it
+  while (0 != nanosleep(&ts, &ts)) {
+  }
+}
@@ -0,0 +1,16 @@
+#ifndef _RAS_CLOCK_H
+#define _RAS_CLOCK_H
+
+/**
+ * Returns the time of a monotonic clock in nanoseconds.
+ */
+unsigned long int
+ras_clock_now();
+
+/**
+ * Suspends the calling thread for `nanoseconds`.
+ */
+void
+ras_clock_sleep(unsigned long int nanoseconds);
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef _RAS_DISPATCH_H
+#define _RAS_DISPATCH_H
+
+struct ras_request_s;
+struct ras_storage_s;
+
+/**
+ * Marks `request` as in flight on its storage before it is given to the
+ * storage interface.
+ */
+void
+ras_request_begin(struct ras_request_s *request);
+
+/**
+ * Returns `1` if `request` reads or writes the storage at its offset, such
+ * as a read, write or delete, otherwise `0`.
+ */
+int
+ras_request_positional(const struct ras_request_s *request);
+
+/**
+ * Cancels `request` for `reason`, `ECANCELED` or `ETIMEDOUT`, with the
+ * dispatch lock held. Returns `0` on success, otherwise `-EALREADY` if it
+ * was canceled already or `-EBUSY` if it is in flight and can not be.
+ */
+int
+ras_request_abort(struct ras_request_s *request, int reason);
+
+/**
+ * Removes the queued `request` from the queue of `storage` in constant
+ * time, leaving an empty slot behind that the queue skips.
+ */
+void
+ras_storage_queue_cancel(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request);
+
+/**
+ * Stops tracking `loan` as a loan on its storage.
+ */
+void
+ras_request_return(struct ras_request_s *loan);
+
+/**
+ * Starts the `sync()` of the open group of sync requests of `storage`
+ * unless the `sync()` of the group before it is in flight.
+ */
+void
+ras_request_sync_start(struct ras_storage_s *storage);
+
+/**
+ * Runs `request` on `storage` or queues it until it can run. Returns a
+ * negative error code if `request` could not be queued, in which case it
+ * was freed.
+ */
+int
+ras_storage_run(struct ras_storage_s *storage, struct ras_request_s *request);
+
+/**
+ * Returns `1` if the calling thread holds the dispatch lock of `storage`.
+ */
+int
+ras_storage_locked(struct ras_storage_s *storage);
+
+/**
+ * Acquires the (recursive) dispatch lock of a thread-safe storage. Does
+ * nothing if the storage is not thread-safe.
+ */
+void
+ras_storage_lock(struct ras_storage_s *storage);
+
+/**
+ * Releases the dispatch lock of a thread-safe storage. The last release
+ * dispatches requests submitted while the lock was held and frees a
+ * storage destroyed while the lock was held.
+ */
+void
+ras_storage_release(struct ras_storage_s *storage);
+
+/**
+ * Acquires the request pool lock of a thread-safe storage.
+ */
+void
+ras_storage_pool_lock(struct ras_storage_s *storage);
+
+/**
+ * Releases the request pool lock of a thread-safe storage.
+ */
+void
+ras_storage_pool_unlock(struct ras_storage_s *storage);
+
+#endif
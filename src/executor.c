@@ -0,0 +1,406 @@
+#include "ras/allocator.h"
+#include "ras/executor.h"
+#include "require.h"
+#include <pthread.h>
+#include <string.h>
+#include <sched.h>
+
+// the worker running on the calling thread, if any
+static __thread struct ras_executor_worker_s *current = 0;
+
+static void
+ras_executor_worker_lock(struct ras_executor_worker_s *worker) {
+  unsigned int spins = 0;
+
+  while (__atomic_exchange_n(&worker->lock, 1, __ATOMIC_ACQUIRE)) {
+    if (0 == (++spins & 0x3f)) {
+      sched_yield();
+    }
+  }
+}
+
+static void
+ras_executor_worker_unlock(struct ras_executor_worker_s *worker) {
+  __atomic_store_n(&worker->lock, 0, __ATOMIC_RELEASE);
+}
+
+static int
+ras_executor_worker_grow(struct ras_executor_worker_s *worker) {
+  unsigned int capacity = worker->capacity * 2;
+  struct ras_executor_task_s *tasks = ras_alloc(capacity * sizeof(*tasks));
+
+  require(tasks, ENOMEM);
+
+  // linearize so the head starts at index 0
+  for (unsigned int i = 0; i < worker->size; ++i) {
+    tasks[i] = worker->tasks[(worker->head + i) & (worker->capacity - 1)];
+  }
+
+  ras_free(worker->tasks);
+  worker->tasks = tasks;
+  worker->capacity = capacity;
+  worker->head = 0;
+  return 0;
+}
+
+/**
+ * Pushes a task on to the bottom of the deque of `worker`.
+ */
+static int
+ras_executor_worker_push(
+  struct ras_executor_worker_s *worker,
+  struct ras_executor_task_s task
+) {
+  int rc = 0;
+
+  ras_executor_worker_lock(worker);
+
+  if (worker->size == worker->capacity) {
+    rc = ras_executor_worker_grow(worker);
+  }
+
+  if (0 == rc) {
+    unsigned int bottom = worker->head + worker->size;
+    worker->tasks[bottom & (worker->capacity - 1)] = task;
+    __atomic_store_n(&worker->size, worker->size + 1, __ATOMIC_RELAXED);
+  }
+
+  ras_executor_worker_unlock(worker);
+  return rc;
+}
+
+/**
+ * Pops the most recently pushed task from the bottom of the deque of
+ * `worker`. Returns `1` if a task was popped.
+ */
+static int
+ras_executor_worker_pop(
+  struct ras_executor_worker_s *worker,
+  struct ras_executor_task_s *task
+) {
+  int popped = 0;
+
+  ras_executor_worker_lock(worker);
+
+  if (worker->size > 0) {
+    unsigned int bottom = worker->head + worker->size - 1;
+    *task = worker->tasks[bottom & (worker->capacity - 1)];
+    __atomic_store_n(&worker->size, worker->size - 1, __ATOMIC_RELAXED);
+    popped = 1;
+  }
+
+  ras_executor_worker_unlock(worker);
+  return popped;
+}
+
+/**
+ * Steals the oldest task from the top of the deque of `victim`. Returns
+ * `1` if a task was stolen.
+ */
+static int
+ras_executor_worker_steal(
+  struct ras_executor_worker_s *victim,
+  struct ras_executor_task_s *task
+) {
+  int stolen = 0;
+
+  // skip empty deques without taking their lock
+  if (0 == __atomic_load_n(&victim->size, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+
+  ras_executor_worker_lock(victim);
+
+  if (victim->size > 0) {
+    *task = victim->tasks[victim->head];
+    victim->head = (victim->head + 1) & (victim->capacity - 1);
+    __atomic_store_n(&victim->size, victim->size - 1, __ATOMIC_RELAXED);
+    stolen = 1;
+  }
+
+  ras_executor_worker_unlock(victim);
+  return stolen;
+}
+
+static int
+ras_executor_worker_next(
+  struct ras_executor_worker_s *worker,
+  struct ras_executor_task_s *task
+) {
+  struct ras_executor_s *executor = worker->executor;
+  unsigned int workers = executor->options.workers;
+
+  if (ras_executor_worker_pop(worker, task)) {
+    return 1;
+  }
+
+  for (unsigned int i = 1; i < workers; ++i) {
+    struct ras_executor_worker_s *victim =
+      &executor->workers[(worker->index + i) % workers];
+
+    if (ras_executor_worker_steal(victim, task)) {
+      __atomic_add_fetch(&worker->stolen, 1, __ATOMIC_RELAXED);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Stops and joins every started worker thread other than the calling one.
+ */
+static void
+ras_executor_stop(struct ras_executor_s *executor) {
+  pthread_mutex_lock(&executor->mutex);
+  __atomic_store_n(&executor->stopping, 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&executor->cond);
+  pthread_mutex_unlock(&executor->mutex);
+
+  for (unsigned int i = 0; i < executor->started; ++i) {
+    if (current != &executor->workers[i]) {
+      pthread_join(executor->workers[i].thread, 0);
+    }
+  }
+}
+
+/**
+ * Frees the worker deques and the executor once its workers stopped.
+ */
+static void
+ras_executor_release(struct ras_executor_s *executor) {
+  for (unsigned int i = 0; i < executor->options.workers; ++i) {
+    ras_free(executor->workers[i].tasks);
+  }
+
+  ras_free(executor->workers);
+  executor->workers = 0;
+  executor->started = 0;
+
+  pthread_cond_destroy(&executor->cond);
+  pthread_mutex_destroy(&executor->mutex);
+
+  if (1 == executor->alloc) {
+    ras_free(executor);
+  }
+}
+
+static void *
+ras_executor_worker_run(void *arg) {
+  struct ras_executor_worker_s *worker = arg;
+  struct ras_executor_s *executor = worker->executor;
+  struct ras_executor_task_s task = { 0 };
+
+  current = worker;
+
+  for (;;) {
+    unsigned int stop = 0;
+
+    if (ras_executor_worker_next(worker, &task)) {
+      __atomic_sub_fetch(&executor->queued, 1, __ATOMIC_SEQ_CST);
+      task.work(task.data);
+      __atomic_add_fetch(&worker->executed, 1, __ATOMIC_RELAXED);
+      continue;
+    }
+
+    // a task may be queued but not pushed yet
+    if (__atomic_load_n(&executor->queued, __ATOMIC_SEQ_CST) > 0) {
+      sched_yield();
+      continue;
+    }
+
+    pthread_mutex_lock(&executor->mutex);
+    __atomic_add_fetch(&executor->sleeping, 1, __ATOMIC_SEQ_CST);
+
+    while (
+      0 == __atomic_load_n(&executor->queued, __ATOMIC_SEQ_CST) &&
+      0 == executor->stopping
+    ) {
+      pthread_cond_wait(&executor->cond, &executor->mutex);
+    }
+
+    __atomic_sub_fetch(&executor->sleeping, 1, __ATOMIC_SEQ_CST);
+    stop = executor->stopping
+      && 0 == __atomic_load_n(&executor->queued, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&executor->mutex);
+
+    if (1 == stop) {
+      break;
+    }
+  }
+
+  current = 0;
+
+  // freed from a task on this worker
+  if (worker == executor->reaper) {
+    pthread_detach(pthread_self());
+    ras_executor_release(executor);
+  }
+
+  return 0;
+}
+
+struct ras_executor_s *
+ras_executor_alloc() {
+  return ras_alloc(sizeof(struct ras_executor_s));
+}
+
+int
+ras_executor_init(
+  struct ras_executor_s *executor,
+  struct ras_executor_options_s options
+) {
+  require(executor, EFAULT);
+  require(memset(executor, 0, sizeof(struct ras_executor_s)), EFAULT);
+  require(
+    memcpy(&executor->options, &options, sizeof(struct ras_executor_options_s)),
+    EFAULT);
+
+  if (0 == executor->options.workers) {
+    executor->options.workers = RAS_EXECUTOR_WORKERS;
+  }
+
+  if (0 == executor->options.capacity) {
+    executor->options.capacity = RAS_EXECUTOR_DEQUE_CAPACITY;
+  }
+
+  // deque indices are masked with `capacity - 1`
+  require(executor->options.capacity <= 0x80000000u, EINVAL);
+  unsigned int capacity = 1;
+  while (capacity < executor->options.capacity) {
+    capacity <<= 1;
+  }
+
+  executor->options.capacity = capacity;
+
+  pthread_mutex_init(&executor->mutex, 0);
+  pthread_cond_init(&executor->cond, 0);
+
+  executor->workers = ras_alloc(
+    executor->options.workers * sizeof(struct ras_executor_worker_s));
+
+  require(executor->workers, ENOMEM);
+  memset(
+    executor->workers,
+    0,
+    executor->options.workers * sizeof(struct ras_executor_worker_s));
+
+  for (unsigned int i = 0; i < executor->options.workers; ++i) {
+    struct ras_executor_worker_s *worker = &executor->workers[i];
+    worker->executor = executor;
+    worker->index = i;
+    worker->capacity = executor->options.capacity;
+    worker->tasks = ras_alloc(worker->capacity * sizeof(*worker->tasks));
+
+    if (0 == worker->tasks) {
+      ras_executor_stop(executor);
+      ras_executor_release(executor);
+      require(0, ENOMEM);
+    }
+  }
+
+  for (unsigned int i = 0; i < executor->options.workers; ++i) {
+    struct ras_executor_worker_s *worker = &executor->workers[i];
+    int rc = pthread_create(
+      &worker->thread,
+      0,
+      ras_executor_worker_run,
+      worker);
+
+    if (0 != rc) {
+      ras_executor_stop(executor);
+      ras_executor_release(executor);
+      require(0, EAGAIN);
+    }
+
+    executor->started++;
+  }
+
+  return 0;
+}
+
+struct ras_executor_s *
+ras_executor_new(struct ras_executor_options_s options) {
+  struct ras_executor_s *executor = ras_executor_alloc();
+
+  if (ras_executor_init(executor, options) < 0) {
+    ras_free(executor);
+    executor = 0;
+  } else {
+    executor->alloc = 1;
+  }
+
+  return executor;
+}
+
+void
+ras_executor_free(struct ras_executor_s *executor) {
+  if (0 != executor) {
+    ras_executor_stop(executor);
+
+    if (0 != current && executor == current->executor) {
+      executor->reaper = current;
+    } else {
+      ras_executor_release(executor);
+    }
+  }
+}
+
+int
+ras_executor_submit(
+  struct ras_executor_s *executor,
+  ras_executor_work_t *work,
+  void *data
+) {
+  struct ras_executor_worker_s *worker = current;
+  int rc = 0;
+
+  require(executor, EFAULT);
+  require(work, EFAULT);
+
+  if (0 == worker || executor != worker->executor) {
+    // running tasks may still submit work while the executor stops
+    require(
+      0 == __atomic_load_n(&executor->stopping, __ATOMIC_ACQUIRE),
+      ECANCELED);
+
+    worker = &executor->workers[
+      __atomic_fetch_add(&executor->next, 1, __ATOMIC_RELAXED)
+      % executor->options.workers];
+  }
+
+  // counted before it is pushed so a worker never sees a task it can not count
+  __atomic_add_fetch(&executor->queued, 1, __ATOMIC_SEQ_CST);
+
+  rc = ras_executor_worker_push(
+    worker,
+    (struct ras_executor_task_s) { .work = work, .data = data });
+
+  if (rc < 0) {
+    __atomic_sub_fetch(&executor->queued, 1, __ATOMIC_SEQ_CST);
+    return rc;
+  }
+
+  if (__atomic_load_n(&executor->sleeping, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&executor->mutex);
+    pthread_cond_signal(&executor->cond);
+    pthread_mutex_unlock(&executor->mutex);
+  }
+
+  return 0;
+}
+
+struct ras_executor_stats_s
+ras_executor_stats(struct ras_executor_s *executor) {
+  struct ras_executor_stats_s stats = { 0 };
+
+  if (0 != executor && 0 != executor->workers) {
+    for (unsigned int i = 0; i < executor->options.workers; ++i) {
+      struct ras_executor_worker_s *worker = &executor->workers[i];
+      stats.executed += __atomic_load_n(&worker->executed, __ATOMIC_RELAXED);
+      stats.stolen += __atomic_load_n(&worker->stolen, __ATOMIC_RELAXED);
+    }
+  }
+
+  return stats;
+}
@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "ras/allocator.h"
+#include "ras/emitter.h"
+#include "ras/file.h"
+#include "ras/storage.h"
+#include "io.h"
+#include <sys/stat.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// the largest offset a file may be read or written at
+#define RAS_IO_MAX_OFFSET ((unsigned long int) INT64_MAX)
+
+// the size of the zero buffer written where holes can't be punched
+#define RAS_IO_ZERO_SIZE 4096
+
+static int
+ras_io_overflows(unsigned long int offset, unsigned long int size) {
+  return offset > RAS_IO_MAX_OFFSET || size > RAS_IO_MAX_OFFSET - offset;
+}
+
+long int
+ras_io_read(
+  int fd,
+  void *buffer,
+  unsigned long int size,
+  unsigned long int offset
+) {
+  unsigned long int done = 0;
+
+  if (ras_io_overflows(offset, size)) {
+    return -EOVERFLOW;
+  }
+
+  while (done < size) {
+    const ssize_t n = pread(
+      fd,
+      (char *) buffer + done,
+      size - done,
+      (off_t) (offset + done));
+
+    if (n < 0 && EINTR == errno) {
+      continue;
+    } else if (n < 0) {
+      return -errno;
+    } else if (0 == n) {
+      break;
+    }
+
+    done += n;
+  }
+
+  return done;
+}
+
+long int
+ras_io_write(
+  int fd,
+  const void *buffer,
+  unsigned long int size,
+  unsigned long int offset
+) {
+  unsigned long int done = 0;
+
+  if (ras_io_overflows(offset, size)) {
+    return -EOVERFLOW;
+  }
+
+  while (done < size) {
+    const ssize_t n = pwrite(
+      fd,
+      (const char *) buffer + done,
+      size - done,
+      (off_t) (offset + done));
+
+    if (n < 0 && EINTR == errno) {
+      continue;
+    } else if (n < 0) {
+      return -errno;
+    } else if (0 == n) {
+      return -EIO;
+    }
+
+    done += n;
+  }
+
+  return done;
+}
+
+int
+ras_io_punch(int fd, unsigned long int offset, unsigned long int size) {
+  static const char zeros[RAS_IO_ZERO_SIZE] = { 0 };
+  unsigned long int end = 0;
+  long int length = 0;
+
+  if (ras_io_overflows(offset, size)) {
+    return -EOVERFLOW;
+  }
+
+  if (0 == fallocate(
+    fd,
+    FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+    (off_t) offset,
+    (off_t) size)
+  ) {
+    return 0;
+  }
+
+  if (EOPNOTSUPP != errno && ENOSYS != errno) {
+    return -errno;
+  }
+
+  // zero the range up to the end of the file instead
+  length = ras_io_size(fd);
+
+  if (length < 0) {
+    return length;
+  }
+
+  end = length;
+
+  if (offset + size < end) {
+    end = offset + size;
+  }
+
+  while (offset < end) {
+    unsigned long int chunk = end - offset;
+    long int n = 0;
+
+    if (chunk > RAS_IO_ZERO_SIZE) {
+      chunk = RAS_IO_ZERO_SIZE;
+    }
+
+    n = ras_io_write(fd, zeros, chunk, offset);
+
+    if (n < 0) {
+      return n;
+    }
+
+    offset += n;
+  }
+
+  return 0;
+}
+
+int
+ras_io_sync(int fd) {
+  while (fdatasync(fd) < 0) {
+    if (EINTR != errno) {
+      return -errno;
+    }
+  }
+
+  return 0;
+}
+
+long int
+ras_io_size(int fd) {
+  struct stat st;
+
+  if (fstat(fd, &st) < 0) {
+    return -errno;
+  }
+
+  return st.st_size;
+}
+
+static void
+ras_file_storage_open(struct ras_request_s *request) {
+  struct ras_file_storage_s *storage =
+    (struct ras_file_storage_s *) request->storage;
+
+  int fd = -1;
+
+  do {
+    fd = open(storage->path, storage->flags | O_CLOEXEC, RAS_FILE_MODE);
+  } while (fd < 0 && EINTR == errno);
+
+  if (fd < 0) {
+    request->callback(request, errno, 0, 0);
+    return;
+  }
+
+  storage->fd = fd;
+  request->callback(request, 0, 0, 0);
+}
+
+static void
+ras_file_storage_read(struct ras_request_s *request) {
+  struct ras_file_storage_s *storage =
+    (struct ras_file_storage_s *) request->storage;
+
+  const long int n = ras_io_read(
+    storage->fd,
+    request->data,
+    request->size,
+    request->offset);
+
+  if (n < 0) {
+    request->callback(request, -n, 0, 0);
+  } else {
+    request->callback(request, 0, request->data, n);
+  }
+}
+
+static void
+ras_file_storage_write(struct ras_request_s *request) {
+  struct ras_file_storage_s *storage =
+    (struct ras_file_storage_s *) request->storage;
+
+  const long int n = ras_io_write(
+    storage->fd,
+    request->data,
+    request->size,
+    request->offset);
+
+  if (n < 0) {
+    request->callback(request, -n, 0, 0);
+  } else {
+    request->callback(request, 0, 0, n);
+  }
+}
+
+static void
+ras_file_storage_delete(struct ras_request_s *request) {
+  struct ras_file_storage_s *storage =
+    (struct ras_file_storage_s *) request->storage;
+
+  const int rc = ras_io_punch(storage->fd, request->offset, request->size);
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  } else {
+    request->callback(request, 0, 0, request->size);
+  }
+}
+
+static void
+ras_file_storage_stat(struct ras_request_s *request) {
+  struct ras_file_storage_s *storage =
+    (struct ras_file_storage_s *) request->storage;
+
+  struct ras_storage_stats_s *stats = request->data;
+  const long int size = ras_io_size(storage->fd);
+
+  if (size < 0) {
+    request->callback(request, -size, 0, 0);
+    return;
+  }
+
+  stats->size = size;
+  request->callback(request, 0, stats, sizeof(struct ras_storage_stats_s));
+}
+
+static void
+ras_file_storage_sync(struct ras_request_s *request) {
+  struct ras_file_storage_s *storage =
+    (struct ras_file_storage_s *) request->storage;
+
+  const int rc = ras_io_sync(storage->fd);
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  } else {
+    request->callback(request, 0, 0, 0);
+  }
+}
+
+static void
+ras_file_storage_close(struct ras_request_s *request) {
+  struct ras_file_storage_s *storage =
+    (struct ras_file_storage_s *) request->storage;
+
+  // the descriptor is released even if close fails
+  const int rc = close(storage->fd);
+
+  storage->fd = -1;
+  request->callback(request, rc < 0 ? errno : 0, 0, 0);
+}
+
+static void
+ras_file_storage_destroy(struct ras_request_s *request) {
+  struct ras_file_storage_s *storage =
+    (struct ras_file_storage_s *) request->storage;
+
+  if (storage->fd >= 0) {
+    close(storage->fd);
+    storage->fd = -1;
+  }
+
+  ras_free(storage->path);
+  storage->path = 0;
+  request->callback(request, 0, 0, 0);
+}
+
+struct ras_storage_s *
+ras_file_storage_new(const char *path, int flags) {
+  struct ras_file_storage_s *storage = 0;
+  unsigned long int length = 0;
+
+  if (0 == path) {
+    errno = EFAULT;
+    return 0;
+  }
+
+  storage = ras_alloc(sizeof(struct ras_file_storage_s));
+
+  if (0 == storage) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  length = strlen(path) + 1;
+  memset(storage, 0, sizeof(struct ras_file_storage_s));
+
+  if (ras_storage_init(
+    (struct ras_storage_s *) storage,
+    (struct ras_storage_options_s) {
+      .open = ras_file_storage_open,
+      .read = ras_file_storage_read,
+      .write = ras_file_storage_write,
+      .del = ras_file_storage_delete,
+      .stat = ras_file_storage_stat,
+      .sync = ras_file_storage_sync,
+      .close = ras_file_storage_close,
+      .destroy = ras_file_storage_destroy,
+      .group_sync = 1,
+    }) < 0
+  ) {
+    ras_free(storage);
+    return 0;
+  }
+
+  storage->path = ras_alloc(length);
+
+  if (0 == storage->path) {
+    ras_storage_free((struct ras_storage_s *) storage);
+    ras_free(storage);
+    errno = ENOMEM;
+    return 0;
+  }
+
+  memcpy(storage->path, path, length);
+  storage->alloc = 1;
+  storage->flags = flags;
+  storage->fd = -1;
+  ras_emitter_init(&storage->emitter);
+  return (struct ras_storage_s *) storage;
+}
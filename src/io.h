@@ -0,0 +1,52 @@
+#ifndef _RAS_IO_H
+#define _RAS_IO_H
+
+/**
+ * Reads up to `size` bytes at `offset` of `fd` into `buffer`, continuing
+ * short reads until `size` bytes are read or the end of the file. Returns
+ * the number of bytes read, otherwise an error code found in `errno.h`
+ * with its sign flipped.
+ */
+long int
+ras_io_read(
+  int fd,
+  void *buffer,
+  unsigned long int size,
+  unsigned long int offset);
+
+/**
+ * Writes `size` bytes of `buffer` at `offset` of `fd`, continuing short
+ * writes. Returns the number of bytes written, otherwise an error code
+ * found in `errno.h` with its sign flipped.
+ */
+long int
+ras_io_write(
+  int fd,
+  const void *buffer,
+  unsigned long int size,
+  unsigned long int offset);
+
+/**
+ * Zeros `[offset, offset + size)` of `fd` without changing its size.
+ * Returns `0` on success, otherwise an error code found in `errno.h` with
+ * its sign flipped.
+ */
+int
+ras_io_punch(int fd, unsigned long int offset, unsigned long int size);
+
+/**
+ * Writes the data of `fd` to durable storage with `fdatasync(2)`. Returns
+ * `0` on success, otherwise an error code found in `errno.h` with its sign
+ * flipped.
+ */
+int
+ras_io_sync(int fd);
+
+/**
+ * Returns the size of the file `fd`, otherwise an error code found in
+ * `errno.h` with its sign flipped.
+ */
+long int
+ras_io_size(int fd);
+
+#endif
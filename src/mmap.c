@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "ras/allocator.h"
+#include "ras/emitter.h"
+#include "ras/file.h"
+#include "ras/mmap.h"
+#include "ras/storage.h"
+#include "require.h"
+#include "io.h"
+#include <sys/mman.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+static int
+ras_mmap_storage_prot(struct ras_mmap_storage_s *storage) {
+  if (O_RDONLY == (storage->flags & O_ACCMODE)) {
+    return PROT_READ;
+  }
+
+  return PROT_READ | PROT_WRITE;
+}
+
+/**
+ * Maps (or remaps) at least `length` bytes of the file. Returns `0` on
+ * success, otherwise an error code found in `errno.h` with its sign
+ * flipped.
+ */
+static int
+ras_mmap_storage_map(
+  struct ras_mmap_storage_s *storage,
+  unsigned long int length
+) {
+  const unsigned long int page_size = getpagesize();
+  unsigned long int mapped = (length + page_size - 1) & ~(page_size - 1);
+  void *map = 0;
+
+  if (mapped <= storage->mapped) {
+    return 0;
+  }
+
+  // grow geometrically so extending writes remap rarely
+  if (mapped < storage->mapped * 2) {
+    mapped = storage->mapped * 2;
+  }
+
+  // borrowed reads point into the mapping so it may not move
+  if (0 == storage->map) {
+    map = mmap(
+      0,
+      mapped,
+      ras_mmap_storage_prot(storage),
+      MAP_SHARED,
+      storage->fd,
+      0);
+  } else {
+    map = mremap(
+      storage->map,
+      storage->mapped,
+      mapped,
+      0 == storage->loans ? MREMAP_MAYMOVE : 0);
+  }
+
+  if (MAP_FAILED == map) {
+    return -errno;
+  }
+
+  storage->map = map;
+  storage->mapped = mapped;
+  return 0;
+}
+
+static void
+ras_mmap_storage_unmap(struct ras_mmap_storage_s *storage) {
+  if (0 != storage->map) {
+    munmap(storage->map, storage->mapped);
+  }
+
+  if (storage->fd >= 0) {
+    close(storage->fd);
+  }
+
+  storage->map = 0;
+  storage->mapped = 0;
+  storage->length = 0;
+  storage->fd = -1;
+}
+
+static void
+ras_mmap_storage_open(struct ras_request_s *request) {
+  struct ras_mmap_storage_s *storage =
+    (struct ras_mmap_storage_s *) request->storage;
+
+  long int length = 0;
+  int rc = 0;
+
+  const int flags = storage->flags | O_CLOEXEC;
+
+  do {
+    storage->fd = open(storage->path, flags, RAS_FILE_MODE);
+  } while (storage->fd < 0 && EINTR == errno);
+
+  if (storage->fd < 0) {
+    request->callback(request, errno, 0, 0);
+    return;
+  }
+
+  length = ras_io_size(storage->fd);
+
+  if (length < 0) {
+    rc = length;
+  } else if (length > 0) {
+    rc = ras_mmap_storage_map(storage, length);
+  }
+
+  if (rc < 0) {
+    ras_mmap_storage_unmap(storage);
+    request->callback(request, -rc, 0, 0);
+    return;
+  }
+
+  storage->length = length;
+  request->callback(request, 0, 0, 0);
+}
+
+static void
+ras_mmap_storage_read(struct ras_request_s *request) {
+  struct ras_mmap_storage_s *storage =
+    (struct ras_mmap_storage_s *) request->storage;
+
+  unsigned long int size = 0;
+
+  // reads stop at the end of the file
+  if (request->offset < storage->length) {
+    size = storage->length - request->offset;
+    if (request->size < size) {
+      size = request->size;
+    }
+
+    memcpy(request->data, storage->map + request->offset, size);
+  }
+
+  request->callback(request, 0, request->data, size);
+}
+
+static void
+ras_mmap_storage_borrow(struct ras_request_s *request) {
+  struct ras_mmap_storage_s *storage =
+    (struct ras_mmap_storage_s *) request->storage;
+
+  unsigned char *buffer = 0;
+  unsigned long int size = 0;
+
+  // lends the mapped range up to the end of the file
+  if (request->offset < storage->length) {
+    size = storage->length - request->offset;
+    if (request->size < size) {
+      size = request->size;
+    }
+
+    buffer = storage->map + request->offset;
+  }
+
+  request->callback(request, 0, buffer, size);
+}
+
+static void
+ras_mmap_storage_write(struct ras_request_s *request) {
+  struct ras_mmap_storage_s *storage =
+    (struct ras_mmap_storage_s *) request->storage;
+
+  const unsigned long int end = request->offset + request->size;
+  int rc = 0;
+
+  // a read only mapping faults on the first byte written to it
+  if (PROT_READ == ras_mmap_storage_prot(storage)) {
+    request->callback(request, EBADF, 0, 0);
+    return;
+  }
+
+  if (end < request->offset) {
+    request->callback(request, EOVERFLOW, 0, 0);
+    return;
+  }
+
+  if (end > storage->length) {
+    if (ftruncate(storage->fd, end) < 0) {
+      request->callback(request, errno, 0, 0);
+      return;
+    }
+
+    rc = ras_mmap_storage_map(storage, end);
+
+    if (rc < 0) {
+      request->callback(request, -rc, 0, 0);
+      return;
+    }
+
+    storage->length = end;
+  }
+
+  memcpy(storage->map + request->offset, request->data, request->size);
+  request->callback(request, 0, 0, request->size);
+}
+
+static void
+ras_mmap_storage_delete(struct ras_request_s *request) {
+  struct ras_mmap_storage_s *storage =
+    (struct ras_mmap_storage_s *) request->storage;
+
+  unsigned long int size = 0;
+
+  if (PROT_READ == ras_mmap_storage_prot(storage)) {
+    request->callback(request, EBADF, 0, 0);
+    return;
+  }
+
+  if (request->offset < storage->length) {
+    size = storage->length - request->offset;
+    if (request->size < size) {
+      size = request->size;
+    }
+
+    memset(storage->map + request->offset, 0, size);
+  }
+
+  request->callback(request, 0, 0, request->size);
+}
+
+static void
+ras_mmap_storage_stat(struct ras_request_s *request) {
+  struct ras_mmap_storage_s *storage =
+    (struct ras_mmap_storage_s *) request->storage;
+
+  struct ras_storage_stats_s *stats = request->data;
+
+  stats->size = storage->length;
+  request->callback(request, 0, stats, sizeof(struct ras_storage_stats_s));
+}
+
+static void
+ras_mmap_storage_sync(struct ras_request_s *request) {
+  struct ras_mmap_storage_s *storage =
+    (struct ras_mmap_storage_s *) request->storage;
+
+  // the size of a file grown by writes is only durable once it is synced
+  int rc = ras_mmap_storage_flush(request->storage);
+
+  if (0 == rc) {
+    rc = ras_io_sync(storage->fd);
+  }
+
+  request->callback(request, rc < 0 ? -rc : 0, 0, 0);
+}
+
+static void
+ras_mmap_storage_flush_request(struct ras_request_s *request) {
+  const int rc = ras_mmap_storage_flush(request->storage);
+  request->callback(request, rc < 0 ? -rc : 0, 0, 0);
+}
+
+static void
+ras_mmap_storage_close(struct ras_request_s *request) {
+  struct ras_mmap_storage_s *storage =
+    (struct ras_mmap_storage_s *) request->storage;
+
+  // the kernel writes back dirty pages after the mapping is gone
+  ras_mmap_storage_unmap(storage);
+  request->callback(request, 0, 0, 0);
+}
+
+static void
+ras_mmap_storage_destroy(struct ras_request_s *request) {
+  struct ras_mmap_storage_s *storage =
+    (struct ras_mmap_storage_s *) request->storage;
+
+  ras_mmap_storage_unmap(storage);
+  ras_free(storage->path);
+  storage->path = 0;
+  request->callback(request, 0, 0, 0);
+}
+
+struct ras_storage_s *
+ras_mmap_storage_new(const char *path, int flags) {
+  struct ras_mmap_storage_s *storage = 0;
+  unsigned long int length = 0;
+
+  if (0 == path) {
+    errno = EFAULT;
+    return 0;
+  }
+
+  storage = ras_alloc(sizeof(struct ras_mmap_storage_s));
+
+  if (0 == storage) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  length = strlen(path) + 1;
+  memset(storage, 0, sizeof(struct ras_mmap_storage_s));
+
+  if (ras_storage_init(
+    (struct ras_storage_s *) storage,
+    (struct ras_storage_options_s) {
+      .open = ras_mmap_storage_open,
+      .read = ras_mmap_storage_read,
+      .borrow = ras_mmap_storage_borrow,
+      .write = ras_mmap_storage_write,
+      .del = ras_mmap_storage_delete,
+      .stat = ras_mmap_storage_stat,
+      .flush = ras_mmap_storage_flush_request,
+      .sync = ras_mmap_storage_sync,
+      .close = ras_mmap_storage_close,
+      .destroy = ras_mmap_storage_destroy,
+      .group_sync = 1,
+    }) < 0
+  ) {
+    ras_free(storage);
+    return 0;
+  }
+
+  storage->path = ras_alloc(length);
+
+  if (0 == storage->path) {
+    ras_storage_free((struct ras_storage_s *) storage);
+    ras_free(storage);
+    errno = ENOMEM;
+    return 0;
+  }
+
+  memcpy(storage->path, path, length);
+  storage->alloc = 1;
+  storage->flags = flags;
+  storage->fd = -1;
+  ras_emitter_init(&storage->emitter);
+  return (struct ras_storage_s *) storage;
+}
+
+int
+ras_mmap_storage_flush(struct ras_storage_s *storage) {
+  struct ras_mmap_storage_s *file = (struct ras_mmap_storage_s *) storage;
+
+  require(storage, EFAULT);
+
+  if (0 == file->map || 0 == file->length) {
+    return 0;
+  }
+
+  require(0 == msync(file->map, file->length, MS_SYNC), errno);
+  return 0;
+}
@@ -0,0 +1,630 @@
+#include "ras/allocator.h"
+#include "ras/emitter.h"
+#include "ras/ram.h"
+#include "ras/storage.h"
+#include <string.h>
+#include <errno.h>
+
+#define RAS_RAM_FANOUT (1UL << RAS_RAM_RADIX_BITS)
+#define RAS_RAM_MASK (RAS_RAM_FANOUT - 1)
+
+/**
+ * A slot of a page table node, pointing to a page at the bottom level and
+ * to a node at the others.
+ */
+union ras_ram_slot_u {
+  struct ras_ram_node_s *node;
+  struct ras_ram_page_s *page;
+};
+
+/**
+ * A node of the page table. `count` is the number of slots in use so empty
+ * nodes can be freed and `refs` the number of storages and nodes pointing
+ * to it, which is more than one when it is shared with a snapshot.
+ */
+struct ras_ram_node_s {
+  union ras_ram_slot_u slots[RAS_RAM_FANOUT];
+  unsigned int count;
+  unsigned long int refs;
+};
+
+/**
+ * A page of a RAM storage. `refs` is the number of nodes pointing to it.
+ */
+struct ras_ram_page_s {
+  unsigned long int refs;
+  unsigned char data[];
+};
+
+// never written, so it is backed by the kernel's zero page too
+static unsigned char ras_ram_zero_page[RAS_RAM_MAX_PAGE_SIZE];
+
+/**
+ * Returns `1` if the page at `index` is beyond what `height` levels can
+ * address, otherwise `0`.
+ */
+static int
+ras_ram_storage_beyond(unsigned int height, unsigned long int index) {
+  const unsigned int bits = height * RAS_RAM_RADIX_BITS;
+  return bits < 64 && 0 != (index >> bits);
+}
+
+static unsigned char *
+ras_ram_storage_lookup(
+  struct ras_ram_storage_s *storage,
+  unsigned long int index
+) {
+  struct ras_ram_node_s *node = storage->root;
+  struct ras_ram_page_s *page = 0;
+  unsigned int level = storage->height;
+
+  if (0 == node || ras_ram_storage_beyond(level, index)) {
+    return 0;
+  }
+
+  while (--level > 0) {
+    node = node->slots[
+      (index >> (level * RAS_RAM_RADIX_BITS)) & RAS_RAM_MASK
+    ].node;
+
+    if (0 == node) {
+      return 0;
+    }
+  }
+
+  page = node->slots[index & RAS_RAM_MASK].page;
+  return 0 != page ? page->data : 0;
+}
+
+static struct ras_ram_node_s *
+ras_ram_node_new(void) {
+  struct ras_ram_node_s *node = ras_alloc(sizeof(struct ras_ram_node_s));
+
+  if (0 != node) {
+    memset(node, 0, sizeof(struct ras_ram_node_s));
+    node->refs = 1;
+  }
+
+  return node;
+}
+
+static void
+ras_ram_page_release(struct ras_ram_page_s *page) {
+  if (0 == __atomic_sub_fetch(&page->refs, 1, __ATOMIC_ACQ_REL)) {
+    ras_free(page);
+  }
+}
+
+/**
+ * Drops a reference to `node` at `level`, freeing it and releasing its
+ * children if it was the last one.
+ */
+static void
+ras_ram_node_release(struct ras_ram_node_s *node, unsigned int level) {
+  if (0 != __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL)) {
+    return;
+  }
+
+  for (unsigned long int i = 0; i < RAS_RAM_FANOUT && node->count > 0; ++i) {
+    if (0 == node->slots[i].node) {
+      continue;
+    }
+
+    if (0 == level) {
+      ras_ram_page_release(node->slots[i].page);
+    } else {
+      ras_ram_node_release(node->slots[i].node, level - 1);
+    }
+
+    node->count--;
+  }
+
+  ras_free(node);
+}
+
+/**
+ * Returns the node in `slot` at `level`, first replacing it with a copy if
+ * it is shared. The copy shares the children of the node, so only the
+ * path to a written page is ever copied. Returns `NULL` if memory could
+ * not be allocated.
+ */
+static struct ras_ram_node_s *
+ras_ram_node_own(struct ras_ram_node_s **slot, unsigned int level) {
+  struct ras_ram_node_s *node = *slot;
+  struct ras_ram_node_s *copy = 0;
+
+  if (1 == __atomic_load_n(&node->refs, __ATOMIC_ACQUIRE)) {
+    return node;
+  }
+
+  copy = ras_alloc(sizeof(struct ras_ram_node_s));
+
+  if (0 == copy) {
+    return 0;
+  }
+
+  memcpy(copy, node, sizeof(struct ras_ram_node_s));
+  copy->refs = 1;
+
+  for (unsigned long int i = 0; i < RAS_RAM_FANOUT; ++i) {
+    if (0 == copy->slots[i].node) {
+      continue;
+    }
+
+    if (0 == level) {
+      __atomic_add_fetch(&copy->slots[i].page->refs, 1, __ATOMIC_RELAXED);
+    } else {
+      __atomic_add_fetch(&copy->slots[i].node->refs, 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  ras_ram_node_release(node, level);
+  *slot = copy;
+  return copy;
+}
+
+/**
+ * Returns the page in `slot` of `storage`, first replacing it with a copy
+ * if it is shared. Returns `NULL` if memory could not be allocated.
+ */
+static struct ras_ram_page_s *
+ras_ram_page_own(
+  struct ras_ram_storage_s *storage,
+  struct ras_ram_page_s **slot
+) {
+  struct ras_ram_page_s *page = *slot;
+  struct ras_ram_page_s *copy = 0;
+
+  if (1 == __atomic_load_n(&page->refs, __ATOMIC_ACQUIRE)) {
+    return page;
+  }
+
+  copy = ras_alloc(sizeof(struct ras_ram_page_s) + storage->page_size);
+
+  if (0 == copy) {
+    return 0;
+  }
+
+  memcpy(copy->data, page->data, storage->page_size);
+  copy->refs = 1;
+  ras_ram_page_release(page);
+  *slot = copy;
+  return copy;
+}
+
+/**
+ * Returns the page at `index` for writing, allocating it zeroed along with
+ * the nodes on the path to it if it doesn't exist and copying the page and
+ * the nodes on the path to it that are shared with a snapshot. The table
+ * grows a level at a time until its root covers `index`. Returns `NULL` if
+ * memory could not be allocated.
+ */
+static unsigned char *
+ras_ram_storage_insert(
+  struct ras_ram_storage_s *storage,
+  unsigned long int index
+) {
+  struct ras_ram_node_s *node = 0;
+  struct ras_ram_page_s *page = 0;
+  unsigned int level = 0;
+  unsigned long int slot = 0;
+
+  if (0 == storage->root) {
+    storage->root = ras_ram_node_new();
+    storage->height = 1;
+
+    if (0 == storage->root) {
+      return 0;
+    }
+  }
+
+  while (ras_ram_storage_beyond(storage->height, index)) {
+    node = ras_ram_node_new();
+
+    if (0 == node) {
+      return 0;
+    }
+
+    // the current table becomes the first slot of the new root
+    node->slots[0].node = storage->root;
+    node->count = 1;
+    storage->root = node;
+    storage->height++;
+  }
+
+  node = ras_ram_node_own(&storage->root, storage->height - 1);
+
+  for (level = storage->height - 1; 0 != node && level > 0; --level) {
+    slot = (index >> (level * RAS_RAM_RADIX_BITS)) & RAS_RAM_MASK;
+
+    if (0 == node->slots[slot].node) {
+      node->slots[slot].node = ras_ram_node_new();
+
+      if (0 == node->slots[slot].node) {
+        return 0;
+      }
+
+      node->count++;
+    }
+
+    node = ras_ram_node_own(&node->slots[slot].node, level - 1);
+  }
+
+  if (0 == node) {
+    return 0;
+  }
+
+  slot = index & RAS_RAM_MASK;
+
+  if (0 != node->slots[slot].page) {
+    page = ras_ram_page_own(storage, &node->slots[slot].page);
+    return 0 != page ? page->data : 0;
+  }
+
+  page = ras_alloc(sizeof(struct ras_ram_page_s) + storage->page_size);
+
+  if (0 == page) {
+    return 0;
+  }
+
+  memset(page->data, 0, storage->page_size);
+  page->refs = 1;
+  node->slots[slot].page = page;
+  node->count++;
+  storage->npages++;
+  return page->data;
+}
+
+/**
+ * Releases the page at `index` below the unshared `node` at `level` and
+ * frees any nodes left empty by it. Returns `1` if `node` is now empty,
+ * `0` if not and `-ENOMEM` if a shared node could not be copied.
+ */
+static int
+ras_ram_storage_remove(
+  struct ras_ram_storage_s *storage,
+  struct ras_ram_node_s *node,
+  unsigned int level,
+  unsigned long int index
+) {
+  const unsigned long int slot =
+    (index >> (level * RAS_RAM_RADIX_BITS)) & RAS_RAM_MASK;
+
+  struct ras_ram_node_s *child = node->slots[slot].node;
+  int rc = 0;
+
+  if (0 == child) {
+    return 0;
+  }
+
+  if (0 == level) {
+    ras_ram_page_release(node->slots[slot].page);
+    storage->npages--;
+  } else {
+    child = ras_ram_node_own(&node->slots[slot].node, level - 1);
+
+    if (0 == child) {
+      return -ENOMEM;
+    }
+
+    rc = ras_ram_storage_remove(storage, child, level - 1, index);
+
+    if (rc <= 0) {
+      return rc;
+    }
+
+    ras_ram_node_release(child, level - 1);
+  }
+
+  node->slots[slot].node = 0;
+  return 0 == --node->count;
+}
+
+static void
+ras_ram_storage_clear(struct ras_ram_storage_s *storage) {
+  if (0 != storage->root) {
+    ras_ram_node_release(storage->root, storage->height - 1);
+  }
+
+  storage->root = 0;
+  storage->height = 0;
+  storage->npages = 0;
+}
+
+/**
+ * Returns the number of bytes of a request at `offset` of `size` bytes
+ * before the end of the storage.
+ */
+static unsigned long int
+ras_ram_storage_clamp(
+  struct ras_ram_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size
+) {
+  if (offset >= storage->length) {
+    return 0;
+  }
+
+  if (size > storage->length - offset) {
+    return storage->length - offset;
+  }
+
+  return size;
+}
+
+static void
+ras_ram_storage_read(struct ras_request_s *request) {
+  struct ras_ram_storage_s *storage =
+    (struct ras_ram_storage_s *) request->storage;
+
+  const unsigned long int size =
+    ras_ram_storage_clamp(storage, request->offset, request->size);
+
+  unsigned char *data = request->data;
+  unsigned long int offset = request->offset;
+  unsigned long int remaining = size;
+
+  while (remaining > 0) {
+    const unsigned long int rel = offset & (storage->page_size - 1);
+    const unsigned char *page =
+      ras_ram_storage_lookup(storage, offset >> storage->page_shift);
+
+    unsigned long int chunk = storage->page_size - rel;
+
+    if (chunk > remaining) {
+      chunk = remaining;
+    }
+
+    // holes read as zeros without allocating a page
+    memcpy(data, 0 != page ? page + rel : ras_ram_zero_page, chunk);
+
+    data += chunk;
+    offset += chunk;
+    remaining -= chunk;
+  }
+
+  request->callback(request, 0, request->data, size);
+}
+
+static void
+ras_ram_storage_borrow(struct ras_request_s *request) {
+  struct ras_ram_storage_s *storage =
+    (struct ras_ram_storage_s *) request->storage;
+
+  const unsigned long int index = request->offset >> storage->page_shift;
+  const unsigned long int rel = request->offset & (storage->page_size - 1);
+  const unsigned char *page = 0;
+  unsigned long int size =
+    ras_ram_storage_clamp(storage, request->offset, request->size);
+
+  if (0 == size) {
+    request->callback(request, 0, 0, 0);
+    return;
+  }
+
+  // pages are not contiguous, so a loan ends at the end of its page
+  if (size > storage->page_size - rel) {
+    size = storage->page_size - rel;
+  }
+
+  page = ras_ram_storage_lookup(storage, index);
+
+  if (0 == page) {
+    page = ras_ram_zero_page;
+  }
+
+  request->callback(request, 0, (void *) (page + rel), size);
+}
+
+static void
+ras_ram_storage_write(struct ras_request_s *request) {
+  struct ras_ram_storage_s *storage =
+    (struct ras_ram_storage_s *) request->storage;
+
+  const unsigned long int end = request->offset + request->size;
+  const unsigned char *data = request->data;
+  unsigned long int offset = request->offset;
+
+  if (end < request->offset) {
+    request->callback(request, EOVERFLOW, 0, 0);
+    return;
+  }
+
+  while (offset < end) {
+    const unsigned long int rel = offset & (storage->page_size - 1);
+    unsigned char *page =
+      ras_ram_storage_insert(storage, offset >> storage->page_shift);
+
+    unsigned long int chunk = storage->page_size - rel;
+
+    if (0 == page) {
+      request->callback(request, ENOMEM, 0, 0);
+      return;
+    }
+
+    if (chunk > end - offset) {
+      chunk = end - offset;
+    }
+
+    memcpy(page + rel, data, chunk);
+
+    data += chunk;
+    offset += chunk;
+
+    if (offset > storage->length) {
+      storage->length = offset;
+    }
+  }
+
+  request->callback(request, 0, 0, request->size);
+}
+
+static void
+ras_ram_storage_delete(struct ras_request_s *request) {
+  struct ras_ram_storage_s *storage =
+    (struct ras_ram_storage_s *) request->storage;
+
+  const unsigned long int size =
+    ras_ram_storage_clamp(storage, request->offset, request->size);
+
+  const unsigned long int end = request->offset + size;
+  const unsigned int height = storage->height;
+  struct ras_ram_node_s *root = 0;
+  unsigned long int offset = request->offset;
+  int rc = 0;
+
+  while (offset < end) {
+    const unsigned long int index = offset >> storage->page_shift;
+    const unsigned long int rel = offset & (storage->page_size - 1);
+    unsigned char *page = ras_ram_storage_lookup(storage, index);
+
+    unsigned long int chunk = storage->page_size - rel;
+
+    if (chunk > end - offset) {
+      chunk = end - offset;
+    }
+
+    // pages deleted whole, or up to the end of the storage past which they
+    // only hold zeros, become holes again and the rest is zeroed
+    if (0 == page) {
+      offset += chunk;
+      continue;
+    }
+
+    if (
+      chunk == storage->page_size ||
+      (0 == rel && offset + chunk == storage->length)
+    ) {
+      root = ras_ram_node_own(&storage->root, height - 1);
+
+      if (0 == root) {
+        rc = -ENOMEM;
+      } else {
+        rc = ras_ram_storage_remove(storage, root, height - 1, index);
+      }
+    } else if (0 != (page = ras_ram_storage_insert(storage, index))) {
+      // copies the page first if it is shared with a snapshot
+      memset(page + rel, 0, chunk);
+    } else {
+      rc = -ENOMEM;
+    }
+
+    if (rc < 0) {
+      request->callback(request, -rc, 0, 0);
+      return;
+    }
+
+    offset += chunk;
+  }
+
+  if (0 == storage->npages) {
+    ras_ram_storage_clear(storage);
+  }
+
+  request->callback(request, 0, 0, request->size);
+}
+
+static void
+ras_ram_storage_stat(struct ras_request_s *request) {
+  struct ras_ram_storage_s *storage =
+    (struct ras_ram_storage_s *) request->storage;
+
+  struct ras_storage_stats_s *stats = request->data;
+
+  stats->size = storage->length;
+  request->callback(request, 0, stats, sizeof(struct ras_storage_stats_s));
+}
+
+static void
+ras_ram_storage_destroy(struct ras_request_s *request) {
+  struct ras_ram_storage_s *storage =
+    (struct ras_ram_storage_s *) request->storage;
+
+  ras_ram_storage_clear(storage);
+  storage->length = 0;
+  request->callback(request, 0, 0, 0);
+}
+
+struct ras_storage_s *
+ras_ram_storage_new(struct ras_ram_storage_options_s options) {
+  struct ras_ram_storage_s *storage = 0;
+  unsigned int page_size = options.page_size;
+  unsigned int page_shift = 0;
+
+  if (0 == page_size) {
+    page_size = RAS_RAM_PAGE_SIZE;
+  }
+
+  if (
+    page_size > RAS_RAM_MAX_PAGE_SIZE ||
+    0 != (page_size & (page_size - 1))
+  ) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  while ((1U << page_shift) < page_size) {
+    page_shift++;
+  }
+
+  storage = ras_alloc(sizeof(struct ras_ram_storage_s));
+
+  if (0 == storage) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  memset(storage, 0, sizeof(struct ras_ram_storage_s));
+
+  if (ras_storage_init(
+    (struct ras_storage_s *) storage,
+    (struct ras_storage_options_s) {
+      .read = ras_ram_storage_read,
+      .borrow = ras_ram_storage_borrow,
+      .write = ras_ram_storage_write,
+      .del = ras_ram_storage_delete,
+      .stat = ras_ram_storage_stat,
+      .destroy = ras_ram_storage_destroy,
+    }) < 0
+  ) {
+    ras_free(storage);
+    return 0;
+  }
+
+  storage->alloc = 1;
+  storage->page_size = page_size;
+  storage->page_shift = page_shift;
+  ras_emitter_init(&storage->emitter);
+  return (struct ras_storage_s *) storage;
+}
+
+struct ras_storage_s *
+ras_ram_storage_snapshot(struct ras_storage_s *storage) {
+  struct ras_ram_storage_s *source = (struct ras_ram_storage_s *) storage;
+  struct ras_ram_storage_s *snapshot = 0;
+
+  if (0 == storage) {
+    errno = EFAULT;
+    return 0;
+  }
+
+  snapshot = (struct ras_ram_storage_s *) ras_ram_storage_new(
+    (struct ras_ram_storage_options_s) {
+      .page_size = source->page_size,
+    });
+
+  if (0 == snapshot) {
+    return 0;
+  }
+
+  // both storages share the table until one of them writes to it
+  if (0 != source->root) {
+    __atomic_add_fetch(&source->root->refs, 1, __ATOMIC_RELAXED);
+  }
+
+  snapshot->root = source->root;
+  snapshot->height = source->height;
+  snapshot->length = source->length;
+  snapshot->npages = source->npages;
+  return (struct ras_storage_s *) snapshot;
+}
@@ -0,0 +1,469 @@
+#include "ras/allocator.h"
+#include "ras/request.h"
+#include "ras/storage.h"
+#include "dispatch.h"
+#include "readahead.h"
+#include <string.h>
+
+// Forward declarations
+struct ras_readahead_stream_s;
+
+/**
+ * A prefetched range of a stream. `request` is the read filling `data`
+ * while it is in flight and `used` counts the bytes reads were served.
+ */
+struct ras_readahead_window_s {
+  struct ras_readahead_stream_s *stream;
+  struct ras_request_s *request;
+  unsigned char *data;
+  unsigned long int offset;
+  unsigned long int size;
+  unsigned long int used;
+};
+
+/**
+ * The pattern of a stream of reads sharing a `shared` pointer. `stride` is
+ * the distance between its last two reads and `streak` the number of reads
+ * in a row at that distance. `window` is the size of the next prefetch and
+ * nothing is prefetched past `end`, where a prefetch came back short.
+ */
+struct ras_readahead_stream_s {
+  struct ras_readahead_window_s windows[2];
+  void *shared;
+  unsigned long int last;
+  unsigned long int stride;
+  unsigned long int window;
+  unsigned long int end;
+  unsigned long int tick;
+  unsigned int streak;
+  unsigned int active:1;
+};
+
+struct ras_readahead_s {
+  struct ras_readahead_stream_s streams[RAS_STORAGE_READAHEAD_STREAMS];
+  unsigned long int max;
+  unsigned long int tick;
+};
+
+static int
+ras_readahead_after(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size);
+
+int
+ras_readahead_owns(const struct ras_request_s *request) {
+  return ras_readahead_after == request->after;
+}
+
+struct ras_readahead_s *
+ras_readahead_new(unsigned long int max) {
+  struct ras_readahead_s *readahead = ras_alloc(sizeof(struct ras_readahead_s));
+
+  if (0 != readahead) {
+    memset(readahead, 0, sizeof(struct ras_readahead_s));
+    readahead->max = max;
+  }
+
+  return readahead;
+}
+
+/**
+ * Drops `window`, counting the bytes no read was served from as wasted. A
+ * window in flight frees its buffer once its prefetch completes.
+ */
+static void
+ras_readahead_discard(
+  struct ras_storage_s *storage,
+  struct ras_readahead_window_s *window
+) {
+  if (0 != window->request) {
+    window->request->shared = 0;
+  } else if (0 != window->data) {
+    if (window->used < window->size) {
+      storage->counters.readahead_wasted += window->size - window->used;
+    }
+
+    ras_free(window->data);
+  }
+
+  window->request = 0;
+  window->data = 0;
+  window->offset = 0;
+  window->size = 0;
+  window->used = 0;
+}
+
+void
+ras_readahead_free(struct ras_storage_s *storage) {
+  struct ras_readahead_s *readahead = storage->readahead;
+
+  if (0 == readahead) {
+    return;
+  }
+
+  for (int i = 0; i < RAS_STORAGE_READAHEAD_STREAMS; ++i) {
+    ras_readahead_discard(storage, &readahead->streams[i].windows[0]);
+    ras_readahead_discard(storage, &readahead->streams[i].windows[1]);
+  }
+
+  ras_free(readahead);
+  storage->readahead = 0;
+}
+
+/**
+ * Returns the stream of reads sharing `shared`, taking over the stream read
+ * least recently if it is not followed yet.
+ */
+static struct ras_readahead_stream_s *
+ras_readahead_stream(struct ras_storage_s *storage, void *shared) {
+  struct ras_readahead_s *readahead = storage->readahead;
+  struct ras_readahead_stream_s *stream = 0;
+
+  for (int i = 0; i < RAS_STORAGE_READAHEAD_STREAMS; ++i) {
+    struct ras_readahead_stream_s *candidate = &readahead->streams[i];
+
+    if (1 == candidate->active && shared == candidate->shared) {
+      stream = candidate;
+      break;
+    }
+
+    if (0 == stream || (1 == stream->active && (
+      0 == candidate->active || candidate->tick < stream->tick
+    ))) {
+      stream = candidate;
+    }
+  }
+
+  if (1 != stream->active || shared != stream->shared) {
+    ras_readahead_discard(storage, &stream->windows[0]);
+    ras_readahead_discard(storage, &stream->windows[1]);
+    memset(stream, 0, sizeof(struct ras_readahead_stream_s));
+    stream->windows[0].stream = stream;
+    stream->windows[1].stream = stream;
+    stream->end = (unsigned long int) -1;
+    stream->shared = shared;
+    stream->active = 1;
+  }
+
+  stream->tick = ++readahead->tick;
+  return stream;
+}
+
+/**
+ * Returns the number of bytes from `offset` up to `size` held by the
+ * prefetched windows of `stream`, copying them into `data` if it is not
+ * `NULL`.
+ */
+static unsigned long int
+ras_readahead_copy(
+  struct ras_readahead_stream_s *stream,
+  unsigned long int offset,
+  unsigned long int size,
+  unsigned char *data
+) {
+  unsigned long int copied = 0;
+
+  while (copied < size) {
+    const unsigned long int position = offset + copied;
+    struct ras_readahead_window_s *window = 0;
+    unsigned long int chunk = 0;
+
+    for (int i = 0; i < 2; ++i) {
+      struct ras_readahead_window_s *candidate = &stream->windows[i];
+
+      if (
+        0 == candidate->request &&
+        0 != candidate->data &&
+        candidate->offset <= position &&
+        position - candidate->offset < candidate->size
+      ) {
+        window = candidate;
+      }
+    }
+
+    if (0 == window) {
+      break;
+    }
+
+    chunk = window->offset + window->size - position;
+
+    if (chunk > size - copied) {
+      chunk = size - copied;
+    }
+
+    if (0 != data) {
+      memcpy(
+        data + copied,
+        window->data + (position - window->offset),
+        chunk);
+
+      window->used += chunk;
+    }
+
+    copied += chunk;
+  }
+
+  return copied;
+}
+
+/**
+ * Prefetches the window after the read `request` expects next if less
+ * than half a window is prefetched ahead of it. One prefetch of a stream
+ * is in flight at a time and each is twice the size of the one before it,
+ * up to the read-ahead maximum.
+ */
+static void
+ras_readahead_prefetch(
+  struct ras_storage_s *storage,
+  struct ras_readahead_stream_s *stream,
+  struct ras_request_s *request
+) {
+  const unsigned long int next = request->offset + stream->stride;
+  struct ras_readahead_window_s *window = &stream->windows[0];
+  struct ras_request_s *prefetch = 0;
+  unsigned long int ahead = 0;
+  unsigned long int start = 0;
+  unsigned long int size = 0;
+  unsigned char *data = 0;
+
+  for (int i = 0; i < 2; ++i) {
+    if (0 != stream->windows[i].request) {
+      return;
+    }
+
+    if (
+      0 != stream->windows[i].data &&
+      stream->windows[i].offset + stream->windows[i].size > ahead
+    ) {
+      ahead = stream->windows[i].offset + stream->windows[i].size;
+    }
+  }
+
+  if (next < request->offset) {
+    return;
+  }
+
+  if (0 == stream->window) {
+    stream->window = 4 * request->size;
+  }
+
+  if (stream->window > storage->readahead->max) {
+    stream->window = storage->readahead->max;
+  }
+
+  if (ahead > next && ahead - next >= stream->window / 2) {
+    return;
+  }
+
+  start = ahead > next ? ahead : next;
+  size = stream->window;
+
+  if (start >= stream->end || start + size < start) {
+    return;
+  }
+
+  if (size > stream->end - start) {
+    size = stream->end - start;
+  }
+
+  // reuse a free window or the one the reads have moved past
+  if (0 != window->data && (
+    0 == stream->windows[1].data ||
+    stream->windows[1].offset < window->offset
+  )) {
+    window = &stream->windows[1];
+  }
+
+  ras_readahead_discard(storage, window);
+  data = ras_alloc(size);
+
+  if (0 == data) {
+    return;
+  }
+
+  prefetch = ras_request_new(
+    (struct ras_request_options_s) {
+      .type = RAS_REQUEST_READ,
+      .storage = storage,
+      .shared = window,
+      .after = ras_readahead_after,
+      .offset = start,
+      .size = size,
+      .data = data,
+    });
+
+  if (0 == prefetch) {
+    ras_free(data);
+    return;
+  }
+
+  window->request = prefetch;
+  window->data = data;
+  window->offset = start;
+  window->size = size;
+  window->used = 0;
+
+  if (stream->window < storage->readahead->max / 2) {
+    stream->window *= 2;
+  } else {
+    stream->window = storage->readahead->max;
+  }
+
+  // the prefetch was freed without running if it could not be queued
+  if (ras_storage_run(storage, prefetch) < 0) {
+    window->request = 0;
+    window->size = 0;
+    ras_readahead_discard(storage, window);
+  }
+}
+
+static int
+ras_readahead_after(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  struct ras_storage_s *storage = request->storage;
+  struct ras_readahead_window_s *window = request->shared;
+  unsigned char *data = request->data;
+
+  request->data = 0;
+
+  if (0 == err) {
+    storage->counters.readahead_bytes += size;
+  }
+
+  // the window was dropped while the prefetch was in flight
+  if (0 == window) {
+    storage->counters.readahead_wasted += 0 == err ? size : 0;
+    ras_free(data);
+    return 0;
+  }
+
+  window->request = 0;
+
+  if (0 != err) {
+    window->size = 0;
+    ras_readahead_discard(storage, window);
+    return 0;
+  }
+
+  if (size > window->size) {
+    size = window->size;
+  }
+
+  if (0 != value && value != data) {
+    memcpy(data, value, size);
+  }
+
+  // a short prefetch reached the end of the storage
+  if (size < window->size) {
+    window->stream->end = window->offset + size;
+    window->size = size;
+  }
+
+  if (0 == size) {
+    ras_readahead_discard(storage, window);
+  }
+
+  return 0;
+}
+
+int
+ras_readahead_read(struct ras_request_s *request) {
+  struct ras_storage_s *storage = request->storage;
+  struct ras_readahead_stream_s *stream = 0;
+  const unsigned long int offset = request->offset;
+  const unsigned long int size = request->size;
+  int windows = 0;
+  int served = 0;
+
+  if (ras_readahead_owns(request) || 0 == request->data || 0 == size) {
+    return 0;
+  }
+
+  stream = ras_readahead_stream(storage, request->shared);
+
+  // reads of the same offset again leave the pattern as it is
+  if (offset != stream->last) {
+    const unsigned long int delta = offset > stream->last
+      ? offset - stream->last
+      : 0;
+
+    if (0 != delta && delta == stream->stride) {
+      stream->streak++;
+    } else {
+      stream->streak = 0;
+      stream->stride = delta;
+    }
+
+    stream->last = offset;
+  }
+
+  windows = 0 != stream->windows[0].data || 0 != stream->windows[1].data;
+
+  if (size == ras_readahead_copy(stream, offset, size, 0)) {
+    ras_readahead_copy(stream, offset, size, request->data);
+    storage->counters.readahead_hits++;
+    served = 1;
+  } else if (0 != windows) {
+    storage->counters.readahead_misses++;
+    stream->window /= 2;
+
+    if (stream->window < size) {
+      stream->window = size;
+    }
+  }
+
+  // a stream that broke its pattern keeps no windows
+  if (0 == stream->streak && 0 == served) {
+    ras_readahead_discard(storage, &stream->windows[0]);
+    ras_readahead_discard(storage, &stream->windows[1]);
+  } else if (0 != stream->streak) {
+    ras_readahead_prefetch(storage, stream, request);
+  }
+
+  if (0 != served) {
+    ras_request_callback(request, 0, request->data, size);
+  }
+
+  return served;
+}
+
+void
+ras_readahead_invalidate(struct ras_request_s *request) {
+  struct ras_storage_s *storage = request->storage;
+  struct ras_readahead_s *readahead = storage->readahead;
+  const int barrier = ras_request_is_barrier(request->type);
+  const unsigned long int start = request->offset;
+  unsigned long int end = request->offset + request->size;
+
+  if (end < start) {
+    end = (unsigned long int) -1;
+  }
+
+  for (int i = 0; i < RAS_STORAGE_READAHEAD_STREAMS; ++i) {
+    struct ras_readahead_stream_s *stream = &readahead->streams[i];
+
+    for (int j = 0; j < 2; ++j) {
+      struct ras_readahead_window_s *window = &stream->windows[j];
+
+      if (0 == window->data) {
+        continue;
+      }
+
+      if (
+        0 != barrier ||
+        (window->offset < end && start < window->offset + window->size)
+      ) {
+        ras_readahead_discard(storage, window);
+      }
+    }
+
+    // writes may extend the storage past where prefetches came back short
+    stream->end = (unsigned long int) -1;
+  }
+}
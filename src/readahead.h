@@ -0,0 +1,43 @@
+#ifndef _RAS_READAHEAD_H
+#define _RAS_READAHEAD_H
+
+struct ras_readahead_s;
+struct ras_request_s;
+struct ras_storage_s;
+
+/**
+ * Allocates the read-ahead state of a storage that prefetches at most
+ * `max` bytes at a time. Returns `NULL` if memory could not be allocated.
+ */
+struct ras_readahead_s *
+ras_readahead_new(unsigned long int max);
+
+/**
+ * Frees the read-ahead state of `storage` and its prefetched windows.
+ */
+void
+ras_readahead_free(struct ras_storage_s *storage);
+
+/**
+ * Follows the pattern of the read `request` is, prefetching the windows
+ * after it once it is sequential or strided. Returns `1` if `request` was
+ * completed from prefetched windows, otherwise `0` and it must be given to
+ * the `read()` operation.
+ */
+int
+ras_readahead_read(struct ras_request_s *request);
+
+/**
+ * Drops the prefetched windows the write, delete or barrier `request` is
+ * about to make stale.
+ */
+void
+ras_readahead_invalidate(struct ras_request_s *request);
+
+/**
+ * Returns `1` if `request` is a prefetch of the read-ahead.
+ */
+int
+ras_readahead_owns(const struct ras_request_s *request);
+
+#endif
@@ -1,7 +1,11 @@
 #include "ras/allocator.h"
 #include "ras/request.h"
 #include "ras/storage.h"
+#include "clock.h"
+#include "dispatch.h"
+#include "readahead.h"
 #include "require.h"
+#include "stats.h"
 #include <string.h>
 
 enum {
@@ -11,7 +15,7 @@ enum {
   _MAX = RAS_MAX_ENUM,
 };
 
-static int nrequests = 0xf + 0;
+static unsigned int nrequests = 0xf + 0;
 
 static int
 ras_request_dequeue(
@@ -20,26 +24,433 @@ ras_request_dequeue(
   enum ras_request_type type,
   unsigned int err);
 
+static void
+ras_request_work(void *data) {
+  struct ras_request_s *request = data;
+  request->operation(request);
+}
+
+/**
+ * Gives `request` to `operation`, on a worker thread of the executor of
+ * the storage if it has one.
+ */
+static void
+ras_request_perform(
+  struct ras_request_s *request,
+  ras_storage_request_callback_t *operation
+) {
+  struct ras_executor_s *executor = request->storage->options.executor;
+  int rc = 0;
+
+  if (0 == executor) {
+    operation(request);
+    return;
+  }
+
+  request->operation = operation;
+  rc = ras_executor_submit(executor, ras_request_work, request);
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  }
+}
+
+static int
+ras_request_segment_done(struct ras_request_s *request) {
+  if (0 == --request->remaining) {
+    return ras_request_callback(request, request->err, 0, request->transferred);
+  }
+
+  return 0;
+}
+
+static int
+ras_request_segment_callback(
+  struct ras_request_s *segment,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  struct ras_request_s *request = segment->parent;
+  struct ras_storage_s *storage = request->storage;
+  int rc = 0;
+
+  // segments may complete on different threads
+  ras_storage_lock(storage);
+
+  if (RAS_REQUEST_READ == segment->type) {
+    // a buffer of the storage's own is copied and freed like for a read
+    if (0 != value && value != segment->data) {
+      memcpy(segment->data, value, size < segment->size ? size : segment->size);
+      ras_free(value);
+    }
+  }
+
+  if (0 != err && 0 == request->err) {
+    request->err = err;
+  }
+
+  request->transferred += size;
+  ras_request_free(segment);
+  rc = ras_request_segment_done(request);
+  ras_storage_release(storage);
+  return rc;
+}
+
+/**
+ * Splits a vectored request into a request for each segment that is given to
+ * `run()` and completes the vectored request once every segment completes.
+ */
+static void
+ras_request_split(
+  struct ras_request_s *request,
+  ras_storage_request_callback_t *run
+) {
+  enum ras_request_type type = RAS_REQUEST_READV == request->type
+    ? RAS_REQUEST_READ
+    : RAS_REQUEST_WRITE;
+
+  // hold a reference so segments that complete synchronously
+  // do not complete the request before every segment is issued
+  request->remaining = 1;
+  request->transferred = 0;
+
+  for (int i = 0; i < request->nsegments; ++i) {
+    struct ras_request_segment_s *segment = &request->segments[i];
+    struct ras_request_s *split = ras_request_new(
+      (struct ras_request_options_s) {
+        .type = type,
+        .storage = request->storage,
+        .shared = request->shared,
+        .offset = segment->offset,
+        .size = segment->size,
+        .data = segment->buffer,
+      });
+
+    if (0 == split) {
+      if (0 == request->err) {
+        request->err = ENOMEM;
+      }
+      break;
+    }
+
+    split->callback = ras_request_segment_callback;
+    split->parent = request;
+    request->remaining++;
+    ras_request_perform(split, run);
+  }
+
+  ras_request_segment_done(request);
+}
+
+/**
+ * Closes the open group of sync requests and runs `sync()` for it. The
+ * group counts towards `max_inflight` as its leader from then on.
+ */
+static void
+ras_request_sync_run(struct ras_request_s *request) {
+  struct ras_storage_s *storage = request->storage;
+
+  // sync requests join the group meanwhile on other threads
+  if (0 != storage->options.executor && 0 != storage->options.sync_window) {
+    ras_clock_sleep(storage->options.sync_window * 1000UL);
+  }
+
+  // sync requests made from now on join the next group
+  ras_storage_lock(storage);
+  storage->sync_group = 0;
+  storage->sync_waiting--;
+  storage->counters.syncs++;
+  ras_storage_release(storage);
+
+  storage->options.sync(request);
+}
+
+/**
+ * Adds `request` to the open group of sync requests or opens a group led
+ * by it. A group opened while requests are being dispatched waits for the
+ * dispatch to end so the sync requests dispatched with it can join.
+ */
+static void
+ras_request_sync_join(struct ras_request_s *request) {
+  struct ras_storage_s *storage = request->storage;
+  struct ras_request_s *tail = storage->sync_group;
+
+  request->joined = 0;
+  storage->sync_waiting++;
+
+  if (0 == tail) {
+    storage->sync_group = request;
+
+    if (0 == storage->draining) {
+      ras_request_sync_start(storage);
+    }
+
+    return;
+  }
+
+  while (0 != tail->joined) {
+    tail = tail->joined;
+  }
+
+  tail->joined = request;
+}
+
+/**
+ * Completes the sync requests of the group led by `request` with the
+ * result of its `sync()`.
+ */
+static void
+ras_request_sync_done(struct ras_request_s *request, int err) {
+  struct ras_storage_s *storage = request->storage;
+  struct ras_request_s *joined = request->joined;
+
+  request->joined = 0;
+  storage->syncing = 0;
+
+  while (0 != joined) {
+    struct ras_request_s *next = joined->joined;
+    joined->joined = 0;
+    storage->sync_waiting--;
+    storage->counters.syncs_shared++;
+    ras_request_callback(joined, err, 0, 0);
+    joined = next;
+  }
+}
+
+void
+ras_request_sync_start(struct ras_storage_s *storage) {
+  struct ras_request_s *request = storage->sync_group;
+
+  if (0 == request || 0 != storage->syncing) {
+    return;
+  }
+
+  storage->syncing = request;
+  ras_request_perform(request, ras_request_sync_run);
+}
+
 static int
 readystate(struct ras_request_s *request) {
   require(request, EFAULT);
   require(request->storage, EFAULT);
-  int rc = NONE;
 
   if (1 == request->storage->opened && 0 == request->storage->closed) {
     return OPEN;
   }
 
-  if (0 == request->storage->opened) {
-    if (0 == request->err) {
-      request->err = 1;
-      rc = ERROR;
-    }
+  if (0 == request->err) {
+    request->err = EBADF;
+  }
+
+  return ERROR;
+}
+
+int
+ras_request_abort(struct ras_request_s *request, int reason) {
+  struct ras_storage_s *storage = request->storage;
+
+  if (0 != request->canceled || 1 == request->loaned) {
+    return -EALREADY;
+  }
+
+  if (1 == request->running && 0 == storage->options.cancel) {
+    return -EBUSY;
+  }
+
+  // merged into a request in flight that reads or writes for it
+  if (0 == request->running && 0 == request->queued && 1 == request->pending) {
+    return -EBUSY;
+  }
+
+  if (ECANCELED == reason) {
+    storage->counters.canceled++;
+  } else {
+    storage->counters.timeouts++;
+  }
+
+  request->canceled = reason;
+
+  if (1 == request->running) {
+    storage->options.cancel(request);
+    return 0;
+  }
+
+  // submitted from another thread, it fails once it is dispatched
+  request->err = reason;
+
+  if (1 == request->queued) {
+    ras_storage_queue_cancel(storage, request);
+    ras_request_run(request);
+  }
+
+  return 0;
+}
+
+int
+ras_request_cancel(struct ras_request_s *request) {
+  require(request, EFAULT);
+  require(request->storage, EFAULT);
+  require(0 == ras_request_is_barrier(request->type), EINVAL);
+
+  struct ras_storage_s *storage = request->storage;
+  const unsigned int thread_safe = storage->options.thread_safe;
+  int rc = 0;
+
+  ras_storage_lock(storage);
+
+  // the callback of a queued request may destroy the storage
+  rc = ras_request_abort(request, ECANCELED);
+
+  if (0 != thread_safe) {
+    ras_storage_release(storage);
+  }
+
+  if (rc < 0) {
+    errno = -rc;
   }
 
   return rc;
 }
 
+int
+ras_request_is_barrier(enum ras_request_type type) {
+  switch (type) {
+    case RAS_REQUEST_OPEN:
+    case RAS_REQUEST_CLOSE:
+    case RAS_REQUEST_DESTROY:
+      return 1;
+
+    default:
+      return 0;
+  }
+}
+
+static int
+writes(enum ras_request_type type) {
+  switch (type) {
+    case RAS_REQUEST_WRITE:
+    case RAS_REQUEST_WRITEV:
+    case RAS_REQUEST_DELETE:
+      return 1;
+
+    default:
+      return 0;
+  }
+}
+
+int
+ras_request_positional(const struct ras_request_s *request) {
+  switch (request->type) {
+    case RAS_REQUEST_READ:
+    case RAS_REQUEST_WRITE:
+    case RAS_REQUEST_DELETE:
+    case RAS_REQUEST_READV:
+    case RAS_REQUEST_WRITEV:
+    case RAS_REQUEST_BORROW:
+      return 1;
+
+    default:
+      return 0;
+  }
+}
+
+/**
+ * Computes the `[start, end)` range touched by `request`.
+ */
+static void
+range(
+  const struct ras_request_s *request,
+  unsigned long int *start,
+  unsigned long int *end
+) {
+  if (
+    RAS_REQUEST_STAT == request->type ||
+    RAS_REQUEST_FLUSH == request->type ||
+    RAS_REQUEST_SYNC == request->type
+  ) {
+    *start = 0;
+    *end = (unsigned long int) -1;
+    return;
+  }
+
+  *start = request->offset;
+  *end = request->offset + request->size;
+
+  // clamp on overflow
+  if (*end < *start) {
+    *end = (unsigned long int) -1;
+  }
+}
+
+int
+ras_request_conflicts(
+  const struct ras_request_s *a,
+  const struct ras_request_s *b
+) {
+  unsigned long int a_start = 0;
+  unsigned long int a_end = 0;
+  unsigned long int b_start = 0;
+  unsigned long int b_end = 0;
+
+  if (0 == a || 0 == b) {
+    return 0;
+  }
+
+  if (ras_request_is_barrier(a->type) || ras_request_is_barrier(b->type)) {
+    return 1;
+  }
+
+  if (0 == writes(a->type) && 0 == writes(b->type)) {
+    return 0;
+  }
+
+  range(a, &a_start, &a_end);
+  range(b, &b_start, &b_end);
+
+  return a_start < b_end && b_start < a_end;
+}
+
+void
+ras_request_begin(struct ras_request_s *request) {
+  struct ras_storage_s *storage = request->storage;
+
+  storage->pending++;
+  request->running = 1;
+
+  if (ras_request_is_barrier(request->type)) {
+    storage->barrier = 1;
+  }
+
+  if (0 != request->expires && (
+    0 == storage->next_expiry || request->expires < storage->next_expiry
+  )) {
+    storage->next_expiry = request->expires;
+  }
+
+  // writes and barriers make prefetched windows stale
+  if (0 != storage->readahead && (
+    writes(request->type) || ras_request_is_barrier(request->type)
+  )) {
+    ras_readahead_invalidate(request);
+  }
+
+  // track in flight requests for `ras_request_conflicts()`
+  request->inflight_prev = 0;
+  request->inflight_next = storage->inflight;
+
+  if (0 != storage->inflight) {
+    storage->inflight->inflight_prev = request;
+  }
+
+  storage->inflight = request;
+
+  // where an elevator sweeping the queue continues from
+  if (ras_request_positional(request)) {
+    storage->position = request->offset + request->size;
+  }
+}
+
 struct ras_request_s *
 ras_request_alloc() {
   return ras_alloc(sizeof(struct ras_request_s));
@@ -52,6 +463,7 @@ ras_request_init(
 ) {
   require(request, EFAULT);
   require(options.storage, EINVAL);
+  require(options.priority < RAS_REQUEST_PRIORITIES, EINVAL);
   require(memset(request, 0, sizeof(struct ras_request_s)), EFAULT);
 
   request->callback = ras_request_callback;
@@ -69,14 +481,49 @@ ras_request_init(
   request->data = options.data;
   request->done = options.callback;
   request->size = options.size;
+  request->segments = options.segments;
+  request->nsegments = options.nsegments;
+  request->priority = options.priority;
   request->err = 0;
-  request->id = ++nrequests;
+
+  if (0 != options.deadline) {
+    request->deadline = ras_clock_now() + options.deadline * 1000UL;
+  }
+
+  if (0 != options.timeout) {
+    request->expires = ras_clock_now() + options.timeout * 1000UL;
+  }
+
+  if (0 != options.handle) {
+    request->handle = options.handle;
+    __atomic_store_n(options.handle, request, __ATOMIC_RELEASE);
+  }
+
+  request->id = __atomic_add_fetch(&nrequests, 1, __ATOMIC_RELAXED);
   return 0;
 }
 
 struct ras_request_s *
 ras_request_new(const struct ras_request_options_s options) {
-  struct ras_request_s *request = ras_request_alloc();
+  struct ras_storage_s *storage = options.storage;
+  struct ras_request_s *request = 0;
+
+  if (0 != storage) {
+    ras_storage_pool_lock(storage);
+    if (0 != storage->pool) {
+      request = storage->pool;
+      storage->pool = request->next;
+      storage->pooled--;
+    }
+    ras_storage_pool_unlock(storage);
+  }
+
+  if (0 != request) {
+    ras_allocator_stats_pool_hit();
+  } else {
+    request = ras_request_alloc();
+    ras_allocator_stats_pool_miss();
+  }
 
   if (0 != request) {
     if (ras_request_init(request, options) < 0) {
@@ -92,11 +539,35 @@ ras_request_new(const struct ras_request_options_s options) {
 
 void
 ras_request_free(struct ras_request_s *request) {
+  // the handle of a request is only valid until it is freed, which
+  // happens under the dispatch lock `ras_storage_cancel()` takes
+  if (0 != request && 0 != request->handle) {
+    __atomic_store_n(request->handle, 0, __ATOMIC_RELEASE);
+    request->handle = 0;
+  }
+
   if (0 != request && 1 == request->alloc) {
+    struct ras_storage_s *storage = request->storage;
     request->storage = 0;
     request->alloc = 0;
-    memset(request, 0, sizeof(*request));
-    ras_free(request);
+
+    if (0 != storage) {
+      ras_storage_pool_lock(storage);
+      // return to pool, `ras_request_init()` will reset it when reused
+      if (storage->pooled < storage->options.pool_size) {
+        request->next = storage->pool;
+        storage->pool = request;
+        storage->pooled++;
+        request = 0;
+      }
+      ras_storage_pool_unlock(storage);
+    }
+
+    if (0 != request) {
+      memset(request, 0, sizeof(*request));
+      ras_free(request);
+    }
+
     request = 0;
   }
 }
@@ -106,75 +577,132 @@ ras_request_run(struct ras_request_s *request) {
   require(request, EFAULT);
   require(request->storage, EFAULT);
 
+  struct ras_storage_s *storage = request->storage;
+
+  ras_request_begin(request);
+
   if (0 != request->err) {
     return ras_request_callback(request, request->err, 0, 0);
   }
 
-  request->storage->pending++;
-
   if (0 != request->before) {
     request->before(request, request->err, request->data, request->size);
   }
 
   memcpy(
-    &(request->storage->last_request),
+    &(storage->last_request),
     request,
     sizeof(struct ras_request_s));
 
-  request->storage->last_request.done = 0;
-  request->storage->last_request.after = 0;
-  request->storage->last_request.before = 0;
-  request->storage->last_request.callback = 0;
+  storage->last_request.done = 0;
+  storage->last_request.after = 0;
+  storage->last_request.before = 0;
+  storage->last_request.callback = 0;
+
+#define RUN(operation)                                        \
+  if (OPEN != readystate(request)) {                          \
+    return ras_request_callback(request, request->err, 0, 0); \
+  } else if (0 != storage->options.operation) {               \
+    ras_request_perform(request, storage->options.operation); \
+  } else {                                                    \
+    return ras_request_callback(request, ENOSYS, 0, 0);       \
+  }
 
   switch (request->type) {
     case RAS_REQUEST_READ:
-      if (OPEN == readystate(request)) {
-        if (0 != request->storage->options.read) {
-          request->storage->options.read(request);
-        } else {
-          return ras_request_callback(request, ENOSYS, 0, 0);
-        }
+      if (
+        0 != storage->readahead &&
+        OPEN == readystate(request) &&
+        ras_readahead_read(request)
+      ) {
+        break;
       }
+
+      RUN(read);
       break;
 
     case RAS_REQUEST_WRITE:
-      if (OPEN == readystate(request)) {
-        if (0 != request->storage->options.write) {
-          request->storage->options.write(request);
-        } else {
-          return ras_request_callback(request, ENOSYS, 0, 0);
-        }
-      }
+      RUN(write);
       break;
 
     case RAS_REQUEST_DELETE:
-      if (OPEN == readystate(request)) {
-        if (0 != request->storage->options.del) {
-          request->storage->options.del(request);
-        } else {
-          return ras_request_callback(request, ENOSYS, 0, 0);
-        }
-      }
+      RUN(del);
       break;
 
     case RAS_REQUEST_STAT:
-      if (OPEN == readystate(request)) {
-        if (0 != request->storage->options.stat) {
-          request->storage->options.stat(request);
-        } else {
-          return ras_request_callback(request, ENOSYS, 0, 0);
-        }
+      RUN(stat);
+      break;
+
+    case RAS_REQUEST_READV:
+      if (OPEN != readystate(request)) {
+        return ras_request_callback(request, request->err, 0, 0);
+      } else if (0 != storage->options.readv) {
+        ras_request_perform(request, storage->options.readv);
+      } else if (0 != storage->options.read) {
+        ras_request_split(request, storage->options.read);
+      } else {
+        return ras_request_callback(request, ENOSYS, 0, 0);
+      }
+      break;
+
+    case RAS_REQUEST_WRITEV:
+      if (OPEN != readystate(request)) {
+        return ras_request_callback(request, request->err, 0, 0);
+      } else if (0 != storage->options.writev) {
+        ras_request_perform(request, storage->options.writev);
+      } else if (0 != storage->options.write) {
+        ras_request_split(request, storage->options.write);
+      } else {
+        return ras_request_callback(request, ENOSYS, 0, 0);
+      }
+      break;
+
+    case RAS_REQUEST_BORROW:
+      if (OPEN != readystate(request)) {
+        return ras_request_callback(request, request->err, 0, 0);
+      } else if (0 != storage->options.borrow) {
+        ras_request_perform(request, storage->options.borrow);
+      } else if (0 != storage->options.read) {
+        // lends the buffer allocated for the request instead
+        ras_request_perform(request, storage->options.read);
+      } else {
+        return ras_request_callback(request, ENOSYS, 0, 0);
+      }
+      break;
+
+    case RAS_REQUEST_FLUSH:
+      if (OPEN != readystate(request)) {
+        return ras_request_callback(request, request->err, 0, 0);
+      } else if (0 != storage->options.flush) {
+        ras_request_perform(request, storage->options.flush);
+      } else {
+        // nothing is held in memory to flush
+        return ras_request_callback(request, 0, 0, 0);
+      }
+      break;
+
+    case RAS_REQUEST_SYNC:
+      if (OPEN != readystate(request)) {
+        return ras_request_callback(request, request->err, 0, 0);
+      } else if (0 == storage->options.sync) {
+        // nothing is written that is not durable already
+        return ras_request_callback(request, 0, 0, 0);
+      } else if (0 != storage->options.group_sync) {
+        ras_request_sync_join(request);
+      } else {
+        storage->counters.syncs++;
+        ras_request_perform(request, storage->options.sync);
       }
       break;
 
     case RAS_REQUEST_OPEN:
-      if (1 == request->storage->opened && 0 == request->storage->needs_open) {
+      if (1 == storage->opened && 0 == storage->needs_open) {
         return ras_request_callback(request, 0, 0, 0);
       } else {
-        if (1 == request->storage->prefer_read_only) {
-          request->storage->options.open_read_only(request);
-        } else if (0 != request->storage->options.open) {
-          request->storage->options.open(request);
+        if (1 == storage->prefer_read_only) {
+          storage->options.open_read_only(request);
+        } else if (0 != storage->options.open) {
+          storage->options.open(request);
         } else {
           return ras_request_callback(request, 0, 0, 0);
         }
@@ -182,20 +710,20 @@ ras_request_run(struct ras_request_s *request) {
       break;
 
     case RAS_REQUEST_CLOSE:
-      if (1 == request->storage->closed || 0 == request->storage->opened) {
+      if (1 == storage->closed || 0 == storage->opened) {
         return ras_request_callback(request, 0, 0, 0);
-      } else if (0 != request->storage->options.close) {
-        request->storage->options.close(request);
+      } else if (0 != storage->options.close) {
+        storage->options.close(request);
       } else {
         return ras_request_callback(request, 0, 0, 0);
       }
       break;
 
     case RAS_REQUEST_DESTROY:
-      if (1 == request->storage->destroyed) {
+      if (1 == storage->destroyed) {
         return ras_request_callback(request, 0, 0, 0);
-      } else if (0 != request->storage->options.destroy) {
-        request->storage->options.destroy(request);
+      } else if (0 != storage->options.destroy) {
+        storage->options.destroy(request);
       } else {
         return ras_request_callback(request, 0, 0, 0);
       }
@@ -206,6 +734,8 @@ ras_request_run(struct ras_request_s *request) {
       break;
   }
 
+#undef RUN
+
   return 0;
 }
 
@@ -216,7 +746,6 @@ ras_request_dequeue(
   enum ras_request_type type,
   unsigned int err
 ) {
-  unsigned int needs_free = 0;
   require(request, EFAULT);
   require(request->storage, EFAULT);
 
@@ -226,8 +755,9 @@ ras_request_dequeue(
       storage->needs_open = 1;
       storage->opened = 0;
       for (int i = 0; i < storage->queued; ++i) {
-        if (0 != storage->queue[i]) {
-          storage->queue[i]->err = err;
+        struct ras_request_s *queued = ras_storage_queue_at(storage, i);
+        if (0 != queued) {
+          queued->err = err;
         }
       }
     }
@@ -236,6 +766,7 @@ ras_request_dequeue(
       case RAS_REQUEST_OPEN:
         if (0 == storage->opened) {
           storage->opened = 1;
+          storage->closed = 0;
           storage->needs_open = 0;
           // @TODO(jwerle): HOOK(open)
         }
@@ -263,39 +794,69 @@ ras_request_dequeue(
     }
   }
 
-  struct ras_request_s *head = storage->queue[0];
-  unsigned int queued = storage->queued;
-  if (queued > 0 && head == request) {
-    ras_storage_queue_shift(storage);
-    needs_free = 1;
-    request = 0;
-    head = 0;
+  if (ras_request_is_barrier(type)) {
+    storage->barrier = 0;
   }
 
-  // drain queue
-  if (0 == (int) --storage->pending) {
-    while (storage->queued > 0) {
-      if (0 == storage->queue[0]) {
-        ras_storage_queue_shift(storage);
-      }
+  request->pending = 0;
+  request->running = 0;
 
-      if (ras_request_run(storage->queue[0]) < 0) {
-        break;
-      }
+  if (0 != request->inflight_prev) {
+    request->inflight_prev->inflight_next = request->inflight_next;
+  } else if (storage->inflight == request) {
+    storage->inflight = request->inflight_next;
+  }
 
-      if (type >= RAS_REQUEST_OPEN) { // [ open, close, destroy ]
-        break;
-      } else {
-        ras_request_free(ras_storage_queue_shift(storage));
-      }
-    }
+  if (0 != request->inflight_next) {
+    request->inflight_next->inflight_prev = request->inflight_prev;
+  }
+
+  request->inflight_prev = 0;
+  request->inflight_next = 0;
+
+  if (storage->pending > 0) {
+    storage->pending--;
   }
 
-  if ((int) storage->pending < 0) {
-    storage->pending = 0;
+  return 0;
+}
+
+/**
+ * Tracks a successfully borrowed read as a loan of `buffer` on its storage.
+ */
+static void
+ras_request_lend(struct ras_request_s *request, void *buffer) {
+  struct ras_storage_s *storage = request->storage;
+
+  request->loaned = 1;
+  request->data = buffer;
+  request->inflight_prev = 0;
+  request->inflight_next = storage->loans;
+
+  if (0 != storage->loans) {
+    storage->loans->inflight_prev = request;
   }
 
-  return needs_free;
+  storage->loans = request;
+}
+
+void
+ras_request_return(struct ras_request_s *loan) {
+  struct ras_storage_s *storage = loan->storage;
+
+  if (0 != loan->inflight_prev) {
+    loan->inflight_prev->inflight_next = loan->inflight_next;
+  } else if (storage->loans == loan) {
+    storage->loans = loan->inflight_next;
+  }
+
+  if (0 != loan->inflight_next) {
+    loan->inflight_next->inflight_prev = loan->inflight_prev;
+  }
+
+  loan->inflight_prev = 0;
+  loan->inflight_next = 0;
+  loan->loaned = 0;
 }
 
 int
@@ -308,10 +869,20 @@ ras_request_callback(
   require(request, EFAULT);
   require(request->storage, EFAULT);
 
+  struct ras_storage_s *storage = request->storage;
+  const unsigned int thread_safe = storage->options.thread_safe;
+
+  // requests may complete on any thread in thread-safe mode
+  ras_storage_lock(storage);
+
+  // a canceled request that was aborted fails for the reason it was canceled
+  if (0 != request->canceled && 0 != err) {
+    err = request->canceled;
+  }
+
   request->size = size;
   request->err = err;
 
-  struct ras_storage_s *storage = request->storage;
   ras_request_callback_t *after = request->after;
   ras_request_callback_t *hook = request->hook;
   ras_request_callback_t *emit = request->emit;
@@ -319,15 +890,25 @@ ras_request_callback(
   unsigned int opened = storage->opened;
   unsigned int closed = storage->closed;
   unsigned int type = request->type;
+  struct ras_request_segment_s *segments = request->segments;
+  unsigned long int nsegments = request->nsegments;
   void *done = request->done;
 
   if (0 != emit) {
     emit(request, err, value, size);
   }
 
-  int needs_free = ras_request_dequeue(request, storage, type, err);
+  ras_request_dequeue(request, storage, type, err);
   unsigned int destroyed = storage->destroyed;
 
+  // a borrowed read stays alive as the loan of its buffer
+  const unsigned int loaned = RAS_REQUEST_BORROW == type && 0 == err;
+
+  if (0 != loaned) {
+    ras_request_lend(request, value);
+    after = 0;
+  }
+
   if (type == RAS_REQUEST_OPEN && (1 == opened || 1 == destroyed)) {
     after = 0;
   }
@@ -336,6 +917,16 @@ ras_request_callback(
     after = 0;
   }
 
+  // requests made in callbacks are queued and drained after
+  // the callbacks return, a destroyed storage may not outlive them
+  if (RAS_REQUEST_DESTROY != type) {
+    storage->draining++;
+  }
+
+  if (RAS_REQUEST_SYNC == type && request == storage->syncing) {
+    ras_request_sync_done(request, err);
+  }
+
 #define CALL(T, ...)                                         \
   if (0 != hook) { hook(request, err, value, size); }        \
   if (0 != done) {  ((T) done)(storage, __VA_ARGS__); }      \
@@ -355,7 +946,27 @@ ras_request_callback(
       break;
 
     case RAS_REQUEST_STAT:
-      CALL(ras_storage_stat_callback_t *, err, (struct ras_storage_stats_s *) value);
+      CALL(
+        ras_storage_stat_callback_t *,
+        err,
+        (struct ras_storage_stats_s *) value);
+      break;
+
+    case RAS_REQUEST_READV:
+      CALL(ras_storage_readv_callback_t *, err, segments, nsegments);
+      break;
+
+    case RAS_REQUEST_WRITEV:
+      CALL(ras_storage_writev_callback_t *, err);
+      break;
+
+    case RAS_REQUEST_BORROW:
+      CALL(
+        ras_storage_borrow_callback_t *,
+        err,
+        value,
+        size,
+        0 != loaned ? request : 0);
       break;
 
     case RAS_REQUEST_OPEN:
@@ -370,15 +981,33 @@ ras_request_callback(
       CALL(ras_storage_destroy_callback_t *, err);
       break;
 
+    case RAS_REQUEST_FLUSH:
+      CALL(ras_storage_flush_callback_t *, err);
+      break;
+
+    case RAS_REQUEST_SYNC:
+      CALL(ras_storage_sync_callback_t *, err);
+      break;
+
     case RAS_REQUEST_NONE:
       break;
   }
 
 #undef CALL
 
-  if (1 == needs_free) {
+  // the loan may already be released by the callback
+  if (0 == loaned) {
     ras_request_free(request);
   }
 
+  if (RAS_REQUEST_DESTROY != type) {
+    storage->draining--;
+    ras_storage_queue_drain(storage);
+  }
+
+  if (0 != thread_safe) {
+    ras_storage_release(storage);
+  }
+
   return - (int) err;
 }
@@ -0,0 +1,16 @@
+#ifndef _RAS_STATS_H
+#define _RAS_STATS_H
+
+/**
+ * Increments the request pool hit counter in `ras_allocator_stats()`.
+ */
+void
+ras_allocator_stats_pool_hit();
+
+/**
+ * Increments the request pool miss counter in `ras_allocator_stats()`.
+ */
+void
+ras_allocator_stats_pool_miss();
+
+#endif
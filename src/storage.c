@@ -1,27 +1,465 @@
 #include "ras/allocator.h"
 #include "ras/storage.h"
 #include "ras/emitter.h"
+#include "clock.h"
+#include "dispatch.h"
+#include "readahead.h"
 #include "require.h"
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <sched.h>
+
+/**
+ * Returns the number of requests in flight that count towards
+ * `max_inflight`, which sync requests waiting in a group do not.
+ */
+static unsigned int
+ras_storage_inflight(struct ras_storage_s *storage) {
+  return storage->pending - storage->sync_waiting;
+}
+
+/**
+ * Returns the number of requests in the queue, which the slots left by
+ * canceled requests until the head reaches them do not count towards.
+ */
+static unsigned int
+ras_storage_queue_length(struct ras_storage_s *storage) {
+  return storage->queued - storage->tombstones;
+}
 
+/**
+ * Returns `1` if a data request can start given the number of requests
+ * in flight.
+ */
 static int
-run_request(
+ras_storage_request_slot(struct ras_storage_s *storage) {
+  return 0 == storage->barrier
+    && ras_storage_inflight(storage) < storage->options.max_inflight;
+}
+
+/**
+ * Returns `1` if `request` conflicts with a request in flight or with the
+ * range of a borrowed read that has not been released.
+ */
+static int
+ras_storage_request_hazard(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request
+) {
+  struct ras_request_s *inflight = storage->inflight;
+  struct ras_request_s *loan = storage->loans;
+
+  while (0 != inflight) {
+    if (ras_request_conflicts(inflight, request)) {
+      return 1;
+    }
+
+    inflight = inflight->inflight_next;
+  }
+
+  while (0 != loan) {
+    if (ras_request_conflicts(loan, request)) {
+      return 1;
+    }
+
+    loan = loan->inflight_next;
+  }
+
+  return 0;
+}
+
+/**
+ * Counts a request that waits on a conflicting request once.
+ */
+static void
+ras_storage_request_stall(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request
+) {
+  if (0 == request->stalled) {
+    request->stalled = 1;
+    storage->counters.hazard_stalls++;
+  }
+}
+
+/**
+ * Returns `1` if `request` can run given the requests in flight.
+ */
+static int
+ras_storage_request_ready(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request
+) {
+  if (ras_request_is_barrier(request->type)) {
+    return 0 == storage->pending && 0 == storage->loans;
+  }
+
+  if (0 == ras_storage_request_slot(storage)) {
+    return 0;
+  }
+
+  if (ras_storage_request_hazard(storage, request)) {
+    ras_storage_request_stall(storage, request);
+    return 0;
+  }
+
+  return 1;
+}
+
+/**
+ * Returns `1` if `request` can run now without being queued.
+ */
+static int
+ras_storage_queue_ready(
   struct ras_storage_s *storage,
   struct ras_request_s *request
 ) {
+  if (storage->draining > 0 || storage->queued > 0) {
+    return 0;
+  }
+
+  return ras_storage_request_ready(storage, request);
+}
+
+/**
+ * Opens the storage before its first request. Requests made while
+ * the open is pending queue behind it instead of opening again.
+ */
+static int
+open_if_needed(struct ras_storage_s *storage) {
+  int rc = 0;
+
   if (1 == storage->needs_open && 0 == storage->opened) {
-    request->err = ras_storage_open(storage, 0);
+    storage->needs_open = 0;
+    rc = ras_storage_open(storage, 0);
+    if (rc < 0) {
+      storage->needs_open = 1;
+    }
   }
 
-  if (storage->queued > 0) {
-    ras_storage_queue_push(storage, request);
-  } else {
+  return rc;
+}
+
+// identifies the calling thread as the owner of a storage dispatch lock
+static __thread char ras_storage_thread = 0;
+
+#define THREAD ((void *) &ras_storage_thread)
+
+static void
+ras_storage_spin(unsigned int *spins) {
+  if (0 == (++(*spins) & 0x3f)) {
+    sched_yield();
+  }
+}
+
+int
+ras_storage_locked(struct ras_storage_s *storage) {
+  return THREAD == __atomic_load_n(&storage->owner, __ATOMIC_RELAXED);
+}
+
+static int
+ras_storage_trylock(struct ras_storage_s *storage) {
+  void *owner = 0;
+
+  if (ras_storage_locked(storage)) {
+    storage->locks++;
+    return 1;
+  }
+
+  if (__atomic_compare_exchange_n(
+    &storage->owner,
+    &owner,
+    THREAD,
+    0,
+    __ATOMIC_ACQUIRE,
+    __ATOMIC_RELAXED)
+  ) {
+    storage->locks = 1;
+    return 1;
+  }
+
+  return 0;
+}
+
+void
+ras_storage_lock(struct ras_storage_s *storage) {
+  unsigned int spins = 0;
+
+  if (0 == storage->options.thread_safe) {
+    return;
+  }
+
+  while (0 == ras_storage_trylock(storage)) {
+    ras_storage_spin(&spins);
+  }
+}
+
+/**
+ * Releases the dispatch lock once for the calling thread. Returns `1` if
+ * the storage was destroyed while locked and has been freed.
+ */
+static int
+ras_storage_unlock(struct ras_storage_s *storage) {
+  unsigned int expired = 0;
+
+  if (--storage->locks > 0) {
+    return 0;
+  }
+
+  expired = storage->expired;
+  __atomic_store_n(&storage->owner, 0, __ATOMIC_RELEASE);
+
+  if (1 == expired) {
+    ras_storage_free(storage);
+    return 1;
+  }
+
+  return 0;
+}
+
+void
+ras_storage_pool_lock(struct ras_storage_s *storage) {
+  unsigned int spins = 0;
+
+  if (0 == storage->options.thread_safe) {
+    return;
+  }
+
+  while (__atomic_exchange_n(&storage->pool_lock, 1, __ATOMIC_ACQUIRE)) {
+    ras_storage_spin(&spins);
+  }
+}
+
+void
+ras_storage_pool_unlock(struct ras_storage_s *storage) {
+  if (0 != storage->options.thread_safe) {
+    __atomic_store_n(&storage->pool_lock, 0, __ATOMIC_RELEASE);
+  }
+}
+
+/**
+ * Pushes `request` on to the lock-free (multiple producer, single
+ * consumer) submission queue. Safe to call from any thread.
+ */
+static void
+ras_storage_submission_push(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request
+) {
+  struct ras_request_s *prev = 0;
+
+  __atomic_store_n(&request->next, 0, __ATOMIC_RELAXED);
+  prev = __atomic_exchange_n(&storage->submit_tail, request, __ATOMIC_ACQ_REL);
+  __atomic_store_n(&prev->next, request, __ATOMIC_RELEASE);
+}
+
+/**
+ * Pops the oldest request from the submission queue. Only the thread that
+ * holds the dispatch lock may call this. Returns `NULL` if the queue is
+ * empty or a push has not been linked yet.
+ */
+static struct ras_request_s *
+ras_storage_submission_pop(struct ras_storage_s *storage) {
+  struct ras_request_s *stub = &storage->submit_stub;
+  struct ras_request_s *head = storage->submit_head;
+  struct ras_request_s *next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+
+  if (stub == head) {
+    if (0 == next) {
+      return 0;
+    }
+
+    storage->submit_head = next;
+    head = next;
+    next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+  }
+
+  if (0 != next) {
+    storage->submit_head = next;
+    return head;
+  }
+
+  if (head != __atomic_load_n(&storage->submit_tail, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+
+  ras_storage_submission_push(storage, stub);
+  next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+
+  if (0 != next) {
+    storage->submit_head = next;
+    return head;
+  }
+
+  return 0;
+}
+
+/**
+ * Reserves room for `count` requests in the submission queue.
+ */
+static int
+ras_storage_submission_reserve(
+  struct ras_storage_s *storage,
+  unsigned int count
+) {
+  unsigned int submitted = __atomic_add_fetch(
+    &storage->submitted,
+    count,
+    __ATOMIC_ACQ_REL);
+
+  if (submitted > storage->options.max_queued) {
+    __atomic_sub_fetch(&storage->submitted, count, __ATOMIC_ACQ_REL);
+    return 0;
+  }
+
+  return 1;
+}
+
+/**
+ * Moves submitted requests on to the request queue in the order they were
+ * submitted. Returns `1` if requests remain because the queue is full.
+ */
+static int
+ras_storage_collect(struct ras_storage_s *storage) {
+  while (__atomic_load_n(&storage->submitted, __ATOMIC_ACQUIRE) > 0) {
+    struct ras_request_s *request = 0;
+    int rc = 0;
+
+    if (ras_storage_queue_length(storage) >= storage->options.max_queued) {
+      return 1;
+    }
+
+    request = ras_storage_submission_pop(storage);
+
+    if (0 == request) {
+      break;
+    }
+
+    __atomic_sub_fetch(&storage->submitted, 1, __ATOMIC_ACQ_REL);
+    request->next = 0;
+
+    if (0 == ras_request_is_barrier(request->type)) {
+      rc = open_if_needed(storage);
+      if (rc < 0 && 0 == request->err) {
+        request->err = -rc;
+      }
+    }
+
+    rc = ras_storage_queue_push(storage, request);
+    if (rc < 0) {
+      // the implicit open took the last queue slot
+      request->err = -rc;
+      ras_request_run(request);
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Dispatches submitted requests if no other thread is dispatching for the
+ * storage. The thread that holds the dispatch lock dispatches requests
+ * submitted while it holds it before it lets go.
+ */
+static void
+ras_storage_dispatch(struct ras_storage_s *storage) {
+  while (__atomic_load_n(&storage->submitted, __ATOMIC_ACQUIRE) > 0) {
+    int full = 0;
+
+    if (0 == ras_storage_trylock(storage)) {
+      return;
+    }
+
+    if (0 == storage->expired) {
+      ras_storage_collect(storage);
+      ras_storage_queue_drain(storage);
+    }
+
+    // requests in flight dispatch the rest as they complete
+    full = ras_storage_queue_length(storage) >= storage->options.max_queued;
+
+    if (ras_storage_unlock(storage) || full) {
+      return;
+    }
+  }
+}
+
+void
+ras_storage_release(struct ras_storage_s *storage) {
+  if (0 == storage->options.thread_safe) {
+    return;
+  }
+
+  if (storage->locks > 1) {
+    storage->locks--;
+    return;
+  }
+
+  if (0 == ras_storage_unlock(storage)) {
+    ras_storage_dispatch(storage);
+  }
+}
+
+/**
+ * Submits `request` from a thread that does not hold the dispatch lock.
+ */
+static int
+ras_storage_enqueue(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request
+) {
+  if (0 == ras_storage_submission_reserve(storage, 1)) {
+    ras_request_free(request);
+    require(0, EAGAIN);
+  }
+
+  ras_storage_submission_push(storage, request);
+  ras_storage_dispatch(storage);
+  return 0;
+}
+
+/**
+ * Returns `1` if `request` must be submitted with `ras_storage_enqueue()`.
+ */
+static int
+ras_storage_concurrent(struct ras_storage_s *storage) {
+  return 0 != storage->options.thread_safe
+    && 0 == ras_storage_locked(storage);
+}
+
+static int
+run_request(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request
+) {
+  int rc = 0;
+
+  if (ras_storage_concurrent(storage)) {
+    return ras_storage_enqueue(storage, request);
+  }
+
+  rc = open_if_needed(storage);
+  if (rc < 0) {
+    ras_request_free(request);
+    return rc;
+  }
+
+  request->err = rc;
+
+  if (ras_storage_queue_ready(storage, request)) {
     return ras_request_run(request);
   }
 
-  return - request->err;
+  rc = ras_storage_queue_push(storage, request);
+  if (rc < 0) {
+    ras_request_free(request);
+    return rc;
+  }
+
+  rc = - request->err;
+  ras_storage_queue_drain(storage);
+  return rc;
 }
 
 static int
@@ -29,14 +467,29 @@ queue_and_run(
   struct ras_storage_s *storage,
   struct ras_request_s *request
 ) {
-  ras_storage_queue_push(storage, request);
+  int rc = 0;
+
+  if (ras_storage_concurrent(storage)) {
+    return ras_storage_enqueue(storage, request);
+  }
 
-  if (0 == storage->pending) {
+  if (ras_storage_queue_ready(storage, request)) {
     return -ras_request_run(request);
-  } else {
-    return - request->err;
   }
 
+  rc = ras_storage_queue_push(storage, request);
+  if (rc < 0) {
+    ras_request_free(request);
+    return rc;
+  }
+
+  ras_storage_queue_drain(storage);
+  return 0;
+}
+
+int
+ras_storage_run(struct ras_storage_s *storage, struct ras_request_s *request) {
+  return queue_and_run(storage, request);
 }
 
 struct ras_storage_s *
@@ -55,6 +508,50 @@ ras_storage_init(
     memcpy(&storage->options, &options, sizeof(struct ras_storage_options_s)),
     EFAULT);
 
+  if (0 == storage->options.max_queued) {
+    storage->options.max_queued = RAS_STORAGE_MAX_REQUEST_QUEUE;
+  }
+
+  if (0 == storage->options.max_inflight) {
+    storage->options.max_inflight = RAS_STORAGE_MAX_INFLIGHT;
+  }
+
+  if (0 == storage->options.pool_size) {
+    storage->options.pool_size = RAS_STORAGE_REQUEST_POOL_SIZE;
+  }
+
+  require(storage->options.schedule <= RAS_STORAGE_SCHEDULE_CSCAN, EINVAL);
+
+  if (0 == storage->options.priority_aging) {
+    storage->options.priority_aging = RAS_STORAGE_PRIORITY_AGING;
+  }
+
+  // operations complete on executor worker threads
+  if (0 != storage->options.executor) {
+    storage->options.thread_safe = 1;
+  }
+
+  if (0 != storage->options.readahead) {
+    storage->readahead = ras_readahead_new(storage->options.readahead);
+    require(storage->readahead, ENOMEM);
+  }
+
+  // preallocate request pool
+  while (storage->pooled < storage->options.pool_size) {
+    struct ras_request_s *request = ras_request_alloc();
+
+    if (0 == request) {
+      break;
+    }
+
+    request->alloc = 0;
+    request->next = storage->pool;
+    storage->pool = request;
+    storage->pooled++;
+  }
+
+  storage->submit_head = &storage->submit_stub;
+  storage->submit_tail = &storage->submit_stub;
   storage->prefer_read_only = 0 != options.open_read_only;
   storage->needs_open = 1;
   storage->deletable = 0 != options.del;
@@ -70,19 +567,38 @@ ras_storage_new(struct ras_storage_options_s options) {
   struct ras_storage_s *storage = ras_storage_alloc();
   if (ras_storage_init(storage, options) < 0) {
     ras_free(storage);
-    storage = 0;
-  } else {
-    storage->alloc = 1;
+    return 0;
   }
 
+  storage->alloc = 1;
   ras_emitter_init(&storage->emitter);
   return storage;
 }
 
 void
 ras_storage_free(struct ras_storage_s *storage) {
-  if (0 != storage && 1 == storage->alloc) {
-    ras_free(storage);
+  if (0 != storage) {
+    ras_free(storage->queue);
+    storage->queue = 0;
+    storage->queue_size = 0;
+    storage->queue_head = 0;
+    storage->queued = 0;
+    storage->prioritized = 0;
+    storage->tombstones = 0;
+    storage->next_expiry = 0;
+
+    while (0 != storage->pool) {
+      struct ras_request_s *request = storage->pool;
+      storage->pool = request->next;
+      ras_free(request);
+    }
+
+    storage->pooled = 0;
+    ras_readahead_free(storage);
+
+    if (1 == storage->alloc) {
+      ras_free(storage);
+    }
   }
 }
 
@@ -100,15 +616,25 @@ ras_storage_destroy_after(
   }
 
   if (0 != storage) {
-    for (int i = 0; i < RAS_STORAGE_MAX_REQUEST_QUEUE; ++i) {
+    for (int i = 0; i < storage->queue_size; ++i) {
       if (0 != storage->queue[i]) {
         storage->queue[i]->storage = 0;
         ras_request_free(storage->queue[i]);
       }
     }
 
-    storage->queued = 0;
-    ras_storage_free(storage);
+    if (0 != storage->options.thread_safe) {
+      struct ras_request_s *submitted = 0;
+      while (0 != (submitted = ras_storage_submission_pop(storage))) {
+        submitted->storage = 0;
+        ras_request_free(submitted);
+      }
+
+      // freed once the dispatch lock is released
+      storage->expired = 1;
+    } else {
+      ras_storage_free(storage);
+    }
   }
 
   return 0;
@@ -224,17 +750,17 @@ ras_storage_close_emit(
 }
 
 int
-ras_storage_close(
+ras_storage_flush(
   struct ras_storage_s *storage,
-  ras_storage_close_callback_t *callback
+  ras_storage_flush_callback_t *callback
 ) {
-  return ras_storage_close_shared(storage, callback, 0, 0);
+  return ras_storage_flush_shared(storage, callback, 0, 0);
 }
 
 int
-ras_storage_close_shared(
+ras_storage_flush_shared(
   struct ras_storage_s *storage,
-  ras_storage_close_callback_t *callback,
+  ras_storage_flush_callback_t *callback,
   ras_request_callback_t *hook,
   void *shared
 ) {
@@ -245,25 +771,104 @@ ras_storage_close_shared(
       .callback = callback,
       .storage = storage,
       .shared = shared,
-      .after = ras_storage_close_emit,
       .hook = hook,
-      .type = RAS_REQUEST_CLOSE,
-      .data = 0,
+      .type = RAS_REQUEST_FLUSH,
     });
 
   require(request, EFAULT);
-  return queue_and_run(storage, request);
+  return run_request(storage, request);
 }
 
-static int
-ras_storage_read_before(
-  struct ras_request_s *request,
-  int err,
-  void *value,
-  unsigned long int size
+int
+ras_storage_sync(
+  struct ras_storage_s *storage,
+  ras_storage_sync_callback_t *callback
 ) {
-  request->data = ras_alloc(size);
-  memset(request->data, 0, size);
+  return ras_storage_sync_shared(storage, callback, 0, 0);
+}
+
+int
+ras_storage_sync_shared(
+  struct ras_storage_s *storage,
+  ras_storage_sync_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared
+) {
+  require(storage, EFAULT);
+
+  struct ras_request_s *request = ras_request_new(
+    (struct ras_request_options_s) {
+      .callback = callback,
+      .storage = storage,
+      .shared = shared,
+      .hook = hook,
+      .type = RAS_REQUEST_SYNC,
+    });
+
+  require(request, EFAULT);
+  return run_request(storage, request);
+}
+
+int
+ras_storage_close(
+  struct ras_storage_s *storage,
+  ras_storage_close_callback_t *callback
+) {
+  return ras_storage_close_shared(storage, callback, 0, 0);
+}
+
+int
+ras_storage_close_shared(
+  struct ras_storage_s *storage,
+  ras_storage_close_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared
+) {
+  require(storage, EFAULT);
+
+  struct ras_request_s *request = ras_request_new(
+    (struct ras_request_options_s) {
+      .callback = callback,
+      .storage = storage,
+      .shared = shared,
+      .after = ras_storage_close_emit,
+      .hook = hook,
+      .type = RAS_REQUEST_CLOSE,
+      .data = 0,
+    });
+
+  require(request, EFAULT);
+  return queue_and_run(storage, request);
+}
+
+/**
+ * Allocates and initializes a request with `options` and the priority,
+ * deadline, timeout and handle in `control`, if it is not `NULL`.
+ */
+static struct ras_request_s *
+ras_storage_request_new(
+  struct ras_request_options_s options,
+  const struct ras_request_control_s *control
+) {
+  if (0 != control) {
+    options.priority = control->priority;
+    options.deadline = control->deadline;
+    options.timeout = control->timeout;
+    options.handle = control->handle;
+  }
+
+  return ras_request_new(options);
+}
+
+static int
+ras_storage_read_before(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  request->data = ras_alloc(size);
+  memset(request->data, 0, size);
   return 0;
 }
 
@@ -281,10 +886,6 @@ ras_storage_read_after(
 
     ras_free(request->data);
     request->data = 0;
-
-    if (1 != request->pending) {
-      ras_request_free(request);
-    }
   }
   return 0;
 }
@@ -307,10 +908,30 @@ ras_storage_read_shared(
   ras_storage_read_callback_t *callback,
   ras_request_callback_t *hook,
   void *shared
+) {
+  return ras_storage_read_ex(
+    storage,
+    offset,
+    size,
+    callback,
+    hook,
+    shared,
+    0);
+}
+
+int
+ras_storage_read_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_read_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control
 ) {
   require(storage, EFAULT);
 
-  struct ras_request_s *request = ras_request_new(
+  struct ras_request_s *request = ras_storage_request_new(
     (struct ras_request_options_s) {
       .callback = callback,
       .storage = storage,
@@ -322,14 +943,15 @@ ras_storage_read_shared(
       .type = RAS_REQUEST_READ,
       .size = size,
       .data = 0,
-    });
+    },
+    control);
 
   require(request, EFAULT);
   return run_request(storage, request);
 }
 
 static int
-ras_storage_write_before(
+ras_storage_read_into_before(
   struct ras_request_s *request,
   int err,
   void *value,
@@ -339,124 +961,224 @@ ras_storage_write_before(
 }
 
 static int
-ras_storage_write_after(
+ras_storage_read_into_after(
   struct ras_request_s *request,
   int err,
   void *value,
   unsigned long int size
 ) {
-  if (0 != request && 1 != request->pending) {
-    ras_request_free(request);
+  if (0 != request) {
+    // `request->data` is owned by the caller
+    request->data = 0;
   }
   return 0;
 }
 
 int
-ras_storage_write(
+ras_storage_read_into(
   struct ras_storage_s *storage,
   unsigned long int offset,
   unsigned long int size,
-  const void *buffer,
-  ras_storage_write_callback_t *callback
+  void *buffer,
+  ras_storage_read_callback_t *callback
 ) {
-  return ras_storage_write_shared(storage, offset, size, buffer, callback, 0, 0);
+  return ras_storage_read_into_shared(
+    storage,
+    offset,
+    size,
+    buffer,
+    callback,
+    0,
+    0);
 }
 
 int
-ras_storage_write_shared(
+ras_storage_read_into_shared(
   struct ras_storage_s *storage,
   unsigned long int offset,
   unsigned long int size,
-  const void *buffer,
-  ras_storage_write_callback_t *callback,
+  void *buffer,
+  ras_storage_read_callback_t *callback,
   ras_request_callback_t *hook,
   void *shared
+) {
+  return ras_storage_read_into_ex(
+    storage,
+    offset,
+    size,
+    buffer,
+    callback,
+    hook,
+    shared,
+    0);
+}
+
+int
+ras_storage_read_into_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  void *buffer,
+  ras_storage_read_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control
 ) {
   require(storage, EFAULT);
+  require(buffer, EFAULT);
 
-  struct ras_request_s *request = ras_request_new(
+  struct ras_request_s *request = ras_storage_request_new(
     (struct ras_request_options_s) {
       .callback = callback,
       .storage = storage,
       .shared = shared,
       .offset = offset,
-      .before = ras_storage_write_before,
-      .after = ras_storage_write_after,
+      .before = ras_storage_read_into_before,
+      .after = ras_storage_read_into_after,
       .hook = hook,
-      .type = RAS_REQUEST_WRITE,
+      .type = RAS_REQUEST_READ,
       .size = size,
-      .data = (void *) buffer,
-    });
+      .data = buffer,
+    },
+    control);
 
   require(request, EFAULT);
   return run_request(storage, request);
 }
 
 static int
-ras_storage_stat_before(
+ras_storage_borrow_before(
   struct ras_request_s *request,
   int err,
   void *value,
   unsigned long int size
 ) {
-  request->size = sizeof(struct ras_storage_stats_s);
-  request->data = ras_alloc(sizeof(struct ras_storage_stats_s));
-  memset(request->data, 0, sizeof(struct ras_storage_stats_s));
+  // storage interfaces without `borrow()` lend a buffer read into by `read()`
+  if (0 == request->storage->options.borrow) {
+    request->data = ras_alloc(size);
+    memset(request->data, 0, size);
+  }
+
   return 0;
 }
 
 static int
-ras_storage_stat_after(
+ras_storage_borrow_after(
   struct ras_request_s *request,
   int err,
   void *value,
   unsigned long int size
 ) {
-  if (0 != request) {
+  // only called for failed requests, loans free their buffer when released
+  if (0 != request && 0 == request->storage->options.borrow) {
     ras_free(request->data);
-    request->data = 0;
+  }
 
-    if (1 != request->pending) {
-      ras_request_free(request);
-    }
+  if (0 != request) {
+    request->data = 0;
   }
+
   return 0;
 }
 
 int
-ras_storage_stat(
+ras_storage_read_borrow(
   struct ras_storage_s *storage,
-  ras_storage_stat_callback_t *callback
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_borrow_callback_t *callback
 ) {
-  return ras_storage_stat_shared(storage, callback, 0, 0);
+  return ras_storage_read_borrow_shared(
+    storage,
+    offset,
+    size,
+    callback,
+    0,
+    0);
 }
 
 int
-ras_storage_stat_shared(
+ras_storage_read_borrow_shared(
   struct ras_storage_s *storage,
-  ras_storage_stat_callback_t *callback,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_borrow_callback_t *callback,
   ras_request_callback_t *hook,
   void *shared
+) {
+  return ras_storage_read_borrow_ex(
+    storage,
+    offset,
+    size,
+    callback,
+    hook,
+    shared,
+    0);
+}
+
+int
+ras_storage_read_borrow_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_borrow_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control
 ) {
   require(storage, EFAULT);
+  require(callback, EINVAL);
 
-  struct ras_request_s *request = ras_request_new(
+  struct ras_request_s *request = ras_storage_request_new(
     (struct ras_request_options_s) {
       .callback = callback,
       .storage = storage,
       .shared = shared,
-      .before = ras_storage_stat_before,
-      .after = ras_storage_stat_after,
+      .offset = offset,
+      .before = ras_storage_borrow_before,
+      .after = ras_storage_borrow_after,
       .hook = hook,
-      .type = RAS_REQUEST_STAT,
-    });
+      .type = RAS_REQUEST_BORROW,
+      .size = size,
+    },
+    control);
 
   require(request, EFAULT);
   return run_request(storage, request);
 }
 
+int
+ras_storage_loan_release(struct ras_request_s *loan) {
+  struct ras_storage_s *storage = 0;
+
+  require(loan, EFAULT);
+  require(loan->storage, EINVAL);
+
+  storage = loan->storage;
+  ras_storage_lock(storage);
+
+  if (0 == loan->loaned) {
+    ras_storage_release(storage);
+    require(0, EINVAL);
+  }
+
+  ras_request_return(loan);
+
+  if (0 == storage->options.borrow) {
+    ras_free(loan->data);
+  }
+
+  loan->data = 0;
+  ras_request_free(loan);
+
+  // writes, deletes and barriers may be waiting on the loan
+  ras_storage_queue_drain(storage);
+  ras_storage_release(storage);
+  return 0;
+}
+
 static int
-ras_storage_delete_before(
+ras_storage_write_before(
   struct ras_request_s *request,
   int err,
   void *value,
@@ -466,100 +1188,1540 @@ ras_storage_delete_before(
 }
 
 static int
-ras_storage_delete_after(
+ras_storage_write_after(
   struct ras_request_s *request,
   int err,
   void *value,
   unsigned long int size
 ) {
-  if (0 != request && 1 != request->pending) {
-    ras_request_free(request);
-  }
   return 0;
 }
 
 int
-ras_storage_delete(
+ras_storage_write(
   struct ras_storage_s *storage,
   unsigned long int offset,
   unsigned long int size,
-  ras_storage_delete_callback_t *callback
+  const void *buffer,
+  ras_storage_write_callback_t *callback
 ) {
-  return ras_storage_delete_shared(storage, offset, size, callback, 0, 0);
+  return ras_storage_write_shared(storage, offset, size, buffer, callback, 0, 0);
 }
 
 int
-ras_storage_delete_shared(
+ras_storage_write_shared(
   struct ras_storage_s *storage,
   unsigned long int offset,
   unsigned long int size,
-  ras_storage_delete_callback_t *callback,
+  const void *buffer,
+  ras_storage_write_callback_t *callback,
   ras_request_callback_t *hook,
   void *shared
+) {
+  return ras_storage_write_ex(
+    storage,
+    offset,
+    size,
+    buffer,
+    callback,
+    hook,
+    shared,
+    0);
+}
+
+int
+ras_storage_write_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  const void *buffer,
+  ras_storage_write_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control
 ) {
   require(storage, EFAULT);
 
-  struct ras_request_s *request = ras_request_new(
+  struct ras_request_s *request = ras_storage_request_new(
     (struct ras_request_options_s) {
       .callback = callback,
       .storage = storage,
       .shared = shared,
       .offset = offset,
-      .before = ras_storage_delete_before,
-      .after = ras_storage_delete_after,
+      .before = ras_storage_write_before,
+      .after = ras_storage_write_after,
       .hook = hook,
-      .type = RAS_REQUEST_DELETE,
+      .type = RAS_REQUEST_WRITE,
       .size = size,
-    });
+      .data = (void *) buffer,
+    },
+    control);
 
   require(request, EFAULT);
   return run_request(storage, request);
 }
 
-struct ras_request_s *
-ras_storage_queue_shift(struct ras_storage_s *storage) {
-  struct ras_request_s *head = 0;
+static int
+ras_storage_vector_before(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  return 0;
+}
 
-  if (0 == storage) {
-    return 0;
-  }
+static int
+ras_storage_vector_after(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  return 0;
+}
 
-  if (storage->queued > 0) {
-    head = storage->queue[0];
-  }
+static int
+ras_storage_vector_request(
+  struct ras_storage_s *storage,
+  enum ras_request_type type,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  void *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control
+) {
+  unsigned long int start = 0;
+  unsigned long int end = 0;
 
-  // shift
-  for (int i = 0; i < storage->queued; ++i) {
-    storage->queue[i] = storage->queue[i + 1];
-  }
+  require(storage, EFAULT);
+  require(segments, EFAULT);
+  require(nsegments > 0, EINVAL);
+
+  // the request spans the range covered by every segment
+  start = segments[0].offset;
+  for (int i = 0; i < nsegments; ++i) {
+    if (segments[i].offset < start) {
+      start = segments[i].offset;
+    }
 
-  for (int i = storage->queued; i < RAS_STORAGE_MAX_REQUEST_QUEUE; ++i) {
-    storage->queue[i] = 0;
+    if (segments[i].offset + segments[i].size > end) {
+      end = segments[i].offset + segments[i].size;
+    }
   }
 
-  (void) --storage->queued;
-  if (storage->queued < 0) {
-    storage->queued = 0;
-  }
+  struct ras_request_s *request = ras_storage_request_new(
+    (struct ras_request_options_s) {
+      .callback = callback,
+      .storage = storage,
+      .shared = shared,
+      .offset = start,
+      .size = end - start,
+      .before = ras_storage_vector_before,
+      .after = ras_storage_vector_after,
+      .hook = hook,
+      .type = type,
+      .segments = segments,
+      .nsegments = nsegments,
+    },
+    control);
 
-  return head;
+  require(request, EFAULT);
+  return run_request(storage, request);
 }
 
 int
-ras_storage_queue_push(
+ras_storage_readv(
   struct ras_storage_s *storage,
-  struct ras_request_s *request
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_readv_callback_t *callback
 ) {
-  require(storage, EFAULT);
-  require(request, EFAULT);
-  require(storage == request->storage, EINVAL);
+  return ras_storage_readv_shared(storage, segments, nsegments, callback, 0, 0);
+}
 
-  if ((int) storage->queued < 0) {
-    storage->queued = 0;
-  }
+int
+ras_storage_readv_shared(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_readv_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared
+) {
+  return ras_storage_readv_ex(
+    storage,
+    segments,
+    nsegments,
+    callback,
+    hook,
+    shared,
+    0);
+}
 
-  // push
-  storage->queue[storage->queued++] = request;
+int
+ras_storage_readv_ex(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_readv_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control
+) {
+  return ras_storage_vector_request(
+    storage,
+    RAS_REQUEST_READV,
+    segments,
+    nsegments,
+    callback,
+    hook,
+    shared,
+    control);
+}
+
+int
+ras_storage_writev(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_writev_callback_t *callback
+) {
+  return ras_storage_writev_shared(
+    storage,
+    segments,
+    nsegments,
+    callback,
+    0,
+    0);
+}
+
+int
+ras_storage_writev_shared(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_writev_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared
+) {
+  return ras_storage_writev_ex(
+    storage,
+    segments,
+    nsegments,
+    callback,
+    hook,
+    shared,
+    0);
+}
+
+int
+ras_storage_writev_ex(
+  struct ras_storage_s *storage,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments,
+  ras_storage_writev_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control
+) {
+  return ras_storage_vector_request(
+    storage,
+    RAS_REQUEST_WRITEV,
+    segments,
+    nsegments,
+    callback,
+    hook,
+    shared,
+    control);
+}
+
+static int
+ras_storage_stat_before(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  request->size = sizeof(struct ras_storage_stats_s);
+  request->data = ras_alloc(sizeof(struct ras_storage_stats_s));
+  memset(request->data, 0, sizeof(struct ras_storage_stats_s));
+  return 0;
+}
+
+static int
+ras_storage_stat_after(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  if (0 != request) {
+    ras_free(request->data);
+    request->data = 0;
+  }
+  return 0;
+}
+
+int
+ras_storage_stat(
+  struct ras_storage_s *storage,
+  ras_storage_stat_callback_t *callback
+) {
+  return ras_storage_stat_shared(storage, callback, 0, 0);
+}
+
+int
+ras_storage_stat_shared(
+  struct ras_storage_s *storage,
+  ras_storage_stat_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared
+) {
+  require(storage, EFAULT);
+
+  struct ras_request_s *request = ras_request_new(
+    (struct ras_request_options_s) {
+      .callback = callback,
+      .storage = storage,
+      .shared = shared,
+      .before = ras_storage_stat_before,
+      .after = ras_storage_stat_after,
+      .hook = hook,
+      .type = RAS_REQUEST_STAT,
+    });
+
+  require(request, EFAULT);
+  return run_request(storage, request);
+}
+
+static int
+ras_storage_delete_before(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  return 0;
+}
+
+static int
+ras_storage_delete_after(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  return 0;
+}
+
+int
+ras_storage_delete(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_delete_callback_t *callback
+) {
+  return ras_storage_delete_shared(storage, offset, size, callback, 0, 0);
+}
+
+int
+ras_storage_delete_shared(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_delete_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared
+) {
+  return ras_storage_delete_ex(
+    storage,
+    offset,
+    size,
+    callback,
+    hook,
+    shared,
+    0);
+}
+
+int
+ras_storage_delete_ex(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  ras_storage_delete_callback_t *callback,
+  ras_request_callback_t *hook,
+  void *shared,
+  const struct ras_request_control_s *control
+) {
+  require(storage, EFAULT);
+
+  struct ras_request_s *request = ras_storage_request_new(
+    (struct ras_request_options_s) {
+      .callback = callback,
+      .storage = storage,
+      .shared = shared,
+      .offset = offset,
+      .before = ras_storage_delete_before,
+      .after = ras_storage_delete_after,
+      .hook = hook,
+      .type = RAS_REQUEST_DELETE,
+      .size = size,
+    },
+    control);
+
+  require(request, EFAULT);
+  return run_request(storage, request);
+}
+
+static struct ras_request_s *
+ras_storage_batch_request_new(
+  struct ras_storage_s *storage,
+  struct ras_request_options_s options
+) {
+  options.storage = storage;
+  options.emit = 0;
+
+  switch (options.type) {
+    case RAS_REQUEST_READ:
+      if (0 != options.data) {
+        options.before = ras_storage_read_into_before;
+        options.after = ras_storage_read_into_after;
+      } else {
+        options.before = ras_storage_read_before;
+        options.after = ras_storage_read_after;
+      }
+      break;
+
+    case RAS_REQUEST_WRITE:
+      options.before = ras_storage_write_before;
+      options.after = ras_storage_write_after;
+      break;
+
+    case RAS_REQUEST_DELETE:
+      options.before = ras_storage_delete_before;
+      options.after = ras_storage_delete_after;
+      break;
+
+    case RAS_REQUEST_STAT:
+      options.before = ras_storage_stat_before;
+      options.after = ras_storage_stat_after;
+      break;
+
+    case RAS_REQUEST_READV:
+    case RAS_REQUEST_WRITEV:
+      options.before = ras_storage_vector_before;
+      options.after = ras_storage_vector_after;
+      if (0 != options.segments && options.nsegments > 0) {
+        unsigned long int start = options.segments[0].offset;
+        unsigned long int end = 0;
+        for (int i = 0; i < options.nsegments; ++i) {
+          struct ras_request_segment_s *segment = &options.segments[i];
+          if (segment->offset < start) {
+            start = segment->offset;
+          }
+
+          if (segment->offset + segment->size > end) {
+            end = segment->offset + segment->size;
+          }
+        }
+
+        options.offset = start;
+        options.size = end - start;
+      }
+      break;
+
+    default:
+      return 0;
+  }
+
+  return ras_request_new(options);
+}
+
+int
+ras_storage_submit(
+  struct ras_storage_s *storage,
+  const struct ras_request_options_s *options,
+  unsigned long int count
+) {
+  struct ras_request_s **requests = 0;
+  struct ras_request_s *head = 0;
+  struct ras_request_s *tail = 0;
+  int rc = 0;
+
+  require(storage, EFAULT);
+  require(options, EFAULT);
+  require(count > 0, EINVAL);
+
+  // validate
+  for (int i = 0; i < count; ++i) {
+    require(options[i].priority < RAS_REQUEST_PRIORITIES, EINVAL);
+
+    switch (options[i].type) {
+      case RAS_REQUEST_READ:
+      case RAS_REQUEST_WRITE:
+      case RAS_REQUEST_DELETE:
+      case RAS_REQUEST_STAT:
+        break;
+
+      case RAS_REQUEST_READV:
+      case RAS_REQUEST_WRITEV:
+        require(options[i].segments, EFAULT);
+        require(options[i].nsegments > 0, EINVAL);
+        break;
+
+      default:
+        require(0, EINVAL);
+    }
+  }
+
+  if (ras_storage_concurrent(storage)) {
+    require(ras_storage_submission_reserve(storage, count), EAGAIN);
+  } else {
+    if (1 == storage->needs_open && 0 == storage->opened) {
+      require(
+        ras_storage_queue_length(storage) + count + 1 <=
+          storage->options.max_queued,
+        EAGAIN);
+    }
+
+    rc = open_if_needed(storage);
+    if (rc < 0) {
+      return rc;
+    }
+
+    require(
+      ras_storage_queue_length(storage) + count <= storage->options.max_queued,
+      EAGAIN);
+  }
+
+  // allocate, linked through `next` until submitted
+  for (int i = 0; i < count; ++i) {
+    struct ras_request_s *request = ras_storage_batch_request_new(
+      storage,
+      options[i]);
+
+    if (0 == request) {
+      while (0 != head) {
+        request = head;
+        head = head->next;
+        ras_request_free(request);
+      }
+
+      if (ras_storage_concurrent(storage)) {
+        __atomic_sub_fetch(&storage->submitted, count, __ATOMIC_ACQ_REL);
+      }
+
+      require(0, ENOMEM);
+    }
+
+    if (0 == head) {
+      head = request;
+    } else {
+      tail->next = request;
+    }
+
+    tail = request;
+  }
+
+  if (ras_storage_concurrent(storage)) {
+    while (0 != head) {
+      struct ras_request_s *request = head;
+      head = head->next;
+      ras_storage_submission_push(storage, request);
+    }
+
+    ras_storage_dispatch(storage);
+    return 0;
+  }
+
+  if (
+    0 != storage->options.submit_batch &&
+    0 == storage->options.thread_safe &&
+    0 == storage->draining &&
+    0 == storage->queued &&
+    0 == storage->barrier &&
+    1 == storage->opened &&
+    0 == storage->closed &&
+    ras_storage_inflight(storage) + count <= storage->options.max_inflight
+  ) {
+    requests = ras_alloc(count * sizeof(*requests));
+  }
+
+  // the batch runs at once, so it may not conflict with itself
+  // or with requests in flight
+  if (0 != requests) {
+    struct ras_request_s *request = head;
+    for (int i = 0; i < count && 0 != requests; ++i) {
+      requests[i] = request;
+      request = request->next;
+
+      if (ras_storage_request_hazard(storage, requests[i])) {
+        ras_free(requests);
+        requests = 0;
+        break;
+      }
+
+      for (int j = 0; j < i; ++j) {
+        if (ras_request_conflicts(requests[j], requests[i])) {
+          ras_free(requests);
+          requests = 0;
+          break;
+        }
+      }
+    }
+  }
+
+  if (0 == requests) {
+    while (0 != head) {
+      struct ras_request_s *request = head;
+      head = head->next;
+      request->next = 0;
+      ras_storage_queue_push(storage, request);
+    }
+
+    ras_storage_queue_drain(storage);
+    return 0;
+  }
+
+  for (int i = 0; i < count; ++i) {
+    struct ras_request_s *request = requests[i];
+    request->next = 0;
+
+    ras_request_begin(request);
+
+    if (0 != request->before) {
+      request->before(request, request->err, request->data, request->size);
+    }
+  }
+
+  memcpy(
+    &(storage->last_request),
+    requests[count - 1],
+    sizeof(struct ras_request_s));
+
+  storage->last_request.done = 0;
+  storage->last_request.after = 0;
+  storage->last_request.before = 0;
+  storage->last_request.callback = 0;
+
+  storage->options.submit_batch(storage, requests, count);
+  ras_free(requests);
+  return 0;
+}
+
+/**
+ * Returns `1` if `request` may be dispatched out of queue order for its
+ * priority class or deadline.
+ */
+static int
+ras_storage_request_prioritized(const struct ras_request_s *request) {
+  return RAS_REQUEST_PRIORITY_NORMAL != request->priority
+    || 0 != request->deadline;
+}
+
+/**
+ * Returns the rank `request` is dispatched by at `now`, lower first. A
+ * request past its deadline ranks before every class and a request ranks
+ * one class higher for every `priority_aging` microseconds it waited.
+ */
+static unsigned long int
+ras_storage_request_rank(
+  const struct ras_storage_s *storage,
+  const struct ras_request_s *request,
+  unsigned long int now
+) {
+  static const unsigned long int ranks[RAS_REQUEST_PRIORITIES] = {
+    [RAS_REQUEST_PRIORITY_HIGH] = 1,
+    [RAS_REQUEST_PRIORITY_NORMAL] = 2,
+    [RAS_REQUEST_PRIORITY_LOW] = 3,
+  };
+
+  const unsigned long int rank = ranks[request->priority];
+  unsigned long int aged = 0;
+
+  if (0 != request->deadline && now >= request->deadline) {
+    return 0;
+  }
+
+  if (now > request->queued_at) {
+    aged = now - request->queued_at;
+    aged /= storage->options.priority_aging * 1000UL;
+  }
+
+  return rank > aged + 1 ? rank - aged : 1;
+}
+
+/**
+ * Returns the distance an elevator sweeping up from the position of the
+ * storage travels to `request`, wrapping around to the lowest offset.
+ * Requests that are not positional are on the way.
+ */
+static unsigned long int
+ras_storage_request_seek(
+  const struct ras_storage_s *storage,
+  const struct ras_request_s *request
+) {
+  if (0 == ras_request_positional(request)) {
+    return 0;
+  }
+
+  // unsigned subtraction wraps offsets behind the position to the end
+  return request->offset - storage->position;
+}
+
+/**
+ * Returns `1` if `request` is dispatched at `now` before `other`, which was
+ * queued before it. Within a rank, requests with the earliest deadline go
+ * first, then the nearest ahead of the position of the storage for
+ * `RAS_STORAGE_SCHEDULE_CSCAN`.
+ */
+static int
+ras_storage_request_precedes(
+  const struct ras_storage_s *storage,
+  const struct ras_request_s *request,
+  const struct ras_request_s *other,
+  unsigned long int now
+) {
+  const unsigned long int rank =
+    ras_storage_request_rank(storage, request, now);
+
+  const unsigned long int other_rank =
+    ras_storage_request_rank(storage, other, now);
+
+  if (rank != other_rank) {
+    return rank < other_rank;
+  }
+
+  if (request->deadline != other->deadline) {
+    return 0 != request->deadline
+      && (0 == other->deadline || request->deadline < other->deadline);
+  }
+
+  if (RAS_STORAGE_SCHEDULE_CSCAN == storage->options.schedule) {
+    return ras_storage_request_seek(storage, request)
+      < ras_storage_request_seek(storage, other);
+  }
+
+  return 0;
+}
+
+/**
+ * Records the time `request` waited in the queue in the counters of the
+ * priority class it was made with.
+ */
+static void
+ras_storage_request_waited(
+  struct ras_storage_s *storage,
+  const struct ras_request_s *request
+) {
+  const unsigned long int now = ras_clock_now();
+  const enum ras_request_priority priority = request->priority;
+  unsigned long int wait = 0;
+  unsigned int bucket = 0;
+
+  if (now > request->queued_at) {
+    wait = now - request->queued_at;
+  }
+
+  if (wait > 1) {
+    bucket = 8 * sizeof(wait) - 1 - __builtin_clzl(wait);
+  }
+
+  if (bucket >= RAS_STORAGE_QUEUE_WAIT_BUCKETS) {
+    bucket = RAS_STORAGE_QUEUE_WAIT_BUCKETS - 1;
+  }
+
+  if (0 != request->deadline && now > request->deadline) {
+    storage->counters.deadline_misses++;
+  }
+
+  storage->counters.queue_waits[priority]++;
+  storage->counters.queue_wait[priority] += wait;
+  storage->counters.queue_wait_histogram[priority][bucket]++;
+
+  if (wait > storage->counters.queue_wait_max[priority]) {
+    storage->counters.queue_wait_max[priority] = wait;
+  }
+}
+
+void
+ras_storage_queue_cancel(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request
+) {
+  storage->queue[request->slot] = 0;
+  storage->tombstones++;
+  request->queued = 0;
+
+  if (ras_storage_request_prioritized(request)) {
+    storage->prioritized--;
+  }
+
+  // empty slots at the head are dropped, the drain skips the others
+  while (storage->queued > 0 && 0 == ras_storage_queue_at(storage, 0)) {
+    ras_storage_queue_shift(storage);
+  }
+}
+
+/**
+ * Times out the requests whose timeout passed, see `ras_storage_expire()`.
+ * Returns the number of requests that timed out.
+ */
+static int
+ras_storage_time_out(struct ras_storage_s *storage) {
+  struct ras_request_s *expired = 0;
+  struct ras_request_s *inflight = 0;
+  unsigned long int next = 0;
+  unsigned long int now = 0;
+  int count = 0;
+
+  if (0 == storage->next_expiry) {
+    return 0;
+  }
+
+  now = ras_clock_now();
+
+  if (now < storage->next_expiry) {
+    return 0;
+  }
+
+  // removed from the queue first, linked through `inflight_next`
+  // until they run, as their callbacks may queue requests
+  for (unsigned int i = 0; i < storage->queued; ++i) {
+    struct ras_request_s *queued = ras_storage_queue_at(storage, i);
+
+    if (0 == queued || 0 == queued->expires || 0 != queued->canceled) {
+      continue;
+    }
+
+    if (now < queued->expires) {
+      if (0 == next || queued->expires < next) {
+        next = queued->expires;
+      }
+
+      continue;
+    }
+
+    storage->queue[queued->slot] = 0;
+    storage->tombstones++;
+    queued->queued = 0;
+    queued->inflight_next = expired;
+    expired = queued;
+
+    if (ras_storage_request_prioritized(queued)) {
+      storage->prioritized--;
+    }
+  }
+
+  while (storage->queued > 0 && 0 == ras_storage_queue_at(storage, 0)) {
+    ras_storage_queue_shift(storage);
+  }
+
+  // `cancel()` may complete requests and change the requests in flight
+  inflight = storage->inflight;
+  while (0 != inflight) {
+    if (
+      0 == inflight->expires ||
+      0 != inflight->canceled ||
+      0 == storage->options.cancel
+    ) {
+      inflight = inflight->inflight_next;
+    } else if (now < inflight->expires) {
+      if (0 == next || inflight->expires < next) {
+        next = inflight->expires;
+      }
+
+      inflight = inflight->inflight_next;
+    } else {
+      ras_request_abort(inflight, ETIMEDOUT);
+      inflight = storage->inflight;
+      count++;
+    }
+  }
+
+  storage->next_expiry = next;
+
+  while (0 != expired) {
+    struct ras_request_s *request = expired;
+    expired = request->inflight_next;
+    request->inflight_next = 0;
+    request->canceled = ETIMEDOUT;
+    request->err = ETIMEDOUT;
+    storage->counters.timeouts++;
+    ras_request_run(request);
+    count++;
+  }
+
+  return count;
+}
+
+/**
+ * Removes the request at `index` from the queue to run it.
+ */
+static struct ras_request_s *
+ras_storage_queue_take(struct ras_storage_s *storage, unsigned int index) {
+  struct ras_request_s *request = ras_storage_queue_remove(storage, index);
+
+  if (0 != request) {
+    ras_storage_request_waited(storage, request);
+  }
+
+  return request;
+}
+
+static int
+ras_storage_queue_grow(struct ras_storage_s *storage) {
+  unsigned int size = storage->queue_size > 0
+    ? storage->queue_size * 2
+    : RAS_STORAGE_MIN_REQUEST_QUEUE;
+
+  struct ras_request_s **queue = ras_alloc(size * sizeof(*queue));
+
+  require(queue, ENOMEM);
+  memset(queue, 0, size * sizeof(*queue));
+
+  // linearize so the head starts at index 0
+  for (int i = 0; i < storage->queued; ++i) {
+    queue[i] = ras_storage_queue_at(storage, i);
+
+    if (0 != queue[i]) {
+      queue[i]->slot = i;
+    }
+  }
+
+  ras_free(storage->queue);
+  storage->queue = queue;
+  storage->queue_size = size;
+  storage->queue_head = 0;
+  return 0;
+}
+
+struct ras_request_s *
+ras_storage_queue_shift(struct ras_storage_s *storage) {
+  struct ras_request_s *head = 0;
+
+  if (0 == storage || 0 == storage->queued) {
+    return 0;
+  }
+
+  // advance head
+  head = storage->queue[storage->queue_head];
+  storage->queue[storage->queue_head] = 0;
+  storage->queue_head = (storage->queue_head + 1) & (storage->queue_size - 1);
+
+  if (0 != head) {
+    head->queued = 0;
+  } else if (storage->tombstones > 0) {
+    storage->tombstones--;
+  }
+
+  if (0 == --storage->queued) {
+    storage->queue_head = 0;
+
+    if (1 == storage->saturated) {
+      storage->saturated = 0;
+      ras_emitter_emit(&storage->emitter, RAS_EVENT_DRAIN, 0);
+    }
+  }
+
+  return head;
+}
+
+int
+ras_storage_queue_push(
+  struct ras_storage_s *storage,
+  struct ras_request_s *request
+) {
+  require(storage, EFAULT);
+  require(request, EFAULT);
+  require(storage == request->storage, EINVAL);
+
+  unsigned int tail = 0;
+
+  if ((int) storage->queued < 0) {
+    storage->queued = 0;
+  }
+
+  require(
+    ras_storage_queue_length(storage) < storage->options.max_queued,
+    EAGAIN);
+
+  if (storage->queued == storage->queue_size) {
+    int rc = ras_storage_queue_grow(storage);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  // push
+  tail = (storage->queue_head + storage->queued) & (storage->queue_size - 1);
+  storage->queue[tail] = request;
+  storage->queued++;
+  request->slot = tail;
+  request->queued = 1;
   request->pending = 1;
+  request->queued_at = ras_clock_now();
+
+  if (0 != request->expires && (
+    0 == storage->next_expiry || request->expires < storage->next_expiry
+  )) {
+    storage->next_expiry = request->expires;
+  }
+
+  if (ras_storage_request_prioritized(request)) {
+    storage->prioritized++;
+  }
+
+  if (ras_storage_queue_length(storage) == storage->options.max_queued) {
+    storage->saturated = 1;
+    ras_emitter_emit(&storage->emitter, RAS_EVENT_FULL, 0);
+  }
+
   return storage->queued;
 }
+
+/**
+ * Returns `1` if `request` is a read without a buffer of its own, such as
+ * one made with `ras_storage_read()` before it runs, that is given a slice
+ * of the buffer of the read it is merged into instead of allocating one.
+ */
+static int
+ras_storage_coalesced_slice(struct ras_request_s *request) {
+  return RAS_REQUEST_READ == request->type && 0 == request->data;
+}
+
+/**
+ * Completes the requests merged into `request` by `ras_storage_coalesce()`
+ * in queue order with the result of its read or write. Merged reads are
+ * given the slice of the result in their range.
+ */
+static int
+ras_storage_coalesced_after(
+  struct ras_request_s *request,
+  int err,
+  void *value,
+  unsigned long int size
+) {
+  struct ras_storage_s *storage = request->storage;
+  struct ras_request_s *merged = request->next;
+
+  request->next = 0;
+
+  while (0 != merged) {
+    struct ras_request_s *next = merged->next;
+    const unsigned long int rel = merged->offset - request->offset;
+    const int slice = ras_storage_coalesced_slice(merged);
+    unsigned long int transferred = 0 == err ? merged->size : 0;
+    unsigned char *data = 0;
+
+    if (RAS_REQUEST_READ == merged->type) {
+      transferred = 0;
+
+      // reads may be short at the end of the storage
+      if (0 == err && 0 != value && size > rel) {
+        transferred = size - rel;
+        data = (unsigned char *) value + rel;
+      }
+
+      if (transferred > merged->size) {
+        transferred = merged->size;
+      }
+
+      if (0 == slice && transferred > 0) {
+        memcpy(merged->data, data, transferred);
+      }
+
+      if (0 == slice) {
+        data = merged->data;
+      }
+    }
+
+    merged->next = 0;
+    merged->pending = 0;
+    merged->err = err;
+
+    if (0 != merged->hook) {
+      merged->hook(merged, err, data, transferred);
+    }
+
+    if (0 != merged->done && RAS_REQUEST_READ == merged->type) {
+      ((ras_storage_read_callback_t *) merged->done)(
+        storage,
+        err,
+        data,
+        transferred);
+    } else if (0 != merged->done) {
+      ((ras_storage_write_callback_t *) merged->done)(storage, err);
+    }
+
+    // a slice is not a buffer of its own to free
+    if (0 != merged->after && 0 == slice) {
+      merged->after(merged, err, data, transferred);
+    }
+
+    ras_request_free(merged);
+    merged = next;
+  }
+
+  // a buffer of the storage's own that every merged read was served from
+  if (0 != value && value != request->data) {
+    ras_free(value);
+  }
+
+  ras_free(request->data);
+  request->data = 0;
+  return 0;
+}
+
+/**
+ * Removes the request at `index` from the queue and returns it, merged with
+ * the requests of the same type queued after it that touch or overlap its
+ * range if it is a read or a write. A request is only merged if it does
+ * not conflict with the requests it would overtake, the `blocked` requests
+ * queued before `index` included, or with a request in flight.
+ */
+static struct ras_request_s *
+ras_storage_coalesce(
+  struct ras_storage_s *storage,
+  unsigned int index,
+  struct ras_request_s **blocked,
+  unsigned int nblocked
+) {
+  struct ras_request_s *skipped[RAS_STORAGE_QUEUE_LOOKAHEAD];
+  struct ras_request_s *merged[RAS_STORAGE_QUEUE_LOOKAHEAD];
+  unsigned int indices[RAS_STORAGE_QUEUE_LOOKAHEAD];
+  struct ras_request_s *request = ras_storage_queue_at(storage, index);
+  struct ras_request_s *coalesced = 0;
+  const enum ras_request_type type = request->type;
+  unsigned char *buffer = 0;
+  unsigned long int start = request->offset;
+  unsigned long int end = request->offset + request->size;
+  unsigned long int bytes = 0;
+  unsigned int nskipped = nblocked;
+  unsigned int nmerged = 1;
+  unsigned int lookahead = storage->queued;
+
+  if (lookahead > RAS_STORAGE_QUEUE_LOOKAHEAD) {
+    lookahead = RAS_STORAGE_QUEUE_LOOKAHEAD;
+  }
+
+  if (
+    (RAS_REQUEST_WRITE != type && RAS_REQUEST_READ != type) ||
+    0 != request->err ||
+    0 == request->size ||
+    end < start ||
+    ras_readahead_owns(request)
+  ) {
+    return ras_storage_queue_take(storage, index);
+  }
+
+  merged[0] = request;
+  indices[0] = index;
+  memcpy(skipped, blocked, nblocked * sizeof(*blocked));
+
+  for (unsigned int i = index + 1; i < lookahead; ++i) {
+    struct ras_request_s *queued = ras_storage_queue_at(storage, i);
+    unsigned long int first = start;
+    unsigned long int last = end;
+    int hazard = 0;
+
+    if (0 == queued) {
+      continue;
+    }
+
+    if (ras_request_is_barrier(queued->type)) {
+      break;
+    }
+
+    if (queued->offset < first) {
+      first = queued->offset;
+    }
+
+    if (queued->offset + queued->size > last) {
+      last = queued->offset + queued->size;
+    }
+
+    // only requests that touch or overlap the range so far are merged
+    if (
+      type != queued->type ||
+      0 != queued->err ||
+      0 == queued->size ||
+      queued->offset + queued->size < queued->offset ||
+      queued->offset > end ||
+      queued->offset + queued->size < start ||
+      last - first > RAS_STORAGE_MAX_COALESCE ||
+      ras_readahead_owns(queued)
+    ) {
+      hazard = 1;
+    }
+
+    for (unsigned int j = 0; j < nskipped && 0 == hazard; ++j) {
+      hazard = ras_request_conflicts(skipped[j], queued);
+    }
+
+    if (0 == hazard) {
+      hazard = ras_storage_request_hazard(storage, queued);
+    }
+
+    if (0 != hazard) {
+      skipped[nskipped++] = queued;
+      continue;
+    }
+
+    merged[nmerged] = queued;
+    indices[nmerged++] = i;
+    bytes += queued->size;
+    start = first;
+    end = last;
+  }
+
+  if (nmerged > 1) {
+    buffer = ras_alloc(end - start);
+  }
+
+  if (0 != buffer) {
+    coalesced = ras_request_new(
+      (struct ras_request_options_s) {
+        .type = type,
+        .storage = storage,
+        .shared = merged[0]->shared,
+        .after = ras_storage_coalesced_after,
+        .offset = start,
+        .size = end - start,
+        .data = buffer,
+      });
+  }
+
+  if (0 == coalesced) {
+    ras_free(buffer);
+    return ras_storage_queue_take(storage, index);
+  }
+
+  for (unsigned int i = 0; i < nmerged; ++i) {
+    request = merged[i];
+
+    // later writes win where writes overlap
+    if (RAS_REQUEST_WRITE == type) {
+      memcpy(buffer + (request->offset - start), request->data, request->size);
+    }
+
+    // reads given a slice skip allocating a buffer of their own
+    if (0 != request->before && 0 == ras_storage_coalesced_slice(request)) {
+      request->before(request, request->err, request->data, request->size);
+    }
+
+    request->next = i + 1 < nmerged ? merged[i + 1] : 0;
+  }
+
+  // removing from the back keeps the indices in front valid
+  for (unsigned int i = nmerged; i > 0; --i) {
+    ras_storage_queue_take(storage, indices[i - 1]);
+  }
+
+  coalesced->next = merged[0];
+
+  if (RAS_REQUEST_WRITE == type) {
+    storage->counters.coalesced_writes += nmerged - 1;
+  } else {
+    storage->counters.coalesced_reads += nmerged - 1;
+  }
+
+  storage->counters.coalesced_bytes += bytes;
+  return coalesced;
+}
+
+int
+ras_storage_queue_drain(struct ras_storage_s *storage) {
+  require(storage, EFAULT);
+  int count = 0;
+
+  // the outermost drain runs requests that become ready
+  // while requests complete synchronously in `ras_request_run()`
+  if (storage->draining > 0) {
+    return 0;
+  }
+
+  storage->draining++;
+  ras_storage_time_out(storage);
+
+  while (storage->queued > 0) {
+    struct ras_request_s *blocked[RAS_STORAGE_QUEUE_LOOKAHEAD];
+    struct ras_request_s *request = 0;
+    struct ras_request_s *first = 0;
+    unsigned long int now = 0;
+    unsigned int nblocked = 0;
+    unsigned int nbefore = 0;
+    unsigned int picked = 0;
+    unsigned int index = 0;
+
+    // requests only run out of queue order for a priority or a schedule
+    const int ordered = storage->prioritized > 0
+      || RAS_STORAGE_SCHEDULE_FIFO != storage->options.schedule;
+
+    if (0 == ras_storage_queue_at(storage, 0)) {
+      ras_storage_queue_shift(storage);
+      continue;
+    }
+
+    if (ordered) {
+      now = ras_clock_now();
+    }
+
+    // find the first request that does not conflict with a request in
+    // flight or with a request queued before it that must wait
+    for (; index < storage->queued; ++index) {
+      struct ras_request_s *queued = ras_storage_queue_at(storage, index);
+
+      if (index == RAS_STORAGE_QUEUE_LOOKAHEAD) {
+        break;
+      }
+
+      int hazard = 0;
+
+      if (0 == queued) {
+        continue;
+      }
+
+      if (ras_request_is_barrier(queued->type)) {
+        if (0 == nblocked && ras_storage_request_ready(storage, queued)) {
+          request = queued;
+          picked = index;
+        }
+        break;
+      }
+
+      if (0 == ras_storage_request_slot(storage)) {
+        break;
+      }
+
+      for (int i = 0; i < nblocked && 0 == hazard; ++i) {
+        hazard = ras_request_conflicts(blocked[i], queued);
+      }
+
+      if (0 == hazard && ras_storage_request_ready(storage, queued)) {
+        if (0 == first) {
+          first = queued;
+        }
+
+        if (0 == request || (
+          ordered &&
+          ras_storage_request_precedes(storage, queued, request, now)
+        )) {
+          request = queued;
+          picked = index;
+          nbefore = nblocked;
+        }
+
+        if (0 == ordered) {
+          break;
+        }
+
+        // requests queued after it may not overtake it if they conflict
+        blocked[nblocked++] = queued;
+        continue;
+      }
+
+      ras_storage_request_stall(storage, queued);
+      blocked[nblocked++] = queued;
+    }
+
+    if (0 == request) {
+      break;
+    }
+
+    if (request != first && 0 != first) {
+      storage->counters.reordered++;
+    }
+
+    request = ras_storage_coalesce(storage, picked, blocked, nbefore);
+    (void) count++;
+
+    // the storage may not outlive a destroy request
+    if (RAS_REQUEST_DESTROY == request->type) {
+      storage->draining--;
+      ras_request_run(request);
+      return count;
+    }
+
+    ras_request_run(request);
+  }
+
+  storage->draining--;
+
+  // the sync requests dispatched together share one sync
+  ras_request_sync_start(storage);
+  return count;
+}
+
+struct ras_request_s *
+ras_storage_queue_at(struct ras_storage_s *storage, unsigned int index) {
+  if (0 == storage || index >= storage->queued) {
+    return 0;
+  }
+
+  index = (storage->queue_head + index) & (storage->queue_size - 1);
+  return storage->queue[index];
+}
+
+struct ras_request_s *
+ras_storage_queue_remove(struct ras_storage_s *storage, unsigned int index) {
+  struct ras_request_s *request = 0;
+  unsigned int mask = 0;
+
+  if (0 == storage || index >= storage->queued) {
+    return 0;
+  }
+
+  if (0 == index) {
+    request = ras_storage_queue_shift(storage);
+  } else {
+    mask = storage->queue_size - 1;
+    request = storage->queue[(storage->queue_head + index) & mask];
+
+    // close the gap by moving the requests before it back by one
+    for (unsigned int i = index; i > 0; --i) {
+      const unsigned int slot = (storage->queue_head + i) & mask;
+      const unsigned int prev = (storage->queue_head + i - 1) & mask;
+      storage->queue[slot] = storage->queue[prev];
+
+      if (0 != storage->queue[slot]) {
+        storage->queue[slot]->slot = slot;
+      }
+    }
+
+    // the request, or the empty slot of a canceled one, leaves at the head
+    storage->queue[storage->queue_head] = request;
+    ras_storage_queue_shift(storage);
+  }
+
+  if (0 != request && ras_storage_request_prioritized(request)) {
+    storage->prioritized--;
+  }
+
+  return request;
+}
+
+int
+ras_storage_expire(struct ras_storage_s *storage) {
+  require(storage, EFAULT);
+
+  const unsigned int thread_safe = storage->options.thread_safe;
+  int count = 0;
+
+  ras_storage_lock(storage);
+
+  // a destroy made by the callback of a request that timed out is
+  // queued and runs once every request that timed out has run
+  storage->draining++;
+  count = ras_storage_time_out(storage);
+  storage->draining--;
+  ras_storage_queue_drain(storage);
+
+  if (0 != thread_safe) {
+    ras_storage_release(storage);
+  }
+
+  return count;
+}
+
+int
+ras_storage_cancel(
+  struct ras_storage_s *storage,
+  struct ras_request_s **handle
+) {
+  require(storage, EFAULT);
+  require(handle, EFAULT);
+
+  const unsigned int thread_safe = storage->options.thread_safe;
+  struct ras_request_s *request = 0;
+  int rc = 0;
+
+  // the request is not freed or reused while the lock is held
+  ras_storage_lock(storage);
+  request = __atomic_load_n(handle, __ATOMIC_ACQUIRE);
+
+  if (0 == request) {
+    rc = -EALREADY;
+  } else if (storage != request->storage) {
+    rc = -EINVAL;
+  } else if (ras_request_is_barrier(request->type)) {
+    rc = -EINVAL;
+  } else {
+    // the callback of a queued request may destroy the storage
+    rc = ras_request_abort(request, ECANCELED);
+  }
+
+  if (0 != thread_safe) {
+    ras_storage_release(storage);
+  }
+
+  if (rc < 0) {
+    errno = -rc;
+  }
+
+  return rc;
+}
+
+struct ras_storage_counters_s
+ras_storage_counters(const struct ras_storage_s *storage) {
+  struct ras_storage_counters_s counters = { 0 };
+
+  if (0 != storage) {
+    counters = storage->counters;
+  }
+
+  return counters;
+}
+
+unsigned long int
+ras_storage_queue_wait_percentile(
+  const struct ras_storage_s *storage,
+  enum ras_request_priority priority,
+  unsigned int percentile
+) {
+  const unsigned long int *histogram = 0;
+  unsigned long int target = 0;
+  unsigned long int seen = 0;
+  unsigned long int waits = 0;
+  unsigned long int max = 0;
+
+  if (0 == storage || priority >= RAS_REQUEST_PRIORITIES) {
+    return 0;
+  }
+
+  histogram = storage->counters.queue_wait_histogram[priority];
+  waits = storage->counters.queue_waits[priority];
+  max = storage->counters.queue_wait_max[priority];
+
+  if (0 == waits) {
+    return 0;
+  }
+
+  if (percentile > 100) {
+    percentile = 100;
+  }
+
+  // the rank of the percentile, rounded up
+  target = (waits * percentile + 99) / 100;
+
+  if (0 == target) {
+    target = 1;
+  }
+
+  for (unsigned int i = 0; i < RAS_STORAGE_QUEUE_WAIT_BUCKETS; ++i) {
+    seen += histogram[i];
+
+    if (seen >= target) {
+      // the upper bound of the bucket, or the longest wait if it is less
+      if (i + 1 < 8 * sizeof(max) && (1UL << (i + 1)) < max) {
+        return 1UL << (i + 1);
+      }
+
+      return max;
+    }
+  }
+
+  return max;
+}
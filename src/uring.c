@@ -0,0 +1,974 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "ras/allocator.h"
+#include "ras/emitter.h"
+#include "ras/executor.h"
+#include "ras/storage.h"
+#include "ras/uring.h"
+#include "require.h"
+#include "io.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+
+// the largest transfer a single read or write operation is given
+#define RAS_URING_MAX_TRANSFER 0x7ffff000
+
+/**
+ * Represents a request in flight on the io_uring. The address of the
+ * operation is the `user_data` of its submission queue entries.
+ */
+struct ras_uring_op_s {
+  struct ras_request_s *request;
+  struct ras_uring_op_s *next;
+  unsigned long int done;
+  struct statx statx;
+};
+
+/**
+ * Represents the submission and completion queues shared with the kernel
+ * and the pool of operations that may be in flight on them.
+ */
+struct ras_uring_s {
+  int fd;
+  unsigned int entries;
+  unsigned int nops;
+  unsigned int unsubmitted;
+  unsigned int polling:1;
+  unsigned int fixed_file:1;
+  unsigned int fixed_buffers:1;
+  unsigned int *sq_head;
+  unsigned int *sq_tail;
+  unsigned int *sq_mask;
+  unsigned int *sq_array;
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq_map;
+  void *cq_map;
+  unsigned long int sq_map_size;
+  unsigned long int cq_map_size;
+  unsigned long int sqes_size;
+  struct ras_uring_op_s *ops;
+  struct ras_uring_op_s *free;
+  struct ras_request_s *destroy;
+};
+
+static int
+ras_uring_setup(unsigned int entries, struct io_uring_params *params) {
+  return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int
+ras_uring_register(
+  int fd,
+  unsigned int opcode,
+  const void *arg,
+  unsigned int nargs
+) {
+  return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+}
+
+/**
+ * Returns `1` if the io_uring at `fd` supports every operation the storage
+ * submits, otherwise `0`.
+ */
+static int
+ras_uring_probe(int fd) {
+  static const unsigned char required[] = {
+    IORING_OP_OPENAT,
+    IORING_OP_READ,
+    IORING_OP_WRITE,
+    IORING_OP_READ_FIXED,
+    IORING_OP_WRITE_FIXED,
+    IORING_OP_FALLOCATE,
+    IORING_OP_STATX,
+    IORING_OP_CLOSE,
+    IORING_OP_FSYNC,
+    IORING_OP_ASYNC_CANCEL,
+  };
+
+  const unsigned long int size =
+    sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+
+  struct io_uring_probe *probe = ras_alloc(size);
+  int supported = 0;
+
+  if (0 == probe) {
+    return 0;
+  }
+
+  memset(probe, 0, size);
+
+  if (0 == ras_uring_register(fd, IORING_REGISTER_PROBE, probe, 256)) {
+    supported = 1;
+    for (int i = 0; i < sizeof(required); ++i) {
+      const unsigned char op = required[i];
+      if (op > probe->last_op) {
+        supported = 0;
+      } else if (0 == (probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+        supported = 0;
+      }
+    }
+  }
+
+  ras_free(probe);
+  return supported;
+}
+
+static void
+ras_uring_ring_free(struct ras_uring_s *ring) {
+  if (0 == ring) {
+    return;
+  }
+
+  if (0 != ring->sqes) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+
+  if (0 != ring->cq_map && ring->cq_map != ring->sq_map) {
+    munmap(ring->cq_map, ring->cq_map_size);
+  }
+
+  if (0 != ring->sq_map) {
+    munmap(ring->sq_map, ring->sq_map_size);
+  }
+
+  if (ring->fd >= 0) {
+    close(ring->fd);
+  }
+
+  ras_free(ring->ops);
+  ras_free(ring);
+}
+
+static void *
+ras_uring_map(int fd, unsigned long int size, unsigned long int offset) {
+  void *map = mmap(
+    0,
+    size,
+    PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_POPULATE,
+    fd,
+    offset);
+
+  return MAP_FAILED == map ? 0 : map;
+}
+
+/**
+ * Sets up an io_uring with at least `options->entries` submission queue
+ * entries. Returns `NULL` if io_uring is not available.
+ */
+static struct ras_uring_s *
+ras_uring_ring_new(const struct ras_uring_storage_options_s *options) {
+  struct io_uring_params params;
+  struct ras_uring_s *ring = 0;
+  int fd = 0;
+
+  memset(&params, 0, sizeof(params));
+  fd = ras_uring_setup(options->entries, &params);
+
+  if (fd < 0) {
+    return 0;
+  }
+
+  if (0 == ras_uring_probe(fd)) {
+    close(fd);
+    return 0;
+  }
+
+  ring = ras_alloc(sizeof(struct ras_uring_s));
+
+  if (0 == ring) {
+    close(fd);
+    return 0;
+  }
+
+  memset(ring, 0, sizeof(struct ras_uring_s));
+  ring->fd = fd;
+  ring->entries = params.sq_entries;
+  ring->sq_map_size =
+    params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  ring->cq_map_size =
+    params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  // both queues share one mapping when the kernel supports it
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_map_size > ring->sq_map_size) {
+      ring->sq_map_size = ring->cq_map_size;
+    }
+
+    ring->cq_map_size = ring->sq_map_size;
+  }
+
+  ring->sq_map = ras_uring_map(fd, ring->sq_map_size, IORING_OFF_SQ_RING);
+  if (0 == ring->sq_map) {
+    goto error;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_map = ring->sq_map;
+  } else {
+    ring->cq_map = ras_uring_map(fd, ring->cq_map_size, IORING_OFF_CQ_RING);
+    if (0 == ring->cq_map) {
+      goto error;
+    }
+  }
+
+  ring->sqes = ras_uring_map(fd, ring->sqes_size, IORING_OFF_SQES);
+  if (0 == ring->sqes) {
+    goto error;
+  }
+
+  ring->sq_head = (unsigned int *) ((char *) ring->sq_map + params.sq_off.head);
+  ring->sq_tail = (unsigned int *) ((char *) ring->sq_map + params.sq_off.tail);
+  ring->sq_mask =
+    (unsigned int *) ((char *) ring->sq_map + params.sq_off.ring_mask);
+  ring->sq_array =
+    (unsigned int *) ((char *) ring->sq_map + params.sq_off.array);
+  ring->cq_head = (unsigned int *) ((char *) ring->cq_map + params.cq_off.head);
+  ring->cq_tail = (unsigned int *) ((char *) ring->cq_map + params.cq_off.tail);
+  ring->cq_mask =
+    (unsigned int *) ((char *) ring->cq_map + params.cq_off.ring_mask);
+  ring->cqes =
+    (struct io_uring_cqe *) ((char *) ring->cq_map + params.cq_off.cqes);
+
+  // every completion queue entry has an operation to complete
+  ring->ops = ras_alloc(params.cq_entries * sizeof(struct ras_uring_op_s));
+  if (0 == ring->ops) {
+    goto error;
+  }
+
+  memset(ring->ops, 0, params.cq_entries * sizeof(struct ras_uring_op_s));
+  ring->nops = params.cq_entries;
+  for (int i = params.cq_entries - 1; i >= 0; --i) {
+    ring->ops[i].next = ring->free;
+    ring->free = &ring->ops[i];
+  }
+
+  if (0 != options->buffers && options->nbuffers > 0) {
+    const int rc = ras_uring_register(
+      fd,
+      IORING_REGISTER_BUFFERS,
+      options->buffers,
+      options->nbuffers);
+
+    // reads and writes use plain operations when buffers can't be pinned
+    ring->fixed_buffers = 0 == rc;
+  }
+
+  return ring;
+
+error:
+  ras_uring_ring_free(ring);
+  return 0;
+}
+
+/**
+ * Submits the batched submission queue entries to the kernel and waits for
+ * at least `wait` operations to complete.
+ */
+static int
+ras_uring_enter(struct ras_uring_s *ring, unsigned int wait) {
+  const unsigned int flags = wait > 0 ? IORING_ENTER_GETEVENTS : 0;
+  int rc = 0;
+
+  if (0 == ring->unsubmitted && 0 == wait) {
+    return 0;
+  }
+
+  do {
+    rc = (int) syscall(
+      __NR_io_uring_enter,
+      ring->fd,
+      ring->unsubmitted,
+      wait,
+      flags,
+      0,
+      0);
+  } while (rc < 0 && EINTR == errno);
+
+  if (rc < 0) {
+    return -errno;
+  }
+
+  ring->unsubmitted -= rc;
+  return 0;
+}
+
+/**
+ * Returns the next free submission queue entry, submitting the batched
+ * entries if the submission queue is full.
+ */
+static struct io_uring_sqe *
+ras_uring_sqe(struct ras_uring_s *ring) {
+  const unsigned int tail = *ring->sq_tail;
+  struct io_uring_sqe *sqe = 0;
+  unsigned int index = 0;
+  unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+  if (tail - head >= ring->entries) {
+    ras_uring_enter(ring, 0);
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    if (tail - head >= ring->entries) {
+      return 0;
+    }
+  }
+
+  index = tail & *ring->sq_mask;
+  sqe = &ring->sqes[index];
+  ring->sq_array[index] = index;
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  return sqe;
+}
+
+static void
+ras_uring_push(struct ras_uring_s *ring) {
+  __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+  ring->unsubmitted++;
+}
+
+/**
+ * Returns the index of the registered buffer that contains
+ * `[buffer, buffer + size)`, otherwise `-1`.
+ */
+static int
+ras_uring_buffer(
+  struct ras_uring_storage_s *storage,
+  const char *buffer,
+  unsigned long int size
+) {
+  if (0 == storage->ring->fixed_buffers) {
+    return -1;
+  }
+
+  for (int i = 0; i < storage->uring_options.nbuffers; ++i) {
+    const char *base = storage->uring_options.buffers[i].iov_base;
+    const unsigned long int length = storage->uring_options.buffers[i].iov_len;
+
+    if (buffer >= base && buffer + size <= base + length) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static void
+ras_uring_file(struct ras_uring_storage_s *storage, struct io_uring_sqe *sqe) {
+  if (1 == storage->ring->fixed_file) {
+    sqe->fd = 0;
+    sqe->flags |= IOSQE_FIXED_FILE;
+  } else {
+    sqe->fd = storage->fd;
+  }
+}
+
+/**
+ * Queues a submission queue entry for the remainder of `op`. Returns `0`
+ * on success, otherwise an error code found in `errno.h` with its sign
+ * flipped.
+ */
+static int
+ras_uring_prepare(
+  struct ras_uring_storage_s *storage,
+  struct ras_uring_op_s *op
+) {
+  struct ras_request_s *request = op->request;
+  struct ras_uring_s *ring = storage->ring;
+  struct io_uring_sqe *sqe = ras_uring_sqe(ring);
+  unsigned long int size = 0;
+  char *buffer = 0;
+  int index = 0;
+
+  if (0 == sqe) {
+    return -EAGAIN;
+  }
+
+  sqe->user_data = (unsigned long long) (uintptr_t) op;
+
+  switch (request->type) {
+    case RAS_REQUEST_OPEN:
+      sqe->opcode = IORING_OP_OPENAT;
+      sqe->fd = AT_FDCWD;
+      sqe->addr = (uintptr_t) storage->path;
+      sqe->len = storage->uring_options.mode;
+      sqe->open_flags = storage->uring_options.flags | O_CLOEXEC;
+      break;
+
+    case RAS_REQUEST_READ:
+    case RAS_REQUEST_BORROW:
+    case RAS_REQUEST_WRITE:
+      buffer = (char *) request->data + op->done;
+      size = request->size - op->done;
+
+      if (size > RAS_URING_MAX_TRANSFER) {
+        size = RAS_URING_MAX_TRANSFER;
+      }
+
+      index = ras_uring_buffer(storage, buffer, size);
+
+      if (RAS_REQUEST_WRITE != request->type) {
+        sqe->opcode = index < 0 ? IORING_OP_READ : IORING_OP_READ_FIXED;
+      } else {
+        sqe->opcode = index < 0 ? IORING_OP_WRITE : IORING_OP_WRITE_FIXED;
+      }
+
+      if (index >= 0) {
+        sqe->buf_index = index;
+      }
+
+      ras_uring_file(storage, sqe);
+      sqe->addr = (uintptr_t) buffer;
+      sqe->len = size;
+      sqe->off = request->offset + op->done;
+      break;
+
+    case RAS_REQUEST_DELETE:
+      sqe->opcode = IORING_OP_FALLOCATE;
+      ras_uring_file(storage, sqe);
+      sqe->len = FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+      sqe->off = request->offset;
+      sqe->addr = request->size;
+      break;
+
+    case RAS_REQUEST_STAT:
+      sqe->opcode = IORING_OP_STATX;
+      sqe->fd = storage->fd;
+      sqe->addr = (uintptr_t) "";
+      sqe->len = STATX_SIZE;
+      sqe->off = (uintptr_t) &op->statx;
+      sqe->statx_flags = AT_EMPTY_PATH;
+      break;
+
+    case RAS_REQUEST_SYNC:
+      sqe->opcode = IORING_OP_FSYNC;
+      ras_uring_file(storage, sqe);
+      sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+      break;
+
+    case RAS_REQUEST_CLOSE:
+      if (1 == ring->fixed_file) {
+        ras_uring_register(ring->fd, IORING_UNREGISTER_FILES, 0, 0);
+        ring->fixed_file = 0;
+      }
+
+      sqe->opcode = IORING_OP_CLOSE;
+      sqe->fd = storage->fd;
+      break;
+
+    default:
+      return -ENOSYS;
+  }
+
+  ras_uring_push(ring);
+  return 0;
+}
+
+static void
+ras_uring_op_free(struct ras_uring_s *ring, struct ras_uring_op_s *op) {
+  op->request = 0;
+  op->next = ring->free;
+  ring->free = op;
+}
+
+/**
+ * Submits `request` to the io_uring of its storage. The request completes
+ * when its completion is reaped by `ras_uring_storage_poll()`.
+ */
+static void
+ras_uring_start(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  struct ras_uring_s *ring = storage->ring;
+  struct ras_uring_op_s *op = ring->free;
+  int rc = 0;
+
+  if (0 == op) {
+    request->callback(request, EAGAIN, 0, 0);
+    return;
+  }
+
+  ring->free = op->next;
+  op->request = request;
+  op->next = 0;
+  op->done = 0;
+
+  rc = ras_uring_prepare(storage, op);
+
+  if (rc < 0) {
+    ras_uring_op_free(ring, op);
+    request->callback(request, -rc, 0, 0);
+  }
+}
+
+/**
+ * Submits a cancellation of the operation in flight for `request`. The
+ * operation completes with `ECANCELED` if the kernel aborts it, otherwise
+ * with its result. The cancellation has no operation of its own and its
+ * completion is ignored.
+ */
+static void
+ras_uring_cancel(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  struct ras_uring_s *ring = storage->ring;
+  struct io_uring_sqe *sqe = 0;
+
+  for (unsigned int i = 0; i < ring->nops; ++i) {
+    struct ras_uring_op_s *op = &ring->ops[i];
+
+    if (request != op->request) {
+      continue;
+    }
+
+    sqe = ras_uring_sqe(ring);
+
+    if (0 != sqe) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->addr = (unsigned long long) (uintptr_t) op;
+      sqe->user_data = 0;
+      ras_uring_push(ring);
+    }
+
+    return;
+  }
+}
+
+/**
+ * Completes `op` with the result `res` of its completion queue entry.
+ * Short reads and writes are resubmitted for the remainder.
+ */
+static void
+ras_uring_complete(
+  struct ras_uring_storage_s *storage,
+  struct ras_uring_op_s *op,
+  int res
+) {
+  struct ras_request_s *request = op->request;
+  struct ras_storage_stats_s *stats = 0;
+  struct ras_uring_s *ring = storage->ring;
+  unsigned long int size = 0;
+  void *value = 0;
+  int err = res < 0 ? -res : 0;
+  int rc = 0;
+
+  switch (request->type) {
+    case RAS_REQUEST_OPEN:
+      if (0 == err) {
+        storage->fd = res;
+        rc = ras_uring_register(ring->fd, IORING_REGISTER_FILES, &res, 1);
+        ring->fixed_file = 0 == rc;
+      }
+      break;
+
+    case RAS_REQUEST_READ:
+    case RAS_REQUEST_BORROW:
+    case RAS_REQUEST_WRITE:
+      if (0 == err) {
+        op->done += res;
+
+        if (res > 0 && op->done < request->size) {
+          rc = ras_uring_prepare(storage, op);
+          if (0 == rc) {
+            return;
+          }
+
+          err = -rc;
+        }
+      }
+
+      if (RAS_REQUEST_WRITE != request->type && 0 == err) {
+        value = request->data;
+      }
+
+      size = op->done;
+      break;
+
+    case RAS_REQUEST_DELETE:
+      size = request->size;
+      break;
+
+    case RAS_REQUEST_STAT:
+      if (0 == err) {
+        stats = request->data;
+        stats->size = op->statx.stx_size;
+        value = stats;
+        size = sizeof(struct ras_storage_stats_s);
+      }
+      break;
+
+    case RAS_REQUEST_CLOSE:
+      // the descriptor is released even if close fails
+      storage->fd = -1;
+      break;
+
+    default:
+      break;
+  }
+
+  ras_uring_op_free(ring, op);
+  request->callback(request, err, value, size);
+}
+
+static void
+ras_uring_storage_teardown(struct ras_uring_storage_s *storage) {
+  ras_uring_ring_free(storage->ring);
+  storage->ring = 0;
+
+  if (storage->fd >= 0) {
+    close(storage->fd);
+    storage->fd = -1;
+  }
+
+  // joined later if called from one of its own workers
+  ras_executor_free(storage->executor);
+  storage->options.executor = 0;
+  storage->executor = 0;
+
+  ras_free(storage->path);
+  storage->path = 0;
+}
+
+static void
+ras_uring_destroy(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  // the ring is torn down once the completions being reaped are done
+  if (0 != storage->ring && 1 == storage->ring->polling) {
+    storage->ring->destroy = request;
+    return;
+  }
+
+  ras_uring_storage_teardown(storage);
+  request->callback(request, 0, 0, 0);
+}
+
+static void
+ras_uring_fallback_open(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  const int fd = open(
+    storage->path,
+    storage->uring_options.flags | O_CLOEXEC,
+    storage->uring_options.mode);
+
+  if (fd < 0) {
+    request->callback(request, errno, 0, 0);
+    return;
+  }
+
+  storage->fd = fd;
+  request->callback(request, 0, 0, 0);
+}
+
+// runs on an executor worker thread
+static void
+ras_uring_fallback_read(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  const long int n = ras_io_read(
+    storage->fd,
+    request->data,
+    request->size,
+    request->offset);
+
+  if (n < 0) {
+    request->callback(request, -n, 0, 0);
+  } else {
+    request->callback(request, 0, request->data, n);
+  }
+}
+
+// runs on an executor worker thread
+static void
+ras_uring_fallback_write(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  const long int n = ras_io_write(
+    storage->fd,
+    request->data,
+    request->size,
+    request->offset);
+
+  if (n < 0) {
+    request->callback(request, -n, 0, 0);
+  } else {
+    request->callback(request, 0, 0, n);
+  }
+}
+
+// runs on an executor worker thread
+static void
+ras_uring_fallback_delete(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  const int rc = ras_io_punch(storage->fd, request->offset, request->size);
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  } else {
+    request->callback(request, 0, 0, request->size);
+  }
+}
+
+// runs on an executor worker thread
+static void
+ras_uring_fallback_stat(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  struct ras_storage_stats_s *stats = request->data;
+  const long int size = ras_io_size(storage->fd);
+
+  if (size < 0) {
+    request->callback(request, -size, 0, 0);
+    return;
+  }
+
+  stats->size = size;
+  request->callback(request, 0, stats, sizeof(struct ras_storage_stats_s));
+}
+
+// runs on an executor worker thread
+static void
+ras_uring_fallback_sync(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  const int rc = ras_io_sync(storage->fd);
+
+  if (rc < 0) {
+    request->callback(request, -rc, 0, 0);
+  } else {
+    request->callback(request, 0, 0, 0);
+  }
+}
+
+static void
+ras_uring_fallback_close(struct ras_request_s *request) {
+  struct ras_uring_storage_s *storage =
+    (struct ras_uring_storage_s *) request->storage;
+
+  const int rc = close(storage->fd);
+
+  storage->fd = -1;
+  request->callback(request, rc < 0 ? errno : 0, 0, 0);
+}
+
+struct ras_storage_s *
+ras_uring_storage_new(
+  const char *path,
+  struct ras_uring_storage_options_s options
+) {
+  struct ras_storage_options_s storage_options = { 0 };
+  struct ras_uring_storage_s *storage = 0;
+  struct ras_executor_s *executor = 0;
+  struct ras_uring_s *ring = 0;
+  unsigned long int length = 0;
+
+  if (0 == path) {
+    errno = EFAULT;
+    return 0;
+  }
+
+  if (0 == options.flags) {
+    options.flags = O_RDWR | O_CREAT;
+  }
+
+  if (0 == options.mode) {
+    options.mode = 0644;
+  }
+
+  if (0 == options.entries) {
+    options.entries = RAS_URING_ENTRIES;
+  }
+
+  if (0 == options.workers) {
+    options.workers = RAS_EXECUTOR_WORKERS;
+  }
+
+  storage = ras_alloc(sizeof(struct ras_uring_storage_s));
+
+  if (0 == storage) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  length = strlen(path) + 1;
+  memset(storage, 0, sizeof(struct ras_uring_storage_s));
+  storage->path = ras_alloc(length);
+
+  if (0 == storage->path) {
+    errno = ENOMEM;
+    goto error;
+  }
+
+  memcpy(storage->path, path, length);
+
+  if (0 == options.fallback) {
+    ring = ras_uring_ring_new(&options);
+  }
+
+  if (0 != ring) {
+    storage_options = (struct ras_storage_options_s) {
+      .open = ras_uring_start,
+      .read = ras_uring_start,
+      .write = ras_uring_start,
+      .del = ras_uring_start,
+      .stat = ras_uring_start,
+      .sync = ras_uring_start,
+      .close = ras_uring_start,
+      .cancel = ras_uring_cancel,
+      .destroy = ras_uring_destroy,
+      .max_inflight = ring->entries,
+      .group_sync = 1,
+    };
+  } else {
+    executor = ras_executor_new(
+      (struct ras_executor_options_s) {
+        .workers = options.workers,
+      });
+
+    if (0 == executor) {
+      goto error;
+    }
+
+    storage_options = (struct ras_storage_options_s) {
+      .open = ras_uring_fallback_open,
+      .read = ras_uring_fallback_read,
+      .write = ras_uring_fallback_write,
+      .del = ras_uring_fallback_delete,
+      .stat = ras_uring_fallback_stat,
+      .sync = ras_uring_fallback_sync,
+      .close = ras_uring_fallback_close,
+      .destroy = ras_uring_destroy,
+      .max_inflight = options.workers,
+      .executor = executor,
+      .group_sync = 1,
+      .sync_window = options.sync_window,
+    };
+  }
+
+  if (ras_storage_init((struct ras_storage_s *) storage, storage_options) < 0) {
+    goto error;
+  }
+
+  storage->alloc = 1;
+  storage->uring_options = options;
+  storage->ring = ring;
+  storage->executor = executor;
+  storage->fd = -1;
+  ras_emitter_init(&storage->emitter);
+  return (struct ras_storage_s *) storage;
+
+error:
+  ras_uring_ring_free(ring);
+  ras_executor_free(executor);
+  ras_free(storage->path);
+  ras_free(storage);
+  return 0;
+}
+
+int
+ras_uring_storage_poll(struct ras_storage_s *storage, unsigned int wait) {
+  struct ras_uring_storage_s *uring = (struct ras_uring_storage_s *) storage;
+  struct ras_request_s *destroy = 0;
+  struct ras_uring_s *ring = 0;
+  unsigned int head = 0;
+  int count = 0;
+  int rc = 0;
+
+  require(storage, EFAULT);
+
+  ring = uring->ring;
+
+  if (0 == ring) {
+    return 0;
+  }
+
+  // a destroy made while requests time out or complete is deferred
+  ring->polling = 1;
+
+  // cancellations of requests in flight are submitted with the batch
+  ras_storage_expire(storage);
+
+  if (0 == ring->destroy) {
+    rc = ras_uring_enter(ring, wait);
+  }
+
+  // completions are reaped even if the kernel is busy
+  if (rc < 0 && -EBUSY != rc && -EAGAIN != rc) {
+    ring->polling = 0;
+    errno = -rc;
+    return rc;
+  }
+
+  head = *ring->cq_head;
+
+  while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+    struct ras_uring_op_s *op = (struct ras_uring_op_s *) (uintptr_t)
+      cqe->user_data;
+
+    const int res = cqe->res;
+
+    __atomic_store_n(ring->cq_head, ++head, __ATOMIC_RELEASE);
+
+    // cancellations have no operation to complete
+    if (0 != op) {
+      ras_uring_complete(uring, op, res);
+      count++;
+    }
+  }
+
+  ring->polling = 0;
+  destroy = ring->destroy;
+
+  if (0 != destroy) {
+    ring->destroy = 0;
+    ras_uring_storage_teardown(uring);
+    destroy->callback(destroy, 0, 0, 0);
+  }
+
+  return count;
+}
+
+int
+ras_uring_storage_supported(struct ras_storage_s *storage) {
+  if (0 == storage) {
+    return 0;
+  }
+
+  return 0 != ((struct ras_uring_storage_s *) storage)->ring;
+}
@@ -0,0 +1,366 @@
+#include <ras/allocator.h>
+#include <ras/cache.h>
+#include <ras/request.h>
+#include <ras/storage.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ok/ok.h>
+
+#ifndef OK_EXPECTED
+#define OK_EXPECTED 0
+#endif
+
+#define BLOCK_SIZE 64
+
+// not a multiple of the block size so the last block is short
+#define MEMORY_SIZE (32 * BLOCK_SIZE - 24)
+
+static unsigned char memory[MEMORY_SIZE] = { 0 };
+static unsigned char into[2 * BLOCK_SIZE] = { 0 };
+static unsigned char blocks[8 * BLOCK_SIZE] = { 0 };
+static unsigned long int read_size = 0;
+static unsigned long int stat_size = 0;
+static unsigned long int write_offset = 0;
+static unsigned long int write_size = 0;
+static unsigned int nreads = 0;
+static unsigned int nwrites = 0;
+static int flush_err = -1;
+
+static void
+onread(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  read_size = 0 == err ? size : 0;
+}
+
+static void
+onstat(
+  struct ras_storage_s *storage,
+  int err,
+  struct ras_storage_stats_s *stats
+) {
+  stat_size = 0 == err ? stats->size : 0;
+}
+
+static void
+onflush(struct ras_storage_s *storage, int err) {
+  flush_err = err;
+}
+
+static void
+read_memory(struct ras_request_s *request) {
+  unsigned long int size = request->size;
+
+  if (request->offset >= MEMORY_SIZE) {
+    size = 0;
+  } else if (size > MEMORY_SIZE - request->offset) {
+    size = MEMORY_SIZE - request->offset;
+  }
+
+  nreads++;
+  memcpy(request->data, memory + request->offset, size);
+  request->callback(request, 0, request->data, size);
+}
+
+static void
+write_memory(struct ras_request_s *request) {
+  nwrites++;
+  write_offset = request->offset;
+  write_size = request->size;
+  memcpy(memory + request->offset, request->data, request->size);
+  request->callback(request, 0, 0, request->size);
+}
+
+static void
+delete_memory(struct ras_request_s *request) {
+  memset(memory + request->offset, 0, request->size);
+  request->callback(request, 0, 0, request->size);
+}
+
+static void
+stat_memory(struct ras_request_s *request) {
+  struct ras_storage_stats_s *stats = request->data;
+  stats->size = MEMORY_SIZE;
+  request->callback(request, 0, stats, sizeof(struct ras_storage_stats_s));
+}
+
+static struct ras_storage_s *
+cache_new(unsigned long int blocks, enum ras_cache_policy policy) {
+  struct ras_storage_s *inner = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = read_memory,
+      .write = write_memory,
+      .del = delete_memory,
+      .stat = stat_memory,
+    });
+
+  return ras_cache_storage_new(
+    inner,
+    blocks * BLOCK_SIZE,
+    BLOCK_SIZE,
+    policy);
+}
+
+// reads the blocks in `blocks` in order and returns the number of reads of
+// the inner storage they needed
+static unsigned int
+read_blocks(
+  struct ras_storage_s *storage,
+  const unsigned int *blocks,
+  unsigned int count
+) {
+  const unsigned int before = nreads;
+
+  for (unsigned int i = 0; i < count; ++i) {
+    ras_storage_read_into(
+      storage,
+      blocks[i] * BLOCK_SIZE,
+      BLOCK_SIZE,
+      into,
+      onread);
+  }
+
+  return nreads - before;
+}
+
+int
+main(void) {
+  printf("### ok: expecting %d\n", OK_EXPECTED);
+  ok_expect(OK_EXPECTED);
+
+  for (int i = 0; i < MEMORY_SIZE; ++i) {
+    memory[i] = (unsigned char) (i * 7);
+  }
+
+  struct ras_storage_s *storage = ras_cache_storage_new(
+    0,
+    BLOCK_SIZE,
+    BLOCK_SIZE,
+    RAS_CACHE_LRU);
+
+  if (0 == storage && EFAULT == errno) {
+    ok("ras_cache_storage_new() without an inner storage");
+  }
+
+  struct ras_storage_s *inner = ras_storage_new(
+    (struct ras_storage_options_s) { .read = read_memory });
+
+  storage = ras_cache_storage_new(inner, BLOCK_SIZE - 1, BLOCK_SIZE, 0);
+  if (0 == storage && EINVAL == errno) {
+    ok("ras_cache_storage_new() with a capacity smaller than a block");
+  }
+
+  ras_storage_destroy(inner, 0);
+
+  storage = cache_new(4, RAS_CACHE_LRU);
+  struct ras_cache_storage_s *cache = (struct ras_cache_storage_s *) storage;
+
+  nreads = 0;
+  ras_storage_read_into(storage, 10, BLOCK_SIZE, into, onread);
+  ras_storage_read_into(storage, 20, BLOCK_SIZE, into, onread);
+  if (
+    1 == nreads &&
+    BLOCK_SIZE == read_size &&
+    0 == memcmp(into, memory + 20, BLOCK_SIZE) &&
+    1 == cache->hits &&
+    1 == cache->misses &&
+    2 == cache->cached
+  ) {
+    ok("ras_storage_read_into() across blocks is served from the cache");
+  }
+
+  // block 1 is read least recently when block 5 needs room
+  const unsigned int lru[] = { 2, 3, 0, 5, 1 };
+  if (4 == read_blocks(storage, lru, 5) && 2 == cache->evictions) {
+    ok("RAS_CACHE_LRU evicts the block read least recently");
+  }
+
+  ras_storage_write(storage, 2, 4, "abcd", 0);
+  nreads = 0;
+  ras_storage_read_into(storage, 0, 8, into, onread);
+  if (
+    0 == nreads &&
+    0 == memcmp(into + 2, "abcd", 4) &&
+    0 == memcmp(memory + 2, "abcd", 4)
+  ) {
+    ok("ras_storage_write() writes through and updates cached blocks");
+  }
+
+  ras_storage_delete(storage, 0, 4, 0);
+  ras_storage_read_into(storage, 0, 8, into, onread);
+  if (1 == nreads && 0 == into[0] && 0 == memcmp(into + 4, "cd", 2)) {
+    ok("ras_storage_delete() drops the cached blocks it overlaps");
+  }
+
+  ras_storage_read_into(storage, MEMORY_SIZE - 8, 16, into, onread);
+  ras_storage_read_into(storage, MEMORY_SIZE - 8, 16, into, onread);
+  if (3 == nreads && 8 == read_size) {
+    ok("the short block at the end of the storage is not cached");
+  }
+
+  ras_storage_stat(storage, onstat);
+  if (MEMORY_SIZE == stat_size) {
+    ok("ras_storage_stat() stats the inner storage");
+  }
+
+  ras_storage_destroy(storage, 0);
+
+  // block 0 was read again, so the sweep passes it and evicts block 1
+  storage = cache_new(2, RAS_CACHE_CLOCK);
+  const unsigned int clock[] = { 0, 1, 0, 2, 0 };
+  if (3 == read_blocks(storage, clock, 5)) {
+    ok("RAS_CACHE_CLOCK evicts the first block not read again");
+  }
+
+  ras_storage_destroy(storage, 0);
+
+  // blocks 0 and 1 are read twice before a scan of blocks read once
+  const unsigned int scan[] = {
+    0, 1, 0, 1, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 0, 1
+  };
+
+  storage = cache_new(4, RAS_CACHE_LRU);
+  const unsigned int lru_reads = read_blocks(storage, scan, 16);
+  ras_storage_destroy(storage, 0);
+
+  storage = cache_new(4, RAS_CACHE_ARC);
+  const unsigned int arc_reads = read_blocks(storage, scan, 16);
+  cache = (struct ras_cache_storage_s *) storage;
+
+  if (14 == lru_reads && 12 == arc_reads && 4 == cache->hits) {
+    ok("RAS_CACHE_ARC keeps blocks read again through a scan");
+  }
+
+  ras_storage_destroy(storage, 0);
+
+  storage = cache_new(8, RAS_CACHE_LRU);
+  cache = (struct ras_cache_storage_s *) storage;
+  ras_cache_storage_write_back(
+    storage,
+    (struct ras_cache_write_back_options_s) { .max_dirty = 6 * BLOCK_SIZE });
+
+  memset(blocks, 'a', BLOCK_SIZE);
+  memset(blocks + BLOCK_SIZE, 'b', BLOCK_SIZE);
+  memset(blocks + 2 * BLOCK_SIZE, 'c', BLOCK_SIZE);
+
+  nreads = 0;
+  nwrites = 0;
+  ras_storage_write(storage, 3 * BLOCK_SIZE, BLOCK_SIZE, blocks, 0);
+  ras_storage_write(storage, BLOCK_SIZE, BLOCK_SIZE, blocks + BLOCK_SIZE, 0);
+  ras_storage_write(storage, 2 * BLOCK_SIZE, 2, blocks + 2 * BLOCK_SIZE, 0);
+  ras_storage_write(storage, 2 * BLOCK_SIZE, BLOCK_SIZE, blocks + 2 * BLOCK_SIZE, 0);
+  if (
+    1 == nwrites &&
+    3 * BLOCK_SIZE == cache->dirty &&
+    0 != memcmp(memory + 3 * BLOCK_SIZE, blocks, BLOCK_SIZE)
+  ) {
+    ok("ras_cache_storage_write_back() keeps writes of whole blocks in the cache");
+  }
+
+  // block 3 is dirty and block 4 is read from the inner storage
+  ras_storage_read_into(storage, 3 * BLOCK_SIZE, 2 * BLOCK_SIZE, into, onread);
+  if (
+    1 == nreads &&
+    2 * BLOCK_SIZE == read_size &&
+    0 == memcmp(into, blocks, BLOCK_SIZE) &&
+    0 == memcmp(into + BLOCK_SIZE, memory + 4 * BLOCK_SIZE, BLOCK_SIZE)
+  ) {
+    ok("ras_storage_read_into() reads dirty blocks from the cache");
+  }
+
+  nwrites = 0;
+  ras_storage_flush(storage, onflush);
+  if (
+    0 == flush_err &&
+    1 == nwrites &&
+    BLOCK_SIZE == write_offset &&
+    3 * BLOCK_SIZE == write_size &&
+    0 == memcmp(memory + BLOCK_SIZE, blocks + BLOCK_SIZE, 2 * BLOCK_SIZE) &&
+    0 == memcmp(memory + 3 * BLOCK_SIZE, blocks, BLOCK_SIZE) &&
+    0 == cache->dirty &&
+    1 == cache->flushes &&
+    3 * BLOCK_SIZE == cache->flushed_bytes
+  ) {
+    ok("ras_storage_flush() writes the dirty blocks in one sorted run");
+  }
+
+  for (int i = 0; i < 8 * BLOCK_SIZE; ++i) {
+    blocks[i] = (unsigned char) (i * 3);
+  }
+
+  nwrites = 0;
+  ras_storage_write(storage, 10 * BLOCK_SIZE, 5 * BLOCK_SIZE, blocks, 0);
+  ras_storage_write(storage, 15 * BLOCK_SIZE, BLOCK_SIZE, blocks + 5 * BLOCK_SIZE, 0);
+  if (
+    1 == nwrites &&
+    10 * BLOCK_SIZE == write_offset &&
+    6 * BLOCK_SIZE == write_size &&
+    0 == memcmp(memory + 10 * BLOCK_SIZE, blocks, 6 * BLOCK_SIZE) &&
+    0 == cache->dirty
+  ) {
+    ok("writes are flushed once max_dirty bytes are dirty");
+  }
+
+  ras_storage_write(storage, 20 * BLOCK_SIZE, BLOCK_SIZE, blocks, 0);
+  ras_storage_delete(storage, 20 * BLOCK_SIZE + 8, 8, 0);
+  ras_storage_close(storage, 0);
+  if (
+    2 == nwrites &&
+    0 == memcmp(memory + 20 * BLOCK_SIZE, blocks, 8) &&
+    0 == memory[20 * BLOCK_SIZE + 8] &&
+    0 == memcmp(memory + 20 * BLOCK_SIZE + 16, blocks + 16, BLOCK_SIZE - 16) &&
+    0 == cache->dirty
+  ) {
+    ok("ras_storage_close() flushes the dirty blocks first");
+  }
+
+  ras_storage_write(storage, 0, BLOCK_SIZE, blocks, 0);
+  ras_storage_destroy(storage, 0);
+
+  storage = cache_new(2, RAS_CACHE_CLOCK);
+  ras_cache_storage_write_back(
+    storage,
+    (struct ras_cache_write_back_options_s) { .max_dirty = 2 * BLOCK_SIZE });
+
+  nwrites = 0;
+  ras_storage_write(storage, 0, BLOCK_SIZE, blocks, 0);
+  if (0 == nwrites) {
+    ras_storage_destroy(storage, 0);
+  }
+
+  if (1 == nwrites && 0 == memcmp(memory, blocks, BLOCK_SIZE)) {
+    ok("ras_storage_destroy() flushes the dirty blocks first");
+  }
+
+  storage = cache_new(8, RAS_CACHE_LRU);
+  cache = (struct ras_cache_storage_s *) storage;
+  ras_cache_storage_write_back(
+    storage,
+    (struct ras_cache_write_back_options_s) { .interval = 500 });
+
+  // the interval is in microseconds
+  nwrites = 0;
+  ras_storage_write(storage, 0, BLOCK_SIZE, blocks, 0);
+  const unsigned int held_back = 0 == nwrites && BLOCK_SIZE == cache->dirty;
+  nanosleep(&(struct timespec) { .tv_nsec = 1000000 }, 0);
+  ras_storage_read_into(storage, 0, BLOCK_SIZE, into, onread);
+  if (held_back && 1 == nwrites && 0 == cache->dirty) {
+    ok("dirty blocks are flushed once the interval expires");
+  }
+
+  ras_storage_destroy(storage, 0);
+
+  const struct ras_allocator_stats_s stats = ras_allocator_stats();
+  if (stats.alloc == stats.free) {
+    ok("stats.alloc == stats.free");
+  }
+
+  ok_done();
+  return ok_expected() - ok_count();
+}
@@ -0,0 +1,137 @@
+#include <ras/allocator.h>
+#include <ras/executor.h>
+#include <ras/storage.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <ok/ok.h>
+
+#ifndef OK_EXPECTED
+#define OK_EXPECTED 0
+#endif
+
+#define TASKS 1000
+#define SPAWNED 64
+#define READS 8
+
+static struct ras_executor_s *executor = 0;
+static pthread_t caller;
+static unsigned int counter = 0;
+static unsigned int completed = 0;
+static unsigned int offthread = 0;
+static unsigned char memory[READS * 4] = { 0 };
+
+static void
+block(long nanoseconds) {
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = nanoseconds };
+  nanosleep(&ts, 0);
+}
+
+static void
+count(void *data) {
+  __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+}
+
+// queues work on the deque of this worker and blocks
+// so idle workers steal it
+static void
+spawn(void *data) {
+  for (int i = 0; i < SPAWNED; ++i) {
+    ras_executor_submit(executor, count, 0);
+  }
+
+  block(20 * 1000 * 1000);
+}
+
+static void
+fill(struct ras_request_s *request) {
+  if (0 == pthread_equal(caller, pthread_self())) {
+    __atomic_add_fetch(&offthread, 1, __ATOMIC_RELAXED);
+  }
+
+  block(1000 * 1000);
+  memcpy(request->data, memory + request->offset, request->size);
+  request->callback(request, 0, request->data, request->size);
+}
+
+static void
+onread(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  __atomic_add_fetch(&completed, 1, __ATOMIC_RELEASE);
+}
+
+int
+main(void) {
+  printf("### ok: expecting %d\n", OK_EXPECTED);
+  ok_expect(OK_EXPECTED);
+
+  unsigned char into[READS][4] = { { 0 } };
+  caller = pthread_self();
+  executor = ras_executor_new((struct ras_executor_options_s) {
+    .workers = 4,
+    .capacity = 6,
+  });
+
+  if (0 != executor) {
+    ok("ras_executor_new()");
+  }
+
+  if (8 == executor->options.capacity && 8 == executor->workers[0].capacity) {
+    ok("deque capacity rounded up to a power of 2");
+  }
+
+  for (int i = 0; i < TASKS; ++i) {
+    ras_executor_submit(executor, count, 0);
+  }
+
+  ras_executor_submit(executor, spawn, 0);
+
+  while (__atomic_load_n(&counter, __ATOMIC_RELAXED) < TASKS + SPAWNED) {
+    sched_yield();
+  }
+
+  if (ras_executor_stats(executor).stolen > 0) {
+    ok("idle workers steal queued work");
+  }
+
+  struct ras_storage_s *storage = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = fill,
+      .max_inflight = READS,
+      .executor = executor,
+    });
+
+  for (int i = 0; i < READS; ++i) {
+    memset(memory + i * 4, i, 4);
+    ras_storage_read_into(storage, i * 4, 4, into[i], onread);
+  }
+
+  while (__atomic_load_n(&completed, __ATOMIC_ACQUIRE) < READS) {
+    sched_yield();
+  }
+
+  if (READS == offthread && 0 == memcmp(into, memory, sizeof(memory))) {
+    ok("operations run on executor workers");
+  }
+
+  ras_storage_destroy(storage, 0);
+  ras_executor_free(executor);
+
+  if (TASKS + SPAWNED == counter) {
+    ok("ras_executor_free() runs queued work");
+  }
+
+  const struct ras_allocator_stats_s stats = ras_allocator_stats();
+  if (stats.alloc == stats.free) {
+    ok("stats.alloc == stats.free");
+  }
+
+  ok_done();
+  return ok_expected() - ok_count();
+}
@@ -0,0 +1,167 @@
+#include <ras/allocator.h>
+#include <ras/file.h>
+#include <ras/storage.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ok/ok.h>
+
+#ifndef OK_EXPECTED
+#define OK_EXPECTED 0
+#endif
+
+// past 4 GiB so offsets must not be truncated to 32 bits
+#define OFFSET 0x100000010UL
+
+static const char message[] = "positional";
+static char into[32] = { 0 };
+static unsigned long int read_size = 0;
+static unsigned long int stat_size = 0;
+
+static void
+onopen(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    ok("onopen()");
+  }
+}
+
+static void
+onwrite(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    ok("onwrite()");
+  }
+}
+
+static void
+onread(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  read_size = 0 == err ? size : 0;
+}
+
+static void
+onstat(
+  struct ras_storage_s *storage,
+  int err,
+  struct ras_storage_stats_s *stats
+) {
+  stat_size = 0 == err ? stats->size : 0;
+}
+
+static void
+ondelete(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    ok("ondelete()");
+  }
+}
+
+static void
+onsync(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    ok("onsync()");
+  }
+}
+
+static unsigned int synced = 0;
+
+static void
+onsynced(struct ras_storage_s *storage, int err) {
+  synced += 0 == err;
+}
+
+// sync requests made together share one sync
+static void
+onwritesync(struct ras_storage_s *storage, int err) {
+  for (int i = 0; i < 4; ++i) {
+    ras_storage_sync(storage, onsynced);
+  }
+}
+
+static void
+onclose(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    ok("onclose()");
+  }
+}
+
+int
+main(void) {
+  printf("### ok: expecting %d\n", OK_EXPECTED);
+  ok_expect(OK_EXPECTED);
+
+  char path[] = "/tmp/ras-file-XXXXXX";
+  const int fd = mkstemp(path);
+
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  if (0 == ras_file_storage_new(0, O_RDWR) && EFAULT == errno) {
+    ok("ras_file_storage_new() with NULL path");
+  }
+
+  struct ras_storage_s *storage = ras_file_storage_new(path, O_RDWR);
+
+  if (0 != storage) {
+    ok("ras_file_storage_new()");
+  }
+
+  ras_storage_open(storage, onopen);
+  ras_storage_write(storage, OFFSET, sizeof(message), message, onwrite);
+  ras_storage_read_into(storage, OFFSET, sizeof(message), into, onread);
+
+  if (sizeof(message) == read_size && 0 == memcmp(into, message, read_size)) {
+    ok("ras_storage_read_into() at a 64-bit offset");
+  }
+
+  ras_storage_stat(storage, onstat);
+  if (OFFSET + sizeof(message) == stat_size) {
+    ok("ras_storage_stat() with fstat()");
+  }
+
+  // a read past the end of the file is short
+  ras_storage_read_into(storage, OFFSET + 4, sizeof(into), into, onread);
+  if (sizeof(message) - 4 == read_size) {
+    ok("ras_storage_read_into() short at end of file");
+  }
+
+  ras_storage_delete(storage, OFFSET, 4, ondelete);
+  ras_storage_read_into(storage, OFFSET, sizeof(message), into, onread);
+  if (0 == memcmp(into, "\0\0\0\0", 4) && 0 == memcmp(into + 4, message + 4, 6)) {
+    ok("ras_storage_delete() zeros the range");
+  }
+
+  ras_storage_stat(storage, onstat);
+  if (OFFSET + sizeof(message) == stat_size) {
+    ok("ras_storage_delete() keeps the file size");
+  }
+
+  ras_storage_sync(storage, onsync);
+
+  ras_storage_write(storage, OFFSET, sizeof(message), message, onwritesync);
+  if (
+    4 == synced &&
+    2 == ras_storage_counters(storage).syncs &&
+    3 == ras_storage_counters(storage).syncs_shared
+  ) {
+    ok("sync requests made in a callback share one fdatasync()");
+  }
+
+  ras_storage_close(storage, onclose);
+  ras_storage_destroy(storage, 0);
+  unlink(path);
+
+  const struct ras_allocator_stats_s stats = ras_allocator_stats();
+  if (stats.alloc == stats.free) {
+    ok("stats.alloc == stats.free");
+  }
+
+  ok_done();
+  return ok_expected() - ok_count();
+}
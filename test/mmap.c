@@ -0,0 +1,217 @@
+#include <ras/allocator.h>
+#include <ras/mmap.h>
+#include <ras/storage.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ok/ok.h>
+
+#ifndef OK_EXPECTED
+#define OK_EXPECTED 0
+#endif
+
+static const char message[] = "mapped once";
+static char into[64] = { 0 };
+static unsigned long int read_size = 0;
+static unsigned long int stat_size = 0;
+
+static void
+onopen(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    ok("onopen()");
+  }
+}
+
+static void
+onread(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  read_size = 0 == err ? size : 0;
+}
+
+static const void *lent = 0;
+static struct ras_request_s *loan = 0;
+
+static void
+onborrow(
+  struct ras_storage_s *storage,
+  int err,
+  const void *buffer,
+  unsigned long int size,
+  struct ras_request_s *token
+) {
+  lent = buffer;
+  loan = token;
+}
+
+static void
+onstat(
+  struct ras_storage_s *storage,
+  int err,
+  struct ras_storage_stats_s *stats
+) {
+  stat_size = 0 == err ? stats->size : 0;
+}
+
+static int write_err = 0;
+
+static void
+onwrite(struct ras_storage_s *storage, int err) {
+  write_err = err;
+}
+
+static void
+onsync(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    ok("onsync()");
+  }
+}
+
+static void
+onflush(struct ras_storage_s *storage, int err) {
+  if (0 == err && 0 != storage->options.flush) {
+    ok("ras_storage_flush() msyncs the mapping");
+  }
+}
+
+static unsigned int synced = 0;
+
+static void
+onsynced(struct ras_storage_s *storage, int err) {
+  synced += 0 == err;
+}
+
+// sync requests made together share one sync
+static void
+onwritesync(struct ras_storage_s *storage, int err) {
+  for (int i = 0; i < 4; ++i) {
+    ras_storage_sync(storage, onsynced);
+  }
+}
+
+int
+main(void) {
+  printf("### ok: expecting %d\n", OK_EXPECTED);
+  ok_expect(OK_EXPECTED);
+
+  const unsigned long int page_size = getpagesize();
+  char path[] = "/tmp/ras-mmap-XXXXXX";
+  const int fd = mkstemp(path);
+
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  if (-EFAULT == ras_mmap_storage_flush(0)) {
+    ok("ras_mmap_storage_flush() with NULL storage");
+  }
+
+  struct ras_storage_s *storage = ras_mmap_storage_new(path, O_RDWR);
+  struct ras_mmap_storage_s *mapped = (struct ras_mmap_storage_s *) storage;
+
+  if (0 != storage) {
+    ok("ras_mmap_storage_new()");
+  }
+
+  ras_storage_open(storage, onopen);
+  if (0 == mapped->map && 0 == mapped->length) {
+    ok("empty file is not mapped");
+  }
+
+  ras_storage_write(storage, 0, sizeof(message), message, 0);
+  ras_storage_read_into(storage, 0, sizeof(message), into, onread);
+  if (sizeof(message) == read_size && 0 == memcmp(into, message, read_size)) {
+    ok("ras_storage_write() extends the file and maps it");
+  }
+
+  // a write past the mapping grows it with mremap()
+  ras_storage_write(storage, 3 * page_size, sizeof(message), message, 0);
+  ras_storage_stat(storage, onstat);
+  if (3 * page_size + sizeof(message) == stat_size
+      && mapped->mapped >= 4 * page_size) {
+    ok("ras_storage_write() grows the mapping");
+  }
+
+  ras_storage_read_into(storage, 0, sizeof(message), into, onread);
+  if (sizeof(message) == read_size && 0 == memcmp(into, message, read_size)) {
+    ok("data is kept when the mapping grows");
+  }
+
+  ras_storage_read_into(storage, stat_size - 4, sizeof(into), into, onread);
+  if (4 == read_size) {
+    ok("ras_storage_read_into() short at end of file");
+  }
+
+  ras_storage_delete(storage, 0, 6, 0);
+  ras_storage_read_into(storage, 0, sizeof(message), into, onread);
+  if (0 == memcmp(into, "\0\0\0\0\0\0", 6) && 0 == memcmp(into + 7, "once", 4)) {
+    ok("ras_storage_delete() zeros the range");
+  }
+
+  ras_storage_read_borrow(storage, 7, 4, onborrow);
+  if (0 != loan && (const void *) (mapped->map + 7) == lent) {
+    ok("ras_storage_read_borrow() lends the mapping");
+  }
+
+  ras_storage_delete(storage, 7, 4, 0);
+  if (1 == storage->queued && 0 == memcmp(lent, "once", 4)) {
+    ok("ras_storage_delete() waits for the loan");
+  }
+
+  ras_storage_loan_release(loan);
+  ras_storage_read_into(storage, 7, 4, into, onread);
+  if (0 == storage->queued && 0 == memcmp(into, "\0\0\0\0", 4)) {
+    ok("ras_storage_loan_release() runs the delete");
+  }
+
+  if (0 == ras_mmap_storage_flush(storage)) {
+    ok("ras_mmap_storage_flush()");
+  }
+
+  ras_storage_flush(storage, onflush);
+  ras_storage_sync(storage, onsync);
+
+  ras_storage_write(storage, 0, 4, "sync", onwritesync);
+  if (
+    4 == synced &&
+    2 == ras_storage_counters(storage).syncs &&
+    3 == ras_storage_counters(storage).syncs_shared
+  ) {
+    ok("sync requests made in a callback share one msync()");
+  }
+
+  ras_storage_destroy(storage, 0);
+
+  // changes are in the file once the storage is gone
+  storage = ras_mmap_storage_new(path, O_RDONLY);
+  ras_storage_read_into(storage, 3 * page_size, sizeof(message), into, onread);
+  if (sizeof(message) == read_size && 0 == memcmp(into, message, read_size)) {
+    ok("ras_storage_read_into() after reopening read only");
+  }
+
+  ras_storage_write(storage, 0, 4, "nope", onwrite);
+  if (EBADF == write_err) {
+    write_err = 0;
+    ras_storage_delete(storage, 0, 4, onwrite);
+    if (EBADF == write_err) {
+      ok("ras_storage_write() and ras_storage_delete() == EBADF read only");
+    }
+  }
+
+  ras_storage_destroy(storage, 0);
+  unlink(path);
+
+  const struct ras_allocator_stats_s stats = ras_allocator_stats();
+  if (stats.alloc == stats.free) {
+    ok("stats.alloc == stats.free");
+  }
+
+  ok_done();
+  return ok_expected() - ok_count();
+}
@@ -0,0 +1,216 @@
+#include <ras/allocator.h>
+#include <ras/ram.h>
+#include <ras/storage.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ok/ok.h>
+
+#ifndef OK_EXPECTED
+#define OK_EXPECTED 0
+#endif
+
+// a terabyte into the storage and across a page boundary
+#define OFFSET (0x10000000000UL - 4)
+
+static const char message[] = "sparse pages";
+static char into[64] = { 0 };
+static unsigned long int read_size = 0;
+static unsigned long int stat_size = 0;
+
+static void
+onread(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  read_size = 0 == err ? size : 0;
+}
+
+static const void *lent = 0;
+static unsigned long int lent_size = 0;
+static struct ras_request_s *loan = 0;
+
+static void
+onborrow(
+  struct ras_storage_s *storage,
+  int err,
+  const void *buffer,
+  unsigned long int size,
+  struct ras_request_s *token
+) {
+  lent = buffer;
+  lent_size = size;
+  loan = token;
+}
+
+static void
+onstat(
+  struct ras_storage_s *storage,
+  int err,
+  struct ras_storage_stats_s *stats
+) {
+  stat_size = 0 == err ? stats->size : 0;
+}
+
+int
+main(void) {
+  printf("### ok: expecting %d\n", OK_EXPECTED);
+  ok_expect(OK_EXPECTED);
+
+  struct ras_storage_s *storage = ras_ram_storage_new(
+    (struct ras_ram_storage_options_s) { .page_size = 3 });
+
+  if (0 == storage && EINVAL == errno) {
+    ok("ras_ram_storage_new() with a page size that is not a power of 2");
+  }
+
+  storage = ras_ram_storage_new((struct ras_ram_storage_options_s) { 0 });
+  struct ras_ram_storage_s *ram = (struct ras_ram_storage_s *) storage;
+
+  if (0 != storage && RAS_RAM_PAGE_SIZE == ram->page_size) {
+    ok("ras_ram_storage_new() with the default page size");
+  }
+
+  ras_storage_write(storage, OFFSET, sizeof(message), message, 0);
+  ras_storage_stat(storage, onstat);
+  if (OFFSET + sizeof(message) == stat_size && 2 == ram->npages) {
+    ok("ras_storage_write() at a terabyte allocates only the pages written");
+  }
+
+  ras_storage_read_into(storage, OFFSET, sizeof(message), into, onread);
+  if (sizeof(message) == read_size && 0 == memcmp(into, message, read_size)) {
+    ok("ras_storage_read_into() across pages");
+  }
+
+  // a read allocates its request, so compare it with a read of a page
+  const unsigned long int before = ras_allocator_stats().alloc;
+  ras_storage_read_into(storage, OFFSET, 4, into, onread);
+  const unsigned long int after = ras_allocator_stats().alloc;
+
+  memset(into, 0xff, sizeof(into));
+  ras_storage_read_into(storage, 1 << 20, sizeof(into), into, onread);
+  if (
+    sizeof(into) == read_size &&
+    0 == into[0] && 0 == into[sizeof(into) - 1] &&
+    2 == ram->npages &&
+    after - before == ras_allocator_stats().alloc - after
+  ) {
+    ok("ras_storage_read_into() of a hole reads zeros without a page");
+  }
+
+  ras_storage_read_into(storage, stat_size - 4, sizeof(into), into, onread);
+  if (4 == read_size) {
+    ok("ras_storage_read_into() short at the end of the storage");
+  }
+
+  ras_storage_read_borrow(storage, OFFSET, sizeof(message), onborrow);
+  if (0 != loan && 4 == lent_size && 0 == memcmp(lent, message, 4)) {
+    ok("ras_storage_read_borrow() ends at the end of a page");
+  }
+
+  ras_storage_loan_release(loan);
+  loan = 0;
+
+  ras_storage_read_borrow(storage, 4096, 16, onborrow);
+  memset(into, 0, sizeof(into));
+  if (0 != loan && 16 == lent_size && 0 == memcmp(lent, into, 16)) {
+    ok("ras_storage_read_borrow() of a hole lends the zero page");
+  }
+
+  ras_storage_loan_release(loan);
+
+  // the second page is whole, the first only partly deleted
+  ras_storage_delete(storage, OFFSET + 2, RAS_RAM_PAGE_SIZE + 2, 0);
+  ras_storage_read_into(storage, OFFSET, sizeof(message), into, onread);
+  if (
+    1 == ram->npages &&
+    0 == memcmp(into, message, 2) &&
+    0 == memcmp(into + 2, "\0\0\0\0\0\0\0\0\0\0\0", sizeof(message) - 2)
+  ) {
+    ok("ras_storage_delete() frees whole pages and zeros partial ones");
+  }
+
+  ras_storage_delete(storage, OFFSET, 2, 0);
+  ras_storage_delete(storage, OFFSET - 4096, 8192, 0);
+  if (0 == ram->npages && 0 == ram->root) {
+    ok("ras_storage_delete() frees the page table with the last page");
+  }
+
+  ras_storage_destroy(storage, 0);
+
+  storage = ras_ram_storage_new(
+    (struct ras_ram_storage_options_s) { .page_size = 4 });
+  ram = (struct ras_ram_storage_s *) storage;
+
+  ras_storage_write(storage, 2, sizeof(message), message, 0);
+  ras_storage_read_into(storage, 0, sizeof(into), into, onread);
+  if (
+    4 == ram->npages &&
+    2 + sizeof(message) == read_size &&
+    0 == memcmp(into + 2, message, sizeof(message))
+  ) {
+    ok("ras_storage_write() with a 4 byte page size");
+  }
+
+  ras_storage_destroy(storage, 0);
+
+  storage = ras_ram_storage_new((struct ras_ram_storage_options_s) { 0 });
+  ram = (struct ras_ram_storage_s *) storage;
+
+  for (int i = 0; i < 3; ++i) {
+    ras_storage_write(storage, i * RAS_RAM_PAGE_SIZE, 4, "page", 0);
+  }
+
+  struct ras_storage_s *snapshot = ras_ram_storage_snapshot(storage);
+  struct ras_ram_storage_s *copy = (struct ras_ram_storage_s *) snapshot;
+
+  if (0 != snapshot && ram->root == copy->root && 3 == copy->npages) {
+    ok("ras_ram_storage_snapshot() shares the page table");
+  }
+
+  // the first write to a shared page copies it and the nodes above it
+  const unsigned long int shared = ras_allocator_stats().alloc;
+  ras_storage_write(snapshot, 0, 4, "copy", 0);
+  const unsigned long int owned = ras_allocator_stats().alloc;
+  ras_storage_write(snapshot, 0, 4, "copy", 0);
+  const unsigned long int again = ras_allocator_stats().alloc;
+  ras_storage_write(snapshot, RAS_RAM_PAGE_SIZE, 4, "copy", 0);
+  const unsigned long int sibling = ras_allocator_stats().alloc;
+
+  if (
+    (owned - shared) - (again - owned) == copy->height + 1 &&
+    (sibling - again) - (again - owned) == 1
+  ) {
+    ok("ras_storage_write() copies only the pages and nodes it changes");
+  }
+
+  ras_storage_read_into(storage, 0, 4, into, onread);
+  if (0 == memcmp(into, "page", 4)) {
+    ras_storage_read_into(snapshot, 0, 4, into, onread);
+    if (0 == memcmp(into, "copy", 4)) {
+      ok("ras_storage_write() to a snapshot leaves the storage unchanged");
+    }
+  }
+
+  ras_storage_delete(storage, 2 * RAS_RAM_PAGE_SIZE, RAS_RAM_PAGE_SIZE, 0);
+  const unsigned long int npages = ram->npages;
+  ras_storage_destroy(storage, 0);
+
+  ras_storage_read_into(snapshot, 2 * RAS_RAM_PAGE_SIZE, 4, into, onread);
+  if (2 == npages && 0 == memcmp(into, "page", 4)) {
+    ok("snapshot pages outlive deletes and the storage");
+  }
+
+  ras_storage_destroy(snapshot, 0);
+
+  const struct ras_allocator_stats_s stats = ras_allocator_stats();
+  if (stats.alloc == stats.free) {
+    ok("stats.alloc == stats.free");
+  }
+
+  ok_done();
+  return ok_expected() - ok_count();
+}
@@ -0,0 +1,151 @@
+#include <ras/allocator.h>
+#include <ras/request.h>
+#include <ras/storage.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ok/ok.h>
+
+#ifndef OK_EXPECTED
+#define OK_EXPECTED 0
+#endif
+
+#define MEMORY_SIZE 4096
+
+static unsigned char memory[MEMORY_SIZE] = { 0 };
+static unsigned char into[64] = { 0 };
+static unsigned int nreads = 0;
+static unsigned int nserved = 0;
+
+static void
+onread(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  if (0 == err) {
+    nserved++;
+  }
+}
+
+static void
+read_memory(struct ras_request_s *request) {
+  unsigned long int size = request->size;
+
+  if (request->offset >= MEMORY_SIZE) {
+    size = 0;
+  } else if (size > MEMORY_SIZE - request->offset) {
+    size = MEMORY_SIZE - request->offset;
+  }
+
+  nreads++;
+  memcpy(request->data, memory + request->offset, size);
+  request->callback(request, 0, request->data, size);
+}
+
+static void
+write_memory(struct ras_request_s *request) {
+  memcpy(memory + request->offset, request->data, request->size);
+  request->callback(request, 0, 0, request->size);
+}
+
+// reads `count` reads of `size` bytes `stride` bytes apart from `offset`
+// and returns `1` if every read saw the memory
+static int
+read_stream(
+  struct ras_storage_s *storage,
+  unsigned long int offset,
+  unsigned long int size,
+  unsigned long int stride,
+  unsigned int count
+) {
+  int matches = 1;
+
+  for (unsigned int i = 0; i < count; ++i) {
+    const unsigned long int position = offset + i * stride;
+
+    nserved = 0;
+    ras_storage_read_into(storage, position, size, into, onread);
+
+    if (1 != nserved || 0 != memcmp(into, memory + position, size)) {
+      matches = 0;
+    }
+  }
+
+  return matches;
+}
+
+int
+main(void) {
+  printf("### ok: expecting %d\n", OK_EXPECTED);
+  ok_expect(OK_EXPECTED);
+
+  for (int i = 0; i < MEMORY_SIZE; ++i) {
+    memory[i] = (unsigned char) (i * 7);
+  }
+
+  struct ras_storage_s *storage = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = read_memory,
+      .write = write_memory,
+      .readahead = 256,
+    });
+
+  ras_storage_open(storage, 0);
+
+  nreads = 0;
+  if (read_stream(storage, 0, 16, 16, 64) && nreads < 16) {
+    ok("sequential reads are served from prefetched windows");
+  }
+
+  struct ras_storage_counters_s counters = ras_storage_counters(storage);
+  if (
+    counters.readahead_hits > 48 &&
+    counters.readahead_bytes > 0 &&
+    0 == counters.readahead_misses
+  ) {
+    ok("sequential reads count read-ahead hits");
+  }
+
+  nreads = 0;
+  if (read_stream(storage, 8, 8, 64, 48) && nreads < 24) {
+    ok("strided reads are served from prefetched windows");
+  }
+
+  counters = ras_storage_counters(storage);
+  nreads = 0;
+  if (read_stream(storage, 2048, 16, 16, 16)) {
+    for (unsigned int i = 0; i < 8; ++i) {
+      read_stream(storage, (i * 1777) % (MEMORY_SIZE - 16), 16, 16, 1);
+    }
+  }
+
+  if (
+    ras_storage_counters(storage).readahead_misses > counters.readahead_misses &&
+    ras_storage_counters(storage).readahead_wasted > counters.readahead_wasted
+  ) {
+    ok("random reads miss and drop the prefetched windows");
+  }
+
+  read_stream(storage, 0, 16, 16, 8);
+  ras_storage_write(storage, 128, 8, "stale!!", 0);
+  if (read_stream(storage, 128, 16, 16, 1)) {
+    ok("writes drop the prefetched windows they overlap");
+  }
+
+  // prefetches up to the end of the storage come back short
+  if (read_stream(storage, MEMORY_SIZE - 256, 16, 16, 16)) {
+    ok("reads up to the end of the storage");
+  }
+
+  ras_storage_destroy(storage, 0);
+
+  const struct ras_allocator_stats_s stats = ras_allocator_stats();
+  if (stats.alloc == stats.free) {
+    ok("stats.alloc == stats.free");
+  }
+
+  ok_done();
+  return ok_expected() - ok_count();
+}
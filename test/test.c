@@ -3,7 +3,10 @@
 #include <ras/storage.h>
 #include <ras/version.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <ok/ok.h>
 
 #ifndef OK_EXPECTED
@@ -86,6 +89,54 @@ stat(struct ras_request_s *request) {
   request->callback(request, 0, 0, request->size);
 }
 
+static struct ras_request_s *deferred = 0;
+
+static void
+defer(struct ras_request_s *request) {
+  deferred = request;
+}
+
+static struct ras_request_s *held[8] = { 0 };
+static unsigned int nheld = 0;
+
+static void
+hold(struct ras_request_s *request) {
+  held[nheld++] = request;
+}
+
+static void
+complete(struct ras_request_s *request) {
+  request->callback(request, 0, request->data, request->size);
+}
+
+static void
+fill(struct ras_request_s *request) {
+  memcpy(request->data, memory + request->offset, request->size);
+  request->callback(request, 0, request->data, request->size);
+}
+
+static unsigned int nfull = 0;
+
+// reads into a buffer of its own, as a storage without buffers to read
+// into given may
+static void
+copy(struct ras_request_s *request) {
+  unsigned char *data = ras_alloc(request->size);
+  memcpy(data, memory + request->offset, request->size);
+  request->callback(request, 0, data, request->size);
+}
+
+static void
+onfull(void *value, void *data) {
+  nfull++;
+  ok("RAS_EVENT_FULL");
+}
+
+static void
+ondrain(void *value, void *data) {
+  ok("RAS_EVENT_DRAIN");
+}
+
 static void
 onopen(struct ras_storage_s *storage, int err) {
   ok("onopen()");
@@ -96,6 +147,60 @@ onclose(struct ras_storage_s *storage, int err) {
   ok("onclose()");
 }
 
+static void
+onflush(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    ok("onflush()");
+  }
+}
+
+static unsigned int nsynced = 0;
+
+static void
+onsync(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    nsynced++;
+  }
+}
+
+static int failure = 0;
+
+static void
+onfail(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  failure = err;
+}
+
+static void
+abort_inflight(struct ras_request_s *request) {
+  request->callback(request, EINTR, 0, 0);
+}
+
+static unsigned int ntimedout = 0;
+static unsigned int ndoomed = 0;
+
+static void
+ondoomed(struct ras_storage_s *storage, int err) {
+  ndoomed++;
+}
+
+// the first request that times out destroys the storage
+static void
+ontimedout(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  if (ETIMEDOUT == err && 0 == ntimedout++) {
+    ras_storage_destroy(storage, ondoomed);
+  }
+}
+
 static void
 ondestroy(struct ras_storage_s *storage, int err) {
   ok("ondestroy()");
@@ -134,6 +239,69 @@ onread(
   printf("\n");
 }
 
+static void
+oninto(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  ok("oninto()");
+}
+
+static void
+onreadv(
+  struct ras_storage_s *storage,
+  int err,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments
+) {
+  if (0 == err && 2 == nsegments) {
+    ok("onreadv()");
+  }
+}
+
+static unsigned int nappended = 0;
+
+static void
+onappend(struct ras_storage_s *storage, int err) {
+  if (0 == err) {
+    nappended++;
+  }
+}
+
+static const void *slices[6] = { 0 };
+static unsigned int nslices = 0;
+
+static void
+onslice(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  if (0 == err && 4 == size && nslices < 6) {
+    slices[nslices++] = buffer;
+  }
+}
+
+static struct ras_request_s *loan = 0;
+
+static void
+onborrow(
+  struct ras_storage_s *storage,
+  int err,
+  const void *buffer,
+  unsigned long int size,
+  struct ras_request_s *lent
+) {
+  if (0 == err && 0 != lent && 0 == memcmp(buffer, memory + 4, size)) {
+    ok("onborrow()");
+  }
+
+  loan = lent;
+}
+
 static void
 onwrite(
   struct ras_storage_s *storage,
@@ -186,6 +354,14 @@ main(void) {
     ok("ras_storage_stat()");
   }
 
+  if (0 == ras_storage_flush(storage, onflush)) {
+    ok("ras_storage_flush()");
+  }
+
+  if (0 == ras_storage_sync(storage, onsync) && 1 == nsynced) {
+    ok("ras_storage_sync() without sync()");
+  }
+
   if (0 == ras_storage_close(storage, onclose)) {
     ok("ras_storage_close()");
   }
@@ -194,12 +370,613 @@ main(void) {
     ok("ras_storage_destroy()");
   }
 
+  unsigned char into[4] = { 0 };
+  struct ras_storage_s *direct = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = fill,
+    });
+
+  ras_storage_open(direct, 0);
+  const unsigned int allocs = ras_allocator_alloc_count();
+  if (0 == ras_storage_read_into(direct, 0, 4, into, oninto)) {
+    ok("ras_storage_read_into()");
+  }
+
+  if (allocs == ras_allocator_alloc_count() && 0 == memcmp(into, memory, 4)) {
+    ok("ras_storage_read_into() without allocation");
+  }
+
+  unsigned char head[2] = { 0 };
+  unsigned char tail[2] = { 0 };
+  struct ras_request_segment_s segments[2] = {
+    { .offset = 0, .size = 2, .buffer = head },
+    { .offset = 30, .size = 2, .buffer = tail },
+  };
+
+  if (0 == ras_storage_readv(direct, segments, 2, onreadv)) {
+    ok("ras_storage_readv()");
+  }
+
+  if (0 == memcmp(head, memory, 2) && 0 == memcmp(tail, memory + 30, 2)) {
+    ok("ras_storage_readv() split into read() segments");
+  }
+
+  struct ras_storage_s *copier = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = copy,
+    });
+
+  memset(head, 0, sizeof(head));
+  memset(tail, 0, sizeof(tail));
+  ras_storage_open(copier, 0);
+
+  const unsigned int copies = ras_allocator_alloc_count();
+  const unsigned int copies_freed = ras_allocator_free_count();
+  ras_storage_readv(copier, segments, 2, 0);
+
+  if (
+    ras_allocator_alloc_count() - copies ==
+      ras_allocator_free_count() - copies_freed &&
+    0 == memcmp(head, memory, 2) && 0 == memcmp(tail, memory + 30, 2)
+  ) {
+    ok("ras_storage_readv() frees the buffers of read() segments");
+  }
+
+  ras_storage_destroy(copier, 0);
+
+  unsigned char batch[2][4] = { { 0 } };
+  const struct ras_request_options_s requests[2] = {
+    { .type = RAS_REQUEST_READ, .offset = 4, .size = 4, .data = batch[0] },
+    { .type = RAS_REQUEST_READ, .offset = 8, .size = 4, .data = batch[1] },
+  };
+
+  if (0 == ras_storage_submit(direct, requests, 2)) {
+    ok("ras_storage_submit()");
+  }
+
+  if (0 == memcmp(batch[0], memory + 4, 4) && 0 == memcmp(batch[1], memory + 8, 4)) {
+    ok("ras_storage_submit() ran every request");
+  }
+
+  ras_storage_destroy(direct, 0);
+
+  struct ras_storage_s *concurrent = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .max_inflight = 4,
+    });
+
+  // spaced apart so queued reads are not merged
+  ras_storage_open(concurrent, 0);
+  for (int i = 0; i < 6; ++i) {
+    ras_storage_read_into(concurrent, i * 8, 4, into, 0);
+  }
+
+  if (4 == concurrent->pending && 2 == concurrent->queued) {
+    ok("max_inflight requests in flight");
+  }
+
+  for (int i = 0; i < 6; ++i) {
+    held[i]->callback(held[i], 0, into, 4);
+  }
+
+  if (0 == concurrent->pending && 0 == concurrent->queued && 6 == nheld) {
+    ok("queued requests drained as requests complete");
+  }
+
+  ras_storage_destroy(concurrent, 0);
+
+  struct ras_storage_s *hazard = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .write = hold,
+      .max_inflight = 4,
+    });
+
+  nheld = 0;
+  ras_storage_open(hazard, 0);
+  ras_storage_write(hazard, 0, 4, buffer, 0);
+  ras_storage_read_into(hazard, 2, 4, into, 0);
+  ras_storage_read_into(hazard, 8, 4, into, 0);
+
+  if (2 == hazard->pending && 1 == hazard->queued) {
+    ok("overlapping read waits while disjoint read runs");
+  }
+
+  held[0]->callback(held[0], 0, 0, 4);
+  if (3 == nheld && 1 == ras_storage_counters(hazard).hazard_stalls) {
+    ok("overlapping read runs after write completes");
+  }
+
+  held[1]->callback(held[1], 0, into, 4);
+  held[2]->callback(held[2], 0, into, 4);
+  ras_storage_destroy(hazard, 0);
+
+  struct ras_storage_s *appender = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .write = hold,
+    });
+
+  nheld = 0;
+  ras_storage_open(appender, 0);
+  ras_storage_write(appender, 0, 4, buffer, onappend);
+
+  // queued behind the first write, the read is disjoint so it is overtaken
+  ras_storage_write(appender, 4, 4, buffer, onappend);
+  ras_storage_write(appender, 8, 4, buffer, onappend);
+  ras_storage_write(appender, 10, 4, buffer, onappend);
+  ras_storage_read_into(appender, 20, 4, into, 0);
+  ras_storage_write(appender, 14, 2, buffer, onappend);
+
+  held[0]->callback(held[0], 0, 0, 4);
+  if (2 == nheld && 4 == held[1]->offset && 12 == held[1]->size) {
+    ok("queued writes coalesced into one write()");
+  }
+
+  const unsigned char appended[12] = {
+    0xaa, 0xbb, 0xcc, 0xdd, 0xaa, 0xbb, 0xaa, 0xbb, 0xcc, 0xdd, 0xaa, 0xbb
+  };
+
+  if (
+    0 == memcmp(held[1]->data, appended, 12) &&
+    3 == ras_storage_counters(appender).coalesced_writes &&
+    10 == ras_storage_counters(appender).coalesced_bytes
+  ) {
+    ok("coalesced write holds the writes in queue order");
+  }
+
+  held[1]->callback(held[1], 0, 0, 12);
+  if (5 == nappended && 3 == nheld && RAS_REQUEST_READ == held[2]->type) {
+    ok("coalesced write completes every merged write");
+  }
+
+  held[2]->callback(held[2], 0, into, 4);
+  ras_storage_destroy(appender, 0);
+
+  struct ras_storage_s *reader = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .write = hold,
+    });
+
+  unsigned char slice[4] = { 0 };
+
+  nheld = 0;
+  ras_storage_open(reader, 0);
+  ras_storage_write(reader, 28, 4, buffer, 0);
+
+  // the same block twice and the blocks next to it, but not the far one
+  ras_storage_read(reader, 0, 4, onslice);
+  ras_storage_read_into(reader, 2, 4, slice, onslice);
+  ras_storage_read(reader, 4, 4, onslice);
+  ras_storage_read_into(reader, 12, 4, into, 0);
+  ras_storage_read(reader, 0, 4, onslice);
+
+  held[0]->callback(held[0], 0, 0, 4);
+  if (
+    2 == nheld &&
+    0 == held[1]->offset && 8 == held[1]->size &&
+    3 == ras_storage_counters(reader).coalesced_reads
+  ) {
+    ok("queued reads coalesced into one read()");
+  }
+
+  unsigned char *block = held[1]->data;
+  memcpy(block, memory, 8);
+  held[1]->callback(held[1], 0, block, 8);
+
+  if (
+    4 == nslices &&
+    block == slices[0] && slice == slices[1] &&
+    block + 4 == slices[2] && block == slices[3] &&
+    0 == memcmp(slice, memory + 2, 4)
+  ) {
+    ok("coalesced read gives each read its slice");
+  }
+
+  held[2]->callback(held[2], 0, into, 4);
+
+  // a buffer the storage returns is freed once the reads are served
+  ras_storage_write(reader, 28, 4, buffer, 0);
+  ras_storage_read(reader, 0, 4, onslice);
+  ras_storage_read(reader, 4, 4, onslice);
+  held[3]->callback(held[3], 0, 0, 4);
+
+  unsigned char *owned = ras_alloc(8);
+  memcpy(owned, memory, 8);
+  held[4]->callback(held[4], 0, owned, 8);
+
+  if (6 == nslices && owned == slices[4] && owned + 4 == slices[5]) {
+    ok("coalesced read frees a buffer of the storage");
+  }
+
+  ras_storage_destroy(reader, 0);
+
+  struct ras_storage_s *lender = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = fill,
+      .write = complete,
+      .max_inflight = 4,
+    });
+
+  ras_storage_open(lender, 0);
+  ras_storage_read_borrow(lender, 4, 4, onborrow);
+  ras_storage_write(lender, 6, 2, buffer, 0);
+  ras_storage_write(lender, 12, 2, buffer, 0);
+
+  if (0 != loan && 1 == lender->queued && 0 == lender->pending) {
+    ok("overlapping write waits for the loan");
+  }
+
+  if (0 == ras_storage_loan_release(loan) && 0 == lender->queued) {
+    ok("ras_storage_loan_release() runs held back requests");
+  }
+
+  if (-EINVAL == ras_storage_read_borrow(lender, 0, 4, 0)) {
+    ok("ras_storage_read_borrow() without callback");
+  }
+
+  ras_storage_destroy(lender, 0);
+
+  struct ras_storage_s *syncer = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .sync = hold,
+      .group_sync = 1,
+      .max_inflight = 4,
+    });
+
+  nheld = 0;
+  nsynced = 0;
+  ras_storage_open(syncer, 0);
+  ras_storage_sync(syncer, onsync);
+
+  // made while the first sync is in flight, so they share the next one
+  for (int i = 0; i < 3; ++i) {
+    ras_storage_sync(syncer, onsync);
+  }
+
+  held[0]->callback(held[0], 0, 0, 0);
+  if (1 == nsynced && 2 == nheld) {
+    ok("sync requests made while a sync is in flight are grouped");
+  }
+
+  held[1]->callback(held[1], 0, 0, 0);
+  if (
+    4 == nsynced &&
+    2 == ras_storage_counters(syncer).syncs &&
+    2 == ras_storage_counters(syncer).syncs_shared
+  ) {
+    ok("grouped sync requests complete with one sync()");
+  }
+
+  ras_storage_destroy(syncer, 0);
+
+  struct ras_storage_s *scheduler = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .write = hold,
+    });
+
+  const struct ras_request_options_s classes[3] = {
+    {
+      .type = RAS_REQUEST_WRITE, .offset = 0, .size = 4, .data = (void *) buffer,
+      .priority = RAS_REQUEST_PRIORITY_LOW
+    },
+    { .type = RAS_REQUEST_READ, .offset = 8, .size = 4, .data = batch[0] },
+    {
+      .type = RAS_REQUEST_READ, .offset = 16, .size = 4, .data = batch[1],
+      .priority = RAS_REQUEST_PRIORITY_HIGH
+    },
+  };
+
+  // queued behind a write in flight, then dispatched by class
+  nheld = 0;
+  ras_storage_open(scheduler, 0);
+  ras_storage_write(scheduler, 24, 4, buffer, 0);
+  ras_storage_submit(scheduler, classes, 3);
+
+  for (int i = 0; i < 3; ++i) {
+    held[i]->callback(held[i], 0, held[i]->data, 4);
+  }
+
+  if (
+    4 == nheld &&
+    16 == held[1]->offset && 8 == held[2]->offset && 0 == held[3]->offset &&
+    1 == ras_storage_counters(scheduler).queue_waits[RAS_REQUEST_PRIORITY_LOW]
+  ) {
+    ok("queued requests dispatched by priority class");
+  }
+
+  held[3]->callback(held[3], 0, 0, 4);
+
+  const unsigned long int p99 = ras_storage_queue_wait_percentile(
+    scheduler,
+    RAS_REQUEST_PRIORITY_HIGH,
+    99);
+
+  if (
+    0 != p99 &&
+    p99 == ras_storage_counters(scheduler).queue_wait_max[RAS_REQUEST_PRIORITY_HIGH] &&
+    0 == ras_storage_queue_wait_percentile(0, RAS_REQUEST_PRIORITY_HIGH, 99)
+  ) {
+    ok("ras_storage_queue_wait_percentile()");
+  }
+
+  ras_storage_destroy(scheduler, 0);
+
+  struct ras_storage_s *aging = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .write = hold,
+      .priority_aging = 100,
+    });
+
+  // waiting longer than two aging periods ranks it with high priority ones
+  nheld = 0;
+  ras_storage_open(aging, 0);
+  ras_storage_write(aging, 24, 4, buffer, 0);
+  ras_storage_submit(aging, classes, 1);
+  nanosleep(&(struct timespec) { .tv_nsec = 1000000 }, 0);
+  ras_storage_submit(aging, classes + 2, 1);
+
+  held[0]->callback(held[0], 0, 0, 4);
+  if (2 == nheld && 0 == held[1]->offset) {
+    ok("queued requests age past higher priority classes");
+  }
+
+  held[1]->callback(held[1], 0, 0, 4);
+  held[2]->callback(held[2], 0, held[2]->data, 4);
+  ras_storage_destroy(aging, 0);
+
+  errno = 0;
+  if (
+    0 == ras_storage_new((struct ras_storage_options_s) { .schedule = 7 }) &&
+    EINVAL == errno
+  ) {
+    ok("ras_storage_new() == NULL with an invalid schedule");
+  }
+
+  struct ras_storage_s *elevator = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .write = hold,
+      .schedule = RAS_STORAGE_SCHEDULE_CSCAN,
+    });
+
+  // the read at 28 is queued after the write at 28 so it may not pass it
+  nheld = 0;
+  ras_storage_open(elevator, 0);
+  ras_storage_write(elevator, 0, 4, buffer, 0);
+  ras_storage_read_into(elevator, 40, 4, into, 0);
+  ras_storage_write(elevator, 28, 4, buffer, 0);
+  ras_storage_read_into(elevator, 12, 4, into, 0);
+  ras_storage_read_into(elevator, 28, 4, into, 0);
+  ras_storage_read_into(elevator, 20, 4, into, 0);
+
+  for (int i = 0; i < 5; ++i) {
+    held[i]->callback(held[i], 0, held[i]->data, 4);
+  }
+
+  if (
+    6 == nheld &&
+    12 == held[1]->offset && 20 == held[2]->offset &&
+    28 == held[3]->offset && RAS_REQUEST_WRITE == held[3]->type &&
+    40 == held[4]->offset && 28 == held[5]->offset &&
+    ras_storage_counters(elevator).reordered > 0
+  ) {
+    ok("queued requests dispatched in C-SCAN order");
+  }
+
+  held[5]->callback(held[5], 0, held[5]->data, 4);
+  ras_storage_destroy(elevator, 0);
+
+  struct ras_storage_s *cancelable = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .write = hold,
+    });
+
+  struct ras_request_s *handles[3] = { 0 };
+  const struct ras_request_options_s reads[3] = {
+    {
+      .type = RAS_REQUEST_READ, .offset = 8, .size = 4, .data = batch[0],
+      .callback = onfail, .handle = &handles[0]
+    },
+    {
+      .type = RAS_REQUEST_READ, .offset = 16, .size = 4, .data = batch[1],
+      .callback = onfail, .handle = &handles[1]
+    },
+    {
+      .type = RAS_REQUEST_READ, .offset = 24, .size = 4, .data = into,
+      .callback = onfail, .handle = &handles[2], .timeout = 500
+    },
+  };
+
+  // queued behind a write in flight
+  nheld = 0;
+  ras_storage_open(cancelable, 0);
+  ras_storage_write(cancelable, 0, 4, buffer, 0);
+  ras_storage_submit(cancelable, reads, 3);
+
+  if (
+    0 == ras_storage_cancel(cancelable, &handles[1]) &&
+    ECANCELED == failure && 0 == handles[1] &&
+    -EALREADY == ras_storage_cancel(cancelable, &handles[1]) &&
+    1 == ras_storage_counters(cancelable).canceled
+  ) {
+    ok("ras_storage_cancel() removes a queued request");
+  }
+
+  nanosleep(&(struct timespec) { .tv_nsec = 1000000 }, 0);
+  if (
+    1 == ras_storage_expire(cancelable) &&
+    ETIMEDOUT == failure && 0 == handles[2] &&
+    1 == ras_storage_counters(cancelable).timeouts
+  ) {
+    ok("ras_storage_expire() times out queued requests");
+  }
+
+  held[0]->callback(held[0], 0, 0, 4);
+  if (-EBUSY == ras_request_cancel(handles[0]) && 2 == nheld) {
+    ok("ras_request_cancel() == -EBUSY in flight without cancel()");
+  }
+
+  failure = 0;
+  cancelable->options.cancel = abort_inflight;
+  if (
+    0 == ras_request_cancel(handles[0]) &&
+    ECANCELED == failure && 0 == handles[0] && 0 == cancelable->pending
+  ) {
+    ok("ras_request_cancel() aborts a request in flight with cancel()");
+  }
+
+  ras_storage_destroy(cancelable, 0);
+
+  struct ras_storage_s *crowded = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .write = hold,
+      .max_queued = 2,
+    });
+
+  struct ras_request_s *crowd = 0;
+  const struct ras_request_options_s first = {
+    .type = RAS_REQUEST_READ, .offset = 8, .size = 4, .data = batch[0],
+    .callback = onfail, .handle = &crowd
+  };
+
+  // a canceled request leaves room in a full queue
+  nheld = 0;
+  ras_storage_open(crowded, 0);
+  ras_storage_write(crowded, 0, 4, buffer, 0);
+  ras_storage_read_into(crowded, 16, 4, batch[1], 0);
+  ras_storage_submit(crowded, &first, 1);
+
+  if (
+    -EAGAIN == ras_storage_read_into(crowded, 24, 4, into, 0) &&
+    0 == ras_storage_cancel(crowded, &crowd) &&
+    0 == ras_storage_read_into(crowded, 24, 4, into, 0) &&
+    3 == crowded->queued && 1 == crowded->tombstones
+  ) {
+    ok("ras_storage_cancel() relieves a full queue");
+  }
+
+  held[0]->callback(held[0], 0, 0, 4);
+  held[1]->callback(held[1], 0, held[1]->data, 4);
+  held[2]->callback(held[2], 0, held[2]->data, 4);
+
+  if (3 == nheld && 0 == crowded->queued && 0 == crowded->tombstones) {
+    ok("canceled requests leave the queue at its head");
+  }
+
+  ras_storage_destroy(crowded, 0);
+
+  struct ras_storage_s *plain = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .write = hold,
+    });
+
+  struct ras_request_s *plain_read = 0;
+
+  // a read queued behind a write in flight
+  nheld = 0;
+  failure = 0;
+  ras_storage_open(plain, 0);
+  ras_storage_write(plain, 0, 4, buffer, 0);
+  ras_storage_read_into_ex(
+    plain,
+    8,
+    4,
+    into,
+    onfail,
+    0,
+    0,
+    &(struct ras_request_control_s) { .handle = &plain_read });
+
+  if (
+    0 != plain_read &&
+    0 == ras_storage_cancel(plain, &plain_read) &&
+    ECANCELED == failure && 0 == plain_read && 0 == plain->queued
+  ) {
+    ok("ras_storage_read_into_ex() gives a handle to cancel with");
+  }
+
+  held[0]->callback(held[0], 0, 0, 4);
+  ras_storage_destroy(plain, 0);
+
+  struct ras_storage_s *doomed = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = hold,
+      .cancel = abort_inflight,
+    });
+
+  const struct ras_request_options_s expiring[3] = {
+    {
+      .type = RAS_REQUEST_READ, .offset = 0, .size = 4, .data = batch[0],
+      .callback = ontimedout, .timeout = 2000
+    },
+    {
+      .type = RAS_REQUEST_READ, .offset = 8, .size = 4, .data = batch[1],
+      .callback = ontimedout, .timeout = 2000
+    },
+    {
+      .type = RAS_REQUEST_READ, .offset = 16, .size = 4, .data = into,
+      .callback = ontimedout, .timeout = 2000
+    },
+  };
+
+  // one read in flight and two queued behind it
+  nheld = 0;
+  ras_storage_open(doomed, 0);
+  ras_storage_submit(doomed, expiring, 3);
+  nanosleep(&(struct timespec) { .tv_nsec = 3000000 }, 0);
+
+  if (3 == ras_storage_expire(doomed) && 3 == ntimedout && 1 == ndoomed) {
+    ok("ras_storage_expire() defers a destroy made by a timeout");
+  }
+
+  struct ras_storage_s *bounded = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .open = defer,
+      .read = complete,
+      .max_queued = 1,
+    });
+
+  ras_emitter_on(&bounded->emitter, (struct ras_emitter_listener_s) {
+    .event = RAS_EVENT_FULL,
+    .callback = onfull
+  });
+
+  ras_emitter_on(&bounded->emitter, (struct ras_emitter_listener_s) {
+    .event = RAS_EVENT_DRAIN,
+    .callback = ondrain
+  });
+
+  // open is deferred so the read is queued behind it and fills the queue
+  ras_storage_read(bounded, 0, 4, 0);
+  if (1 == nfull) {
+    ok("RAS_EVENT_FULL once the queue is filled");
+  }
+
+  if (-EAGAIN == ras_storage_read(bounded, 0, 4, 0) && 1 == nfull) {
+    ok("ras_storage_read() == -EAGAIN when queue is full");
+  }
+
+  deferred->callback(deferred, 0, 0, 0);
+  ras_storage_destroy(bounded, 0);
+
   const struct ras_allocator_stats_s stats = ras_allocator_stats();
   //printf("alloc=%d free=%d\n", stats.alloc, stats.free);
   if (stats.alloc == stats.free) {
     ok("stats.alloc == stats.free");
   }
 
+  if (stats.pool_hit > 0) {
+    ok("stats.pool_hit > 0");
+  }
+
   printf("%s\n", ras_version_string());
   ok_done();
   return ok_expected() - ok_count();
@@ -0,0 +1,215 @@
+#include <ras/allocator.h>
+#include <ras/storage.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <ok/ok.h>
+
+#ifndef OK_EXPECTED
+#define OK_EXPECTED 0
+#endif
+
+#define PRODUCERS 8
+#define ITERATIONS 2000
+#define SLOT_SIZE 8
+
+static unsigned char memory[PRODUCERS * SLOT_SIZE] = { 0 };
+static unsigned char patterns[256][SLOT_SIZE] = { { 0 } };
+static unsigned int completed = 0;
+static unsigned int mismatched = 0;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ras_request_s *waiting[PRODUCERS * 4] = { 0 };
+static unsigned int nwaiting = 0;
+static unsigned int stopped = 0;
+
+struct producer_s {
+  pthread_t id;
+  struct ras_storage_s *storage;
+  unsigned int index;
+};
+
+static void
+store(struct ras_request_s *request) {
+  memcpy(memory + request->offset, request->data, request->size);
+  request->callback(request, 0, 0, request->size);
+}
+
+static void
+fill(struct ras_request_s *request) {
+  memcpy(request->data, memory + request->offset, request->size);
+  request->callback(request, 0, request->data, request->size);
+}
+
+// completes requests on the completer thread
+static void
+forward(struct ras_request_s *request) {
+  pthread_mutex_lock(&mutex);
+  waiting[nwaiting++] = request;
+  pthread_mutex_unlock(&mutex);
+}
+
+static void *
+complete(void *arg) {
+  for (;;) {
+    struct ras_request_s *request = 0;
+
+    pthread_mutex_lock(&mutex);
+    if (nwaiting > 0) {
+      request = waiting[--nwaiting];
+    }
+    pthread_mutex_unlock(&mutex);
+
+    if (0 != request) {
+      if (RAS_REQUEST_WRITE == request->type) {
+        store(request);
+      } else {
+        fill(request);
+      }
+    } else if (__atomic_load_n(&stopped, __ATOMIC_ACQUIRE)) {
+      break;
+    } else {
+      sched_yield();
+    }
+  }
+
+  return 0;
+}
+
+static void
+onwrite(struct ras_storage_s *storage, int err) {
+  __atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED);
+}
+
+static void
+onread(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  unsigned char *data = buffer;
+
+  // each slot holds the same byte repeated, torn writes show up here
+  for (int i = 1; i < size; ++i) {
+    if (data[i] != data[0]) {
+      __atomic_add_fetch(&mismatched, 1, __ATOMIC_RELAXED);
+      break;
+    }
+  }
+
+  __atomic_add_fetch(&completed, 1, __ATOMIC_RELAXED);
+}
+
+static void *
+produce(void *arg) {
+  struct producer_s *producer = arg;
+  struct ras_storage_s *storage = producer->storage;
+  unsigned long int offset = producer->index * SLOT_SIZE;
+
+  for (int i = 0; i < ITERATIONS; ++i) {
+    // buffers must stay valid until the write completes
+    const unsigned char *pattern = patterns[i & 0xff];
+
+    while (-EAGAIN == ras_storage_write(
+      storage, offset, SLOT_SIZE, pattern, onwrite)
+    ) {
+      sched_yield();
+    }
+
+    while (-EAGAIN == ras_storage_read(storage, offset, SLOT_SIZE, onread)) {
+      sched_yield();
+    }
+  }
+
+  return 0;
+}
+
+static void
+stress(struct ras_storage_s *storage) {
+  struct producer_s producers[PRODUCERS];
+
+  completed = 0;
+  mismatched = 0;
+
+  for (int i = 0; i < PRODUCERS; ++i) {
+    memset(&producers[i], 0, sizeof(producers[i]));
+    producers[i].storage = storage;
+    producers[i].index = i;
+    pthread_create(&producers[i].id, 0, produce, &producers[i]);
+  }
+
+  for (int i = 0; i < PRODUCERS; ++i) {
+    pthread_join(producers[i].id, 0);
+  }
+}
+
+static void
+wait_for(unsigned int count) {
+  while (__atomic_load_n(&completed, __ATOMIC_ACQUIRE) < count) {
+    sched_yield();
+  }
+}
+
+int
+main(void) {
+  printf("### ok: expecting %d\n", OK_EXPECTED);
+  ok_expect(OK_EXPECTED);
+
+  const unsigned int total = PRODUCERS * ITERATIONS * 2;
+  pthread_t completer;
+
+  for (int i = 0; i < 256; ++i) {
+    memset(patterns[i], i, SLOT_SIZE);
+  }
+
+  struct ras_storage_s *storage = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = fill,
+      .write = store,
+      .max_inflight = 4,
+      .thread_safe = 1,
+    });
+
+  stress(storage);
+
+  if (total == __atomic_load_n(&completed, __ATOMIC_ACQUIRE)) {
+    ok("every request completed with synchronous operations");
+  }
+
+  if (0 == storage->pending && 0 == storage->queued && 0 == mismatched) {
+    ok("queue drained without torn reads");
+  }
+
+  ras_storage_destroy(storage, 0);
+
+  storage = ras_storage_new(
+    (struct ras_storage_options_s) {
+      .read = forward,
+      .write = forward,
+      .max_inflight = 8,
+      .thread_safe = 1,
+    });
+
+  pthread_create(&completer, 0, complete, 0);
+  stress(storage);
+  wait_for(total);
+
+  if (0 == mismatched) {
+    ok("every request completed on another thread");
+  }
+
+  ras_storage_destroy(storage, 0);
+  __atomic_store_n(&stopped, 1, __ATOMIC_RELEASE);
+  pthread_join(completer, 0);
+
+  const struct ras_allocator_stats_s stats = ras_allocator_stats();
+  if (stats.alloc == stats.free) {
+    ok("stats.alloc == stats.free");
+  }
+
+  ok_done();
+  return ok_expected() - ok_count();
+}
@@ -0,0 +1,229 @@
+#include <ras/allocator.h>
+#include <ras/storage.h>
+#include <ras/uring.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ok/ok.h>
+
+#ifndef OK_EXPECTED
+#define OK_EXPECTED 0
+#endif
+
+#define OFFSET 4096
+#define BATCH 8
+
+static const char message[] = "hello io_uring";
+static char registered[64] = { 0 };
+static char into[sizeof(message)] = { 0 };
+static unsigned long int stat_size = 0;
+static unsigned int completed = 0;
+static unsigned int failed = 0;
+
+static struct iovec buffers[1] = {
+  { .iov_base = registered, .iov_len = sizeof(registered) },
+};
+
+static void
+done(struct ras_storage_s *storage, int err) {
+  if (0 != err) {
+    __atomic_add_fetch(&failed, 1, __ATOMIC_RELAXED);
+  }
+
+  __atomic_add_fetch(&completed, 1, __ATOMIC_RELEASE);
+}
+
+static void
+onread(
+  struct ras_storage_s *storage,
+  int err,
+  void *buffer,
+  unsigned long int size
+) {
+  done(storage, err);
+}
+
+static void
+onstat(
+  struct ras_storage_s *storage,
+  int err,
+  struct ras_storage_stats_s *stats
+) {
+  if (0 == err) {
+    stat_size = stats->size;
+  }
+
+  done(storage, err);
+}
+
+static void
+onreadv(
+  struct ras_storage_s *storage,
+  int err,
+  struct ras_request_segment_s *segments,
+  unsigned long int nsegments
+) {
+  done(storage, err);
+}
+
+// sync requests made together share one sync
+static void
+onwritesync(struct ras_storage_s *storage, int err) {
+  done(storage, err);
+
+  for (int i = 0; i < 3; ++i) {
+    ras_storage_sync(storage, done);
+  }
+}
+
+// waits for `count` requests made since the last wait to complete
+static void
+settle(struct ras_storage_s *storage, unsigned int count) {
+  while (__atomic_load_n(&completed, __ATOMIC_ACQUIRE) < count) {
+    if (ras_uring_storage_supported(storage)) {
+      ras_uring_storage_poll(storage, 1);
+    } else {
+      sched_yield();
+    }
+  }
+
+  __atomic_store_n(&completed, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Runs every operation against a storage for `path` and returns the number
+ * of checks that failed.
+ */
+static int
+run(const char *path, struct ras_uring_storage_options_s options) {
+  struct ras_storage_s *storage = ras_uring_storage_new(path, options);
+  char head[5] = { 0 };
+  char tail[3] = { 0 };
+  int errors = 0;
+
+  struct ras_request_segment_s segments[2] = {
+    { .offset = OFFSET, .size = sizeof(head), .buffer = head },
+    { .offset = OFFSET + 11, .size = sizeof(tail), .buffer = tail },
+  };
+
+  if (0 == storage) {
+    return 1;
+  }
+
+  failed = 0;
+  ras_storage_open(storage, done);
+  ras_storage_write(storage, OFFSET, sizeof(message), message, done);
+  settle(storage, 2);
+
+  ras_storage_read_into(storage, OFFSET, sizeof(message), into, onread);
+  ras_storage_stat(storage, onstat);
+  settle(storage, 2);
+
+  errors += 0 != memcmp(into, message, sizeof(message));
+  errors += OFFSET + sizeof(message) != stat_size;
+
+  ras_storage_readv(storage, segments, 2, onreadv);
+  settle(storage, 1);
+
+  errors += 0 != memcmp(head, "hello", sizeof(head));
+  errors += 0 != memcmp(tail, "ing", sizeof(tail));
+
+  // reads into a registered buffer use fixed buffer operations
+  ras_storage_read_into(storage, OFFSET, sizeof(message), registered, onread);
+  settle(storage, 1);
+
+  errors += 0 != memcmp(registered, message, sizeof(message));
+
+  ras_storage_delete(storage, OFFSET, sizeof(message), done);
+  settle(storage, 1);
+
+  ras_storage_read_into(storage, OFFSET, sizeof(message), into, onread);
+  settle(storage, 1);
+
+  for (int i = 0; i < sizeof(message); ++i) {
+    errors += 0 != into[i];
+  }
+
+  for (int i = 0; i < BATCH; ++i) {
+    ras_storage_write(storage, i * sizeof(message), sizeof(message), message, done);
+  }
+
+  // batched writes are not submitted until the storage is polled
+  if (ras_uring_storage_supported(storage)) {
+    errors += 0 != __atomic_load_n(&completed, __ATOMIC_ACQUIRE);
+  }
+
+  settle(storage, BATCH);
+
+  // concurrent syncs share one fdatasync
+  ras_storage_write(storage, 0, sizeof(message), message, onwritesync);
+  settle(storage, 4);
+
+  errors += 1 != ras_storage_counters(storage).syncs;
+  errors += 2 != ras_storage_counters(storage).syncs_shared;
+
+  ras_storage_close(storage, done);
+  settle(storage, 1);
+
+  ras_storage_destroy(storage, done);
+  settle(storage, 1);
+
+  return errors + failed;
+}
+
+int
+main(void) {
+  printf("### ok: expecting %d\n", OK_EXPECTED);
+  ok_expect(OK_EXPECTED);
+
+  char path[] = "/tmp/ras-uring-XXXXXX";
+  const int fd = mkstemp(path);
+
+  if (fd >= 0) {
+    ok("mkstemp()");
+    close(fd);
+  }
+
+  struct ras_storage_s *probe = ras_uring_storage_new(
+    path,
+    (struct ras_uring_storage_options_s) { 0 });
+
+  if (0 != probe) {
+    ok("ras_uring_storage_new()");
+  }
+
+  printf("# io_uring supported: %d\n", ras_uring_storage_supported(probe));
+  ras_storage_destroy(probe, 0);
+
+  if (-EFAULT == ras_uring_storage_poll(0, 0)) {
+    ok("ras_uring_storage_poll() with NULL storage");
+  }
+
+  if (0 == run(path, (struct ras_uring_storage_options_s) {
+    .entries = 4,
+    .buffers = buffers,
+    .nbuffers = 1,
+  })) {
+    ok("io_uring storage operations");
+  }
+
+  if (0 == run(path, (struct ras_uring_storage_options_s) {
+    .fallback = 1,
+    .workers = 2,
+  })) {
+    ok("pread()/pwrite() fallback storage operations");
+  }
+
+  unlink(path);
+
+  const struct ras_allocator_stats_s stats = ras_allocator_stats();
+  if (stats.alloc == stats.free) {
+    ok("stats.alloc == stats.free");
+  }
+
+  ok_done();
+  return ok_expected() - ok_count();
+}